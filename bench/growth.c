@@ -0,0 +1,93 @@
+/** @license 2020 Neil Edelman, distributed under the terms of the
+ [MIT License](https://opensource.org/licenses/MIT).
+
+ Tail latency of <fn:<H>heap_add> as the heap grows, with the default
+ `realloc` against <fn:alloc_huge_realloc> from <../src/alloc.h>, which uses
+ `mremap` on Linux. Each add is timed; the latencies are kept in power-of-two
+ nanosecond buckets. The optional argument is the number of adds. Prints CSV
+ to `stdout`.
+
+ @std POSIX.1b */
+
+#define _GNU_SOURCE /* clock_gettime mmap mremap */
+#include <stdlib.h> /* EXIT strtoul rand */
+#include <stdio.h>  /* printf */
+#include <time.h>   /* clock_gettime */
+#include "../src/alloc.h"
+
+#define HEAP_NAME plain
+#include "../src/heap.h"
+
+#define HEAP_NAME huge
+#define HEAP_ALLOC &alloc_huge
+#define HEAP_REALLOC &alloc_huge_realloc
+#define HEAP_FREE &alloc_huge_free
+#include "../src/heap.h"
+
+/** Latencies in buckets of `[2^i, 2^{i+1})` nanoseconds. */
+struct histogram { size_t bucket[64], count; unsigned long max; };
+
+/** @return Nanoseconds. */
+static unsigned long now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (unsigned long)t.tv_sec * 1000000000ul + (unsigned long)t.tv_nsec;
+}
+
+/** Records `ns` in `h`. */
+static void record(struct histogram *const h, unsigned long ns) {
+	unsigned i = 0;
+	if(ns > h->max) h->max = ns;
+	while(ns >>= 1) i++;
+	h->bucket[i]++, h->count++;
+}
+
+/** @return An upper bound on the `q` quantile of `h`. */
+static unsigned long quantile(const struct histogram *const h,
+	const double q) {
+	size_t i, sum = 0;
+	const size_t target = (size_t)(q * (double)h->count);
+	for(i = 0; i < 64; i++)
+		if((sum += h->bucket[i]) > target) return (2ul << i) - 1;
+	return h->max;
+}
+
+/** Prints `h` of `name` with `n` adds in `seconds`. */
+static void print(const char *const name, const size_t n,
+	const struct histogram *const h, const double seconds) {
+	printf("%s,%lu,%f,%lu,%lu,%lu,%lu\n", name, (unsigned long)n, seconds,
+		quantile(h, 0.5), quantile(h, 0.99), quantile(h, 0.999), h->max);
+}
+
+int main(int argc, char **argv) {
+	const size_t n = argc > 1 ? (size_t)strtoul(argv[1], 0, 0) : 100000000;
+	struct plain_heap plain = HEAP_IDLE;
+	struct huge_heap huge = HEAP_IDLE;
+	struct histogram h;
+	unsigned long t0, t1, start;
+	size_t i;
+	printf("allocator,adds,total_s,p50_ns,p99_ns,p999_ns,max_ns\n");
+	memset(&h, 0, sizeof h), srand(1), start = now();
+	for(i = 0; i < n; i++) {
+		const unsigned p = (unsigned)rand();
+		t0 = now();
+		if(!plain_heap_add(&plain, p)) goto catch;
+		t1 = now(), record(&h, t1 - t0);
+	}
+	print("realloc", n, &h, (double)(now() - start) / 1e9);
+	plain_heap_(&plain);
+	memset(&h, 0, sizeof h), srand(1), start = now();
+	for(i = 0; i < n; i++) {
+		const unsigned p = (unsigned)rand();
+		t0 = now();
+		if(!huge_heap_add(&huge, p)) goto catch;
+		t1 = now(), record(&h, t1 - t0);
+	}
+	print("mremap", n, &h, (double)(now() - start) / 1e9);
+	huge_heap_(&huge);
+	return EXIT_SUCCESS;
+catch:
+	perror("growth");
+	plain_heap_(&plain), huge_heap_(&huge);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,248 @@
+/** @license 2021 Neil Edelman, distributed under the terms of the
+ [MIT License](https://opensource.org/licenses/MIT).
+
+ Benchmarks the operations of <../src/heap.h>: <fn:<H>heap_add>,
+ <fn:<H>heap_peek>, <fn:<H>heap_pop>, and <fn:<H>heap_append>, which is a
+ heapify, and the hold model, which pops the minimum and adds it back with a
+ random increment, at size `n`. The priorities are `unsigned`, `size_t`,
+ `double` with a `HEAP_COMPARE`, `double` as a `key_u64` from <../src/key.h>,
+ and `unsigned` with a `HEAP_VALUE` payload; they come out of `random`,
+ `sorted`, `reverse`, or `duplicate`, which has only sixteen values.
+
+ Each argument is a size; the default is a range up to `10^7`. Sizes under a
+ million are repeated up to a million operations, so the clock can see them.
+ The priorities and the increments are drawn before the clock starts.
+ The timed heaps use the default compare, which is inlined. The calls to
+ compare are counted by a second pass of the same operations on the same type
+ of heap with `HEAP_STATS`. Where Linux lets <perf.h> open hardware counters,
+ they are per operation, too; otherwise, those columns are empty. Prints CSV to
+ `stdout`.
+
+ @std C89; Linux `perf_event_open` optional */
+
+#define _GNU_SOURCE /* syscall clock_gettime */
+#include <stdlib.h> /* EXIT strtoul rand malloc free */
+#include <stdio.h>  /* printf */
+#include <time.h>   /* clock_gettime */
+#include <errno.h>  /* errno */
+#include "../src/key.h"
+#include "perf.h"
+
+/** 32-bit random number; `rand` may only have 15 bits. */
+static unsigned random32(void) {
+	return (unsigned)rand() ^ (unsigned)rand() << 15 ^ (unsigned)rand() << 30;
+}
+
+static const char *const dists[] = { "random", "sorted", "reverse",
+	"duplicate" };
+static const char *const ops[] = { "add", "peek", "hold", "pop", "append" };
+enum { ADD, PEEK, HOLD, POP, APPEND, OPS };
+
+/** Totals of each operation of a benchmark. */
+static struct {
+	struct perf perf;
+	double t0;
+	double t[OPS], e[OPS][PERF_SIZE];
+	size_t c0, c[OPS];
+} run;
+
+/** @return Seconds of wall time. */
+static double now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+/** Starts measuring an operation on `heap`, which is not used. */
+#define TIME_BEGIN(heap) (perf_start(&run.perf), run.t0 = now())
+
+/** Adds the time and the counters since <fn:TIME_BEGIN> to `op`. */
+#define TIME_END(heap, op) \
+	(run.t[op] += now() - run.t0, perf_stop(&run.perf, run.e[op]))
+
+/** Starts counting the compares of an operation on `heap`. */
+#define COUNT_BEGIN(heap) (run.c0 = (heap).stats.compares)
+
+/** Adds the compares of `heap` since <fn:COUNT_BEGIN> to `op`. */
+#define COUNT_END(heap, op) (run.c[op] += (heap).stats.compares - run.c0)
+
+/** @return The `i`th of `n` priorities from distribution `dist`. */
+static unsigned generate(const size_t dist, const size_t i, const size_t n) {
+	switch(dist) {
+	case 1: return (unsigned)i;
+	case 2: return (unsigned)(n - i);
+	case 3: return random32() & 15;
+	default: return random32();
+	}
+}
+
+/** Adds each operation on a <tag:<H>heap> of `N` from `dist`, repeated
+ `reps` times, to `run`, measured with `BEGIN` and `END`. `T` converts the
+ nodes. @return Success. */
+#define BENCH(H, T, N, BEGIN, END) \
+static int H##_bench(const size_t dist, const size_t n, const size_t reps) { \
+	struct H##_heap heap = H##_heap_idle; \
+	N *const in = malloc(sizeof *in * n), *buffer, node; \
+	unsigned *const step = malloc(sizeof *step * n); \
+	size_t r, i; \
+	volatile unsigned sink = 0; \
+	if(!in || !step) goto catch; \
+	srand(1); \
+	for(r = 0; r < reps; r++) { \
+		H##_heap_clear(&heap); \
+		for(i = 0; i < n; i++) in[i] = T##_node(generate(dist, i, n)); \
+		for(i = 0; i < n; i++) step[i] = random32() >> 20; \
+		BEGIN(heap); \
+		for(i = 0; i < n; i++) if(!H##_heap_add(&heap, in[i])) goto catch; \
+		END(heap, ADD), BEGIN(heap); \
+		for(i = 0; i < n; i++) sink ^= T##_priority(H##_heap_peek(&heap)); \
+		END(heap, PEEK), BEGIN(heap); \
+		for(i = 0; i < n; i++) { \
+			node = *H##_heap_peek(&heap), H##_heap_pop(&heap); \
+			if(!H##_heap_add(&heap, T##_node(T##_priority(&node) \
+				+ step[i]))) goto catch; \
+		} \
+		END(heap, HOLD), BEGIN(heap); \
+		for(i = 0; i < n; i++) H##_heap_pop(&heap); \
+		END(heap, POP); \
+		if(!(buffer = H##_heap_buffer(&heap, n))) goto catch; \
+		for(i = 0; i < n; i++) buffer[i] = T##_node(generate(dist, i, n)); \
+		BEGIN(heap); \
+		H##_heap_append(&heap, n); \
+		END(heap, APPEND); \
+	} \
+	H##_heap_(&heap), free(in), free(step); \
+	return 1; \
+catch: \
+	H##_heap_(&heap), free(in), free(step); \
+	return 0; \
+}
+
+static int double_compare(const double a, const double b) { return a > b; }
+static struct item { unsigned id; } item;
+
+/* Converts to and from the generated `unsigned`. */
+static unsigned unsigned_node(const unsigned x) { return x; }
+static unsigned unsigned_priority(const unsigned *const n) { return *n; }
+static size_t size_node(const unsigned x) { return x; }
+static unsigned size_priority(const size_t *const n) { return (unsigned)*n; }
+static double double_node(const unsigned x)
+	{ return (double)x - 2147483648.0; }
+static unsigned double_priority(const double *const n)
+	{ return (unsigned)(*n + 2147483648.0); }
+static key_u64 key_node(const unsigned x)
+	{ return key_double((double)x - 2147483648.0); }
+static unsigned key_priority(const key_u64 *const n)
+	{ return (unsigned)(key_to_double(*n) + 2147483648.0); }
+
+#define HEAP_NAME unsigned
+#include "../src/heap.h"
+BENCH(unsigned, unsigned, unsigned, TIME_BEGIN, TIME_END)
+#define HEAP_NAME unsigned_count
+#define HEAP_STATS
+#include "../src/heap.h"
+BENCH(unsigned_count, unsigned, unsigned, COUNT_BEGIN, COUNT_END)
+
+#define HEAP_NAME size
+#define HEAP_TYPE size_t
+#include "../src/heap.h"
+BENCH(size, size, size_t, TIME_BEGIN, TIME_END)
+#define HEAP_NAME size_count
+#define HEAP_TYPE size_t
+#define HEAP_STATS
+#include "../src/heap.h"
+BENCH(size_count, size, size_t, COUNT_BEGIN, COUNT_END)
+
+#define HEAP_NAME double
+#define HEAP_TYPE double
+#define HEAP_COMPARE &double_compare
+#include "../src/heap.h"
+BENCH(double, double, double, TIME_BEGIN, TIME_END)
+#define HEAP_NAME double_count
+#define HEAP_TYPE double
+#define HEAP_COMPARE &double_compare
+#define HEAP_STATS
+#include "../src/heap.h"
+BENCH(double_count, double, double, COUNT_BEGIN, COUNT_END)
+
+#define HEAP_NAME key
+#define HEAP_TYPE key_u64
+#include "../src/heap.h"
+BENCH(key, key, key_u64, TIME_BEGIN, TIME_END)
+#define HEAP_NAME key_count
+#define HEAP_TYPE key_u64
+#define HEAP_STATS
+#include "../src/heap.h"
+BENCH(key_count, key, key_u64, COUNT_BEGIN, COUNT_END)
+
+#define HEAP_NAME value
+#define HEAP_VALUE struct item
+#include "../src/heap.h"
+static struct value_heap_node value_node(const unsigned x)
+	{ struct value_heap_node n; n.priority = x, n.value = &item; return n; }
+static unsigned value_priority(const struct value_heap_node *const n)
+	{ return n->priority; }
+BENCH(value, value, struct value_heap_node, TIME_BEGIN, TIME_END)
+#define HEAP_NAME value_count
+#define HEAP_VALUE struct item
+#define HEAP_STATS
+#include "../src/heap.h"
+static struct value_count_heap_node value_count_node(const unsigned x) {
+	struct value_count_heap_node n;
+	n.priority = x, n.value = &item;
+	return n;
+}
+static unsigned value_count_priority(const struct value_count_heap_node
+	*const n) { return n->priority; }
+BENCH(value_count, value_count, struct value_count_heap_node,
+	COUNT_BEGIN, COUNT_END)
+#undef BENCH
+
+int main(int argc, char **argv) {
+	static const size_t sizes[] = { 1000, 10000, 100000, 1000000, 10000000 };
+	static const struct { const char *name; int (*bench)(size_t, size_t,
+		size_t), (*count)(size_t, size_t, size_t); } types[] = {
+		{ "unsigned", &unsigned_bench, &unsigned_count_bench },
+		{ "size_t", &size_bench, &size_count_bench },
+		{ "double", &double_bench, &double_count_bench },
+		{ "key_u64", &key_bench, &key_count_bench },
+		{ "value", &value_bench, &value_count_bench } };
+	const size_t sizes_size = argc > 1 ? (size_t)(argc - 1)
+		: sizeof sizes / sizeof *sizes;
+	size_t s, n, reps, type, dist, op, i;
+	double total;
+	if(!perf_open(&run.perf))
+		fprintf(stderr, "heap: no hardware counters; leaving them empty.\n");
+	printf("type,distribution,operation,n,ns_per_op,compares_per_op");
+	for(i = 0; i < PERF_SIZE; i++) printf(",%s_per_op", perf_names[i]);
+	printf("\n");
+	for(s = 0; s < sizes_size; s++) {
+		n = argc > 1 ? (size_t)strtoul(argv[s + 1], 0, 0) : sizes[s];
+		if(!n) { errno = EDOM; goto catch; }
+		reps = n < 1000000 ? 1000000 / n : 1;
+		total = (double)n * (double)reps;
+		for(type = 0; type < sizeof types / sizeof *types; type++) {
+			for(dist = 0; dist < sizeof dists / sizeof *dists; dist++) {
+				memset(run.t, 0, sizeof run.t), memset(run.e, 0, sizeof run.e);
+				memset(run.c, 0, sizeof run.c);
+				if(!types[type].bench(dist, n, reps)
+					|| !types[type].count(dist, n, reps)) goto catch;
+				for(op = 0; op < OPS; op++) {
+					printf("%s,%s,%s,%lu,%f,%f", types[type].name, dists[dist],
+						ops[op], (unsigned long)n, run.t[op] * 1e9 / total,
+						(double)run.c[op] / total);
+					for(i = 0; i < PERF_SIZE; i++) if(run.perf.fd[i] >= 0)
+						printf(",%f", run.e[op][i] / total); else printf(",");
+					printf("\n");
+				}
+				fflush(stdout);
+			}
+		}
+	}
+	perf_close(&run.perf);
+	return EXIT_SUCCESS;
+catch:
+	perror("heap");
+	perf_close(&run.perf);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,119 @@
+/** @license 2021 Neil Edelman, distributed under the terms of the
+ [MIT License](https://opensource.org/licenses/MIT).
+
+ The bulk operations of <../src/heap.h> with `HEAP_THREADS` of one, two,
+ four, and eight: `heapify` is <fn:<H>heap_append> of `n` random `unsigned`
+ priorities to an empty heap, and `drain` is <fn:<H>heap_drain> of it. On one
+ thread, `pop` is the same drain by <fn:<H>heap_pop>, for comparison. The
+ time is of the wall, with `clock_gettime`, because the processor time is the
+ sum of the threads. Each argument is a size; the default
+ is a range up to `10^7`. Prints CSV to `stdout`.
+
+ @std POSIX.1c */
+
+#define _POSIX_C_SOURCE 199506L /* clock_gettime pthread */
+#include <stdlib.h> /* EXIT strtoul rand realloc free */
+#include <stdio.h>  /* printf */
+#include <string.h> /* memcpy */
+#include <errno.h>  /* errno */
+#include <time.h>   /* clock_gettime */
+
+#define HEAP_NAME one
+#include "../src/heap.h"
+
+#define HEAP_NAME two
+#define HEAP_THREADS 2
+#include "../src/heap.h"
+
+#define HEAP_NAME four
+#define HEAP_THREADS 4
+#include "../src/heap.h"
+
+#define HEAP_NAME eight
+#define HEAP_THREADS 8
+#include "../src/heap.h"
+
+/** @return Seconds. */
+static double now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+/** 32-bit random number; `rand` may only have 15 bits. */
+static unsigned random32(void) {
+	return (unsigned)rand() ^ (unsigned)rand() << 15 ^ (unsigned)rand() << 30;
+}
+
+enum { HEAPIFY, DRAIN, POP, OPS };
+static const char *const ops[] = { "heapify", "drain", "pop" };
+
+/** Builds a <tag:<H>heap> of `n` and drains it into `sorted`, and, if
+ `is_pop`, builds it again and pops it, putting the seconds in `t`.
+ @return Success. */
+#define BULK(H) \
+static int H##_bulk(const size_t n, unsigned *const sorted, \
+	const int is_pop, double *const t) { \
+	struct H##_heap heap = HEAP_IDLE; \
+	unsigned *buffer; \
+	size_t i, r; \
+	for(r = 0; r <= !!is_pop; r++) { \
+		if(!(buffer = H##_heap_buffer(&heap, n))) return 0; \
+		srand(1); \
+		for(i = 0; i < n; i++) buffer[i] = random32(); \
+		t[HEAPIFY] = now(); \
+		H##_heap_append(&heap, n); \
+		t[HEAPIFY] = now() - t[HEAPIFY]; \
+		if(r) { \
+			t[POP] = now(); \
+			for(i = 0; i < n; i++) \
+				sorted[i] = *H##_heap_peek(&heap), H##_heap_pop(&heap); \
+			t[POP] = now() - t[POP]; \
+		} else { \
+			t[DRAIN] = now(); \
+			H##_heap_drain(&heap, sorted); \
+			t[DRAIN] = now() - t[DRAIN]; \
+		} \
+	} \
+	H##_heap_(&heap); \
+	return 1; \
+}
+BULK(one)
+BULK(two)
+BULK(four)
+BULK(eight)
+#undef BULK
+
+int main(int argc, char **argv) {
+	static const size_t sizes[] = { 100000, 1000000, 10000000 };
+	static const struct { unsigned threads; int (*bulk)(size_t, unsigned *,
+		int, double *); } bulks[] = { { 1, &one_bulk }, { 2, &two_bulk },
+		{ 4, &four_bulk }, { 8, &eight_bulk } };
+	const size_t sizes_size = argc > 1 ? (size_t)(argc - 1)
+		: sizeof sizes / sizeof *sizes;
+	unsigned *sorted = 0, *next;
+	size_t s, n, b, op;
+	double t[OPS], t1[OPS];
+	printf("operation,threads,n,s,ns_per_node,speedup\n");
+	for(s = 0; s < sizes_size; s++) {
+		n = argc > 1 ? (size_t)strtoul(argv[s + 1], 0, 0) : sizes[s];
+		if(!n) { errno = EDOM; goto catch; }
+		if(!(next = realloc(sorted, sizeof *sorted * n))) goto catch;
+		sorted = next;
+		for(b = 0; b < sizeof bulks / sizeof *bulks; b++) {
+			if(!bulks[b].bulk(n, sorted, !b, t)) goto catch;
+			if(!b) memcpy(t1, t, sizeof t);
+			for(op = 0; op < (b ? POP : OPS); op++)
+				printf("%s,%u,%lu,%f,%f,%f\n", ops[op], bulks[b].threads,
+				(unsigned long)n, t[op], t[op] * 1e9 / (double)n,
+				t[op] > 0.0 ? t1[op] / t[op] : 0.0);
+			fflush(stdout);
+		}
+	}
+	free(sorted);
+	return EXIT_SUCCESS;
+catch:
+	perror("heapify");
+	free(sorted);
+	return EXIT_FAILURE;
+}
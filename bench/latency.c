@@ -0,0 +1,137 @@
+/** @license 2021 Neil Edelman, distributed under the terms of the
+ [MIT License](https://opensource.org/licenses/MIT).
+
+ Tail latency of single operations of <../src/heap.h>. Every
+ <fn:<H>heap_add> and <fn:<H>heap_pop> is timed on its own with
+ `clock_gettime` and recorded in a log-linear histogram, in the manner of
+ <Tene, HdrHistogram>: each power-of-two range of nanoseconds is split into
+ `HDR_SUB` buckets, so every percentile is within `1/HDR_SUB` of the truth.
+
+ For each size `n`, `fill` is the adds from empty to `n`, which include the
+ stalls of growing the array. Then, in the steady state of the hold model,
+ `hold_pop` and `hold_add` are the halves of popping the minimum and adding it
+ back with a random increment, for `samples` rounds after as many to warm up.
+ `timer` is two calls to the clock with nothing between them, which is in
+ every other number. Each argument is a size; the default is a range of sizes.
+ Prints CSV to `stdout` in nanoseconds.
+
+ @std POSIX.1b */
+
+#define _POSIX_C_SOURCE 199309L /* clock_gettime */
+#include <stdlib.h> /* EXIT strtoul rand */
+#include <stdio.h>  /* printf */
+#include <string.h> /* memset */
+#include <errno.h>  /* errno */
+#include <time.h>   /* clock_gettime */
+
+#define HEAP_NAME plain
+#include "../src/heap.h"
+
+#define HDR_BITS 5
+#define HDR_SUB (1u << HDR_BITS)
+#define HDR_SIZE ((64 - HDR_BITS + 1) * HDR_SUB)
+
+/** Log-linear buckets of nanoseconds. */
+struct histogram { size_t bucket[HDR_SIZE], count; unsigned long max; };
+
+static const size_t samples = 1000000;
+
+/** @return Nanoseconds. */
+static unsigned long now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (unsigned long)t.tv_sec * 1000000000ul + (unsigned long)t.tv_nsec;
+}
+
+/** 32-bit random number; `rand` may only have 15 bits. */
+static unsigned random32(void) {
+	return (unsigned)rand() ^ (unsigned)rand() << 15 ^ (unsigned)rand() << 30;
+}
+
+/** Records `ns` in `h`. */
+static void record(struct histogram *const h, const unsigned long ns) {
+	unsigned log = 0;
+	unsigned long v = ns;
+	if(ns > h->max) h->max = ns;
+	h->count++;
+	if(ns < HDR_SUB) { h->bucket[ns]++; return; }
+	while(v >>= 1) log++;
+	h->bucket[(log - HDR_BITS + 1) * HDR_SUB
+		+ (ns >> (log - HDR_BITS)) - HDR_SUB]++;
+}
+
+/** @return The largest value in bucket `i`. */
+static unsigned long highest(const size_t i) {
+	const unsigned shift = (unsigned)(i / HDR_SUB);
+	return i < HDR_SUB ? i : ((i % HDR_SUB + HDR_SUB + 1) << (shift - 1)) - 1;
+}
+
+/** @return An upper bound on the `q` quantile of `h`. */
+static unsigned long quantile(const struct histogram *const h,
+	const double q) {
+	size_t i, sum = 0;
+	const size_t target = (size_t)(q * (double)h->count);
+	unsigned long v;
+	for(i = 0; i < HDR_SIZE; i++) if((sum += h->bucket[i]) > target)
+		return (v = highest(i)) < h->max ? v : h->max;
+	return h->max;
+}
+
+/** Prints `h` of `op` at size `n`. */
+static void print(const char *const op, const size_t n,
+	const struct histogram *const h) {
+	printf("%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n", op, (unsigned long)n,
+		(unsigned long)h->count, quantile(h, 0.5), quantile(h, 0.9),
+		quantile(h, 0.99), quantile(h, 0.999), quantile(h, 0.9999),
+		quantile(h, 0.99999), h->max);
+}
+
+int main(int argc, char **argv) {
+	static const size_t sizes[] = { 1000, 100000, 10000000 };
+	const size_t sizes_size = argc > 1 ? (size_t)(argc - 1)
+		: sizeof sizes / sizeof *sizes;
+	struct plain_heap heap = HEAP_IDLE;
+	static struct histogram timer, fill, pop, add;
+	unsigned long t0, t1;
+	unsigned p;
+	size_t s, n, i;
+	printf("operation,n,samples,p50_ns,p90_ns,p99_ns,p999_ns,p9999_ns,"
+		"p99999_ns,max_ns\n");
+	for(s = 0; s < sizes_size; s++) {
+		n = argc > 1 ? (size_t)strtoul(argv[s + 1], 0, 0) : sizes[s];
+		if(!n) { errno = EDOM; goto catch; }
+		memset(&timer, 0, sizeof timer), memset(&fill, 0, sizeof fill);
+		memset(&pop, 0, sizeof pop), memset(&add, 0, sizeof add);
+		srand(1), plain_heap_(&heap);
+		for(i = 0; i < samples; i++)
+			t0 = now(), t1 = now(), record(&timer, t1 - t0);
+		for(i = 0; i < n; i++) {
+			p = random32() >> 1;
+			t0 = now();
+			if(!plain_heap_add(&heap, p)) goto catch;
+			t1 = now(), record(&fill, t1 - t0);
+		}
+		for(i = 0; i < samples << 1; i++) {
+			const int is_warm = i >= samples;
+			p = *plain_heap_peek(&heap);
+			t0 = now();
+			plain_heap_pop(&heap);
+			t1 = now();
+			if(is_warm) record(&pop, t1 - t0);
+			p += random32() >> 8;
+			t0 = now();
+			if(!plain_heap_add(&heap, p)) goto catch;
+			t1 = now();
+			if(is_warm) record(&add, t1 - t0);
+		}
+		print("timer", n, &timer), print("fill", n, &fill);
+		print("hold_pop", n, &pop), print("hold_add", n, &add);
+		fflush(stdout);
+	}
+	plain_heap_(&heap);
+	return EXIT_SUCCESS;
+catch:
+	perror("latency");
+	plain_heap_(&heap);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,222 @@
+/** @license 2021 Neil Edelman, distributed under the terms of the
+ [MIT License](https://opensource.org/licenses/MIT).
+
+ Alloc/free throughput of <../test/magazine.h> against one <../test/pool.h>
+ behind a mutex, from one to `threads` threads, (the optional argument,
+ default 8.) Each thread holds `live` items and, `ops` times, removes a random
+ one and adds a new one. In the `cross` columns, the threads are in a ring
+ instead: each round, a thread adds `live` items, and after every thread has,
+ it removes the ones of the next thread, so every remove is of an item that
+ another thread allocated. Prints CSV to `stdout`; throughput is in millions
+ of operations, each an add and a remove, per second of wall time.
+
+ @std POSIX.1c */
+
+#define _POSIX_C_SOURCE 199506L /* clock_gettime pthread */
+#include <stdlib.h>  /* EXIT strtoul */
+#include <stdio.h>   /* printf */
+#include <time.h>    /* clock_gettime */
+#include <pthread.h> /* pthread_* */
+
+struct item { size_t key, value; };
+
+#define POOL_NAME locked
+#define POOL_TYPE struct item
+#include "../test/pool.h"
+
+#define MAGAZINE_NAME item
+#define MAGAZINE_TYPE struct item
+#include "../test/magazine.h"
+
+static const size_t live = 1000, ops = 2000000;
+
+static struct { pthread_mutex_t lock; struct locked_pool pool; }
+	locked = { PTHREAD_MUTEX_INITIALIZER, POOL_IDLE };
+static struct item_magazine magazine = MAGAZINE_IDLE;
+
+/** The ring of the cross-thread mode: `live` items that each of `threads`
+ hands to the one before it, and a barrier between the rounds. */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t turn;
+	size_t threads, waiting, round;
+	struct item **box;
+} cross = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, 0, 0 };
+
+/** @return Seconds. */
+static double now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+/** Churns the locked pool; `vseed` is the seed. @return Null on success. */
+static void *locked_thread(void *const vseed) {
+	struct item **const hold = malloc(sizeof *hold * live), *item;
+	unsigned seed = *(unsigned *)vseed;
+	size_t i, n = 0;
+	void *result = (void *)1;
+	if(!hold) return result;
+	for(n = 0; n < live; n++) {
+		pthread_mutex_lock(&locked.lock);
+		item = locked_pool_new(&locked.pool);
+		pthread_mutex_unlock(&locked.lock);
+		if(!(hold[n] = item)) goto finally;
+	}
+	for(i = 0; i < ops; i++) {
+		const size_t r = (seed = seed * 1103515245u + 12345u) >> 8;
+		int is_ok;
+		item = hold[r % live];
+		pthread_mutex_lock(&locked.lock);
+		is_ok = locked_pool_remove(&locked.pool, item)
+			&& (item = locked_pool_new(&locked.pool));
+		pthread_mutex_unlock(&locked.lock);
+		if(!is_ok) goto finally;
+		(hold[r % live] = item)->key = i;
+	}
+	result = 0;
+finally:
+	pthread_mutex_lock(&locked.lock);
+	while(n) locked_pool_remove(&locked.pool, hold[--n]);
+	pthread_mutex_unlock(&locked.lock);
+	free(hold);
+	return result;
+}
+
+/** Churns a cache of the magazine; `vseed` is the seed.
+ @return Null on success. */
+static void *magazine_thread(void *const vseed) {
+	struct item **const hold = malloc(sizeof *hold * live), *item;
+	struct item_magazine_cache *const cache = item_magazine_acquire(&magazine);
+	unsigned seed = *(unsigned *)vseed;
+	size_t i, n = 0;
+	void *result = (void *)1;
+	if(!hold || !cache) goto finally;
+	for(n = 0; n < live; n++)
+		if(!(hold[n] = item_magazine_new(cache))) goto finally;
+	for(i = 0; i < ops; i++) {
+		const size_t r = (seed = seed * 1103515245u + 12345u) >> 8;
+		if(!item_magazine_remove(cache, hold[r % live])
+			|| !(item = item_magazine_new(cache))) goto finally;
+		(hold[r % live] = item)->key = i;
+	}
+	result = 0;
+finally:
+	while(n) item_magazine_remove(cache, hold[--n]);
+	item_magazine_release(cache);
+	free(hold);
+	return result;
+}
+
+/** Waits until every thread in `cross` has called this. */
+static void cross_wait(void) {
+	size_t round;
+	pthread_mutex_lock(&cross.lock);
+	round = cross.round;
+	if(++cross.waiting == cross.threads)
+		cross.waiting = 0, cross.round++, pthread_cond_broadcast(&cross.turn);
+	else while(round == cross.round)
+		pthread_cond_wait(&cross.turn, &cross.lock);
+	pthread_mutex_unlock(&cross.lock);
+}
+
+/** Churns the locked pool in the ring of `cross`; `vseed` is one more than
+ the index in it. @return Null on success. */
+static void *locked_cross_thread(void *const vseed) {
+	const size_t k = *(unsigned *)vseed - 1;
+	struct item **const mine = cross.box + k * live,
+		**const theirs = cross.box + (k + 1) % cross.threads * live, *item;
+	size_t i, j;
+	int is_ok = 1;
+	for(i = 0; i < ops; i += live) {
+		for(j = 0; j < live; j++) {
+			item = 0;
+			pthread_mutex_lock(&locked.lock);
+			if(is_ok && !(item = locked_pool_new(&locked.pool))) is_ok = 0;
+			pthread_mutex_unlock(&locked.lock);
+			if((mine[j] = item)) item->key = i + j;
+		}
+		cross_wait();
+		for(j = 0; j < live; j++) {
+			if(!theirs[j]) continue;
+			pthread_mutex_lock(&locked.lock);
+			if(!locked_pool_remove(&locked.pool, theirs[j])) is_ok = 0;
+			pthread_mutex_unlock(&locked.lock);
+		}
+		cross_wait();
+	}
+	return is_ok ? 0 : (void *)1;
+}
+
+/** Churns a cache of the magazine in the ring of `cross`; `vseed` is one
+ more than the index in it. @return Null on success. */
+static void *magazine_cross_thread(void *const vseed) {
+	const size_t k = *(unsigned *)vseed - 1;
+	struct item **const mine = cross.box + k * live,
+		**const theirs = cross.box + (k + 1) % cross.threads * live;
+	struct item_magazine_cache *const cache = item_magazine_acquire(&magazine);
+	size_t i, j;
+	int is_ok = !!cache;
+	for(i = 0; i < ops; i += live) {
+		for(j = 0; j < live; j++) {
+			if(!(mine[j] = is_ok ? item_magazine_new(cache) : 0)) is_ok = 0;
+			else mine[j]->key = i + j;
+		}
+		cross_wait();
+		for(j = 0; j < live; j++) if(theirs[j]
+			&& !item_magazine_remove(cache, theirs[j])) is_ok = 0;
+		cross_wait();
+	}
+	if(cache && !item_magazine_release(cache)) is_ok = 0;
+	return is_ok ? 0 : (void *)1;
+}
+
+/** Runs `fn` on `n` threads. @return Seconds, or negative on error. */
+static double run(void *(*const fn)(void *), const size_t n) {
+	pthread_t *const thread = malloc(sizeof *thread * n);
+	unsigned *const seed = malloc(sizeof *seed * n);
+	size_t i, started = 0;
+	double t0, t = -1.0;
+	void *result;
+	int is_ok = 1;
+	if(!thread || !seed) goto finally;
+	t0 = now();
+	for(started = 0; started < n; started++)
+		if(seed[started] = (unsigned)started + 1,
+			pthread_create(thread + started, 0, fn, seed + started)) break;
+	for(i = 0; i < started; i++)
+		if(pthread_join(thread[i], &result) || result) is_ok = 0;
+	if(is_ok && started == n) t = now() - t0;
+finally:
+	free(thread), free(seed);
+	return t;
+}
+
+int main(int argc, char **argv) {
+	const size_t threads = argc > 1 ? (size_t)strtoul(argv[1], 0, 0) : 8;
+	size_t n;
+	double tl, tm, cl, cm;
+	if(!threads || !(cross.box = malloc(sizeof *cross.box * threads * live)))
+		goto catch;
+	printf("threads,ops,locked_mops,magazine_mops,speedup,"
+		"cross_locked_mops,cross_magazine_mops,cross_speedup\n");
+	for(n = 1; n <= threads; n++) {
+		cross.threads = n;
+		if((tl = run(&locked_thread, n)) < 0.0
+			|| (tm = run(&magazine_thread, n)) < 0.0
+			|| (cl = run(&locked_cross_thread, n)) < 0.0
+			|| (cm = run(&magazine_cross_thread, n)) < 0.0) goto catch;
+		printf("%lu,%lu,%f,%f,%.2f,%f,%f,%.2f\n", (unsigned long)n,
+			(unsigned long)(n * ops), (double)(n * ops) / tl / 1e6,
+			(double)(n * ops) / tm / 1e6, tl / tm, (double)(n * ops) / cl / 1e6,
+			(double)(n * ops) / cm / 1e6, cl / cm);
+	}
+	free(cross.box);
+	locked_pool_(&locked.pool), item_magazine_(&magazine);
+	return EXIT_SUCCESS;
+catch:
+	perror("magazine");
+	free(cross.box);
+	locked_pool_(&locked.pool), item_magazine_(&magazine);
+	return EXIT_FAILURE;
+}
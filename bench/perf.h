@@ -0,0 +1,126 @@
+/** @license 2021 Neil Edelman, distributed under the terms of the
+ [MIT License](https://opensource.org/licenses/MIT).
+
+ @subtitle Hardware Counters
+
+ A <tag:perf> holds hardware counters from Linux `perf_event_open` for the
+ calling thread in user space: cycles, instructions, level-one data-cache read
+ misses, last-level cache misses, data-TLB read misses, and branch misses.
+ Each counter is opened on its own, so the kernel can multiplex more than
+ the hardware has; <fn:perf_stop> scales them by the time they ran.
+
+ Counters are often unavailable: other systems, containers and virtual
+ machines without a PMU, or `/proc/sys/kernel/perf_event_paranoid` is too
+ high. Those that fail to open are never counted, and <fn:perf_open> says how
+ many did, so a benchmark can go on without them. On Linux, it needs
+ `_GNU_SOURCE` or `_DEFAULT_SOURCE` for `syscall`.
+
+ @std C89; Linux `perf_event_open` optional */
+
+#ifndef PERF_H /* <!-- idempotent */
+#define PERF_H
+
+#include <string.h> /* memset */
+#ifdef __linux__ /* <!-- linux */
+#include <unistd.h>             /* syscall read close */
+#include <sys/syscall.h>        /* SYS_perf_event_open */
+#include <sys/ioctl.h>          /* ioctl */
+#include <linux/perf_event.h>   /* perf_event_attr PERF_* */
+#endif /* linux --> */
+
+enum { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_L1D_MISSES, PERF_LLC_MISSES,
+	PERF_DTLB_MISSES, PERF_BRANCH_MISSES, PERF_SIZE };
+static const char *const perf_names[] = { "cycles", "instructions",
+	"l1d_misses", "llc_misses", "dtlb_misses", "branch_misses" };
+
+/** The counters, which are closed if `fd` is negative. */
+struct perf { int fd[PERF_SIZE]; };
+
+#ifdef __linux__ /* <!-- linux */
+/** @return An opened counter of `type` and `config`, or -1. */
+static int perf_counter(const unsigned type, const unsigned long config) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof attr);
+	attr.size = sizeof attr, attr.type = type, attr.config = config;
+	attr.disabled = 1, attr.exclude_kernel = 1, attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+		| PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif /* linux --> */
+
+/** Opens all the counters of `p` that it can. @return How many. */
+static unsigned perf_open(struct perf *const p) {
+	unsigned i, n = 0;
+#ifdef __linux__ /* <!-- linux */
+#define PERF_CACHE(c, r) (PERF_COUNT_HW_CACHE_##c \
+	| PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_##r << 16)
+	p->fd[PERF_CYCLES]
+		= perf_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	p->fd[PERF_INSTRUCTIONS]
+		= perf_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	p->fd[PERF_L1D_MISSES]
+		= perf_counter(PERF_TYPE_HW_CACHE, PERF_CACHE(L1D, MISS));
+	p->fd[PERF_LLC_MISSES]
+		= perf_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	p->fd[PERF_DTLB_MISSES]
+		= perf_counter(PERF_TYPE_HW_CACHE, PERF_CACHE(DTLB, MISS));
+	p->fd[PERF_BRANCH_MISSES]
+		= perf_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#undef PERF_CACHE
+#else /* linux --><!-- !linux */
+	for(i = 0; i < PERF_SIZE; i++) p->fd[i] = -1;
+#endif /* !linux --> */
+	for(i = 0; i < PERF_SIZE; i++) if(p->fd[i] >= 0) n++;
+	return n;
+}
+
+/** Closes the counters of `p`. */
+static void perf_close(struct perf *const p) {
+	unsigned i;
+	for(i = 0; i < PERF_SIZE; i++) {
+#ifdef __linux__ /* <!-- linux */
+		if(p->fd[i] >= 0) close(p->fd[i]);
+#endif /* linux --> */
+		p->fd[i] = -1;
+	}
+}
+
+/** Zeros and starts the counters of `p`. */
+static void perf_start(struct perf *const p) {
+#ifdef __linux__ /* <!-- linux */
+	unsigned i;
+	for(i = 0; i < PERF_SIZE; i++) if(p->fd[i] >= 0)
+		ioctl(p->fd[i], PERF_EVENT_IOC_RESET, 0),
+		ioctl(p->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+#else /* linux --><!-- !linux */
+	(void)p;
+#endif /* !linux --> */
+}
+
+/** Stops the counters of `p` and adds them to `count`, scaled up if they were
+ multiplexed; those that are not open are left alone. */
+static void perf_stop(struct perf *const p, double *const count) {
+#ifdef __linux__ /* <!-- linux */
+	unsigned i;
+	__u64 v[3]; /* Value, time enabled, time running. */
+	for(i = 0; i < PERF_SIZE; i++) if(p->fd[i] >= 0)
+		ioctl(p->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+	for(i = 0; i < PERF_SIZE; i++) {
+		if(p->fd[i] < 0 || read(p->fd[i], v, sizeof v) != (ssize_t)sizeof v
+			|| !v[2]) continue;
+		count[i] += (double)v[0] * ((double)v[1] / (double)v[2]);
+	}
+#else /* linux --><!-- !linux */
+	(void)p, (void)count;
+#endif /* !linux --> */
+}
+
+static void perf_unused_coda(void);
+static void perf_unused(void) {
+	perf_open(0); perf_close(0); perf_start(0); perf_stop(0, 0);
+	perf_unused_coda();
+}
+static void perf_unused_coda(void) { perf_unused(); }
+
+#endif /* idempotent --> */
@@ -0,0 +1,105 @@
+/** @license 2021 Neil Edelman, distributed under the terms of the
+ [MIT License](https://opensource.org/licenses/MIT).
+
+ Benchmarks alloc/free churn in <../test/pool.h> with the default free-heap
+ against `POOL_FREE_LIST`. The pool is filled to `n`, then, `ops` times, a
+ random item is removed and a new one is added; the items are drawn before
+ the clock starts. Each argument is a size; the default is a range of sizes.
+ Prints CSV to `stdout`.
+
+ @std POSIX.1b */
+
+#define _POSIX_C_SOURCE 199309L /* clock_gettime */
+#include <stdlib.h> /* EXIT strtoul rand */
+#include <stdio.h>  /* printf */
+#include <time.h>   /* clock_gettime */
+
+struct item { size_t key, value; };
+
+#define POOL_NAME heap
+#define POOL_TYPE struct item
+#include "../test/pool.h"
+
+#define POOL_NAME list
+#define POOL_TYPE struct item
+#define POOL_FREE_LIST
+#include "../test/pool.h"
+
+/** @return Seconds of wall time. */
+static double now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+/** 32-bit random number; `rand` may only have 15 bits. */
+static unsigned random32(void) {
+	return (unsigned)rand() ^ (unsigned)rand() << 15 ^ (unsigned)rand() << 30;
+}
+
+/** Fills `live` with `n` from `pool`, then churns it `ops` times, replacing
+ the items at `index`. @return Seconds, or negative on error. */
+static double heap_churn(struct heap_pool *const pool,
+	struct item **const live, const size_t n, const unsigned *const index,
+	const size_t ops) {
+	double t0;
+	size_t i, r;
+	for(i = 0; i < n; i++) if(!(live[i] = heap_pool_new(pool))) return -1.0;
+	t0 = now();
+	for(i = 0; i < ops; i++) {
+		r = index[i];
+		if(!heap_pool_remove(pool, live[r])
+			|| !(live[r] = heap_pool_new(pool))) return -1.0;
+		live[r]->key = i;
+	}
+	return now() - t0;
+}
+
+/** Same as <fn:heap_churn> on `pool`. */
+static double list_churn(struct list_pool *const pool,
+	struct item **const live, const size_t n, const unsigned *const index,
+	const size_t ops) {
+	double t0;
+	size_t i, r;
+	for(i = 0; i < n; i++) if(!(live[i] = list_pool_new(pool))) return -1.0;
+	t0 = now();
+	for(i = 0; i < ops; i++) {
+		r = index[i];
+		if(!list_pool_remove(pool, live[r])
+			|| !(live[r] = list_pool_new(pool))) return -1.0;
+		live[r]->key = i;
+	}
+	return now() - t0;
+}
+
+int main(int argc, char **argv) {
+	static const size_t sizes[] = { 1000, 100000, 1000000, 10000000 };
+	const size_t sizes_size = argc > 1 ? (size_t)(argc - 1)
+		: sizeof sizes / sizeof *sizes, ops = 10000000;
+	size_t i, j, n;
+	struct heap_pool hp = POOL_IDLE;
+	struct list_pool lp = POOL_IDLE;
+	struct item **live = 0;
+	unsigned *index = 0;
+	double th, tl;
+	if(!(index = malloc(sizeof *index * ops))) goto catch;
+	printf("n,ops,free_heap_s,free_list_s,speedup\n");
+	for(i = 0; i < sizes_size; i++) {
+		n = argc > 1 ? (size_t)strtoul(argv[i + 1], 0, 0) : sizes[i];
+		free(live);
+		if(!n || !(live = malloc(sizeof *live * n))) goto catch;
+		srand(1);
+		for(j = 0; j < ops; j++) index[j] = (unsigned)(random32() % n);
+		th = heap_churn(&hp, live, n, index, ops), heap_pool_(&hp);
+		tl = list_churn(&lp, live, n, index, ops), list_pool_(&lp);
+		if(th < 0.0 || tl < 0.0) goto catch;
+		printf("%lu,%lu,%f,%f,%.2f\n", (unsigned long)n, (unsigned long)ops,
+			th, tl, tl > 0.0 ? th / tl : 0.0);
+	}
+	free(live), free(index);
+	return EXIT_SUCCESS;
+catch:
+	perror("pool");
+	free(live), free(index), heap_pool_(&hp), list_pool_(&lp);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,230 @@
+/** @license 2021 Neil Edelman, distributed under the terms of the
+ [MIT License](https://opensource.org/licenses/MIT).
+
+ Replays a trace from `HEAP_TRACE` in <../src/heap.h> of `unsigned`
+ priorities, the argument, against several configurations of heap. Without an
+ argument, it records a trace of the hold model, with bursts of
+ <fn:<H>heap_append>, and replays that. The trace is read into memory first,
+ so only the calls are timed. Evictions only exist with
+ `HEAP_STATIC_CAPACITY`, so they are replayed as adds. Prints CSV to `stdout`;
+ `HEAP_STATS` are only in the configuration that has them. The time is wall
+ time.
+
+ @std POSIX.1b */
+
+#define _POSIX_C_SOURCE 199309L /* clock_gettime */
+#include <stdlib.h> /* EXIT malloc free rand */
+#include <stdio.h>  /* printf fopen fread tmpfile */
+#include <string.h> /* memcmp */
+#include <errno.h>  /* errno */
+#include <time.h>   /* clock_gettime */
+#include "../src/alloc.h"
+
+#define HEAP_NAME record
+#define HEAP_TRACE
+#include "../src/heap.h"
+
+#define HEAP_NAME plain
+#include "../src/heap.h"
+
+#define HEAP_NAME stats
+#define HEAP_STATS
+#include "../src/heap.h"
+
+#define HEAP_NAME tiny
+#define HEAP_INLINE_CAPACITY 64
+#include "../src/heap.h"
+
+#define HEAP_NAME huge
+#define HEAP_ALLOC &alloc_huge
+#define HEAP_REALLOC &alloc_huge_realloc
+#define HEAP_FREE &alloc_huge_free
+#include "../src/heap.h"
+
+/** A trace in memory: each call has an `op` and a count `n`, which is the
+ number of priorities it takes from `priority`, except for buffer. */
+static struct trace {
+	char *op;
+	size_t *n, size, capacity;
+	unsigned *priority;
+	size_t priorities, priority_capacity;
+} trace;
+
+/** 32-bit random number; `rand` may only have 15 bits. */
+static unsigned random32(void) {
+	return (unsigned)rand() ^ (unsigned)rand() << 15 ^ (unsigned)rand() << 30;
+}
+
+/** Appends `op` with `n` to `trace`, and space for `priorities`.
+ @return Success. */
+static int push(const char op, const size_t n, const size_t priorities) {
+	if(trace.size >= trace.capacity) {
+		const size_t c = trace.capacity ? trace.capacity << 1 : 1024;
+		char *const o = realloc(trace.op, c);
+		size_t *ns;
+		if(!o) return 0;
+		trace.op = o;
+		if(!(ns = realloc(trace.n, sizeof *ns * c))) return 0;
+		trace.n = ns, trace.capacity = c;
+	}
+	while(trace.priorities + priorities > trace.priority_capacity) {
+		const size_t c = trace.priority_capacity
+			? trace.priority_capacity << 1 : 1024;
+		unsigned *const p = realloc(trace.priority, sizeof *p * c);
+		if(!p) return 0;
+		trace.priority = p, trace.priority_capacity = c;
+	}
+	trace.op[trace.size] = op, trace.n[trace.size++] = n;
+	return 1;
+}
+
+/** Reads `fp` into `trace`. @return Success. */
+static int load(FILE *const fp) {
+	unsigned char header[6];
+	int c;
+	size_t n;
+	if(fread(header, 1, sizeof header, fp) != sizeof header
+		|| memcmp(header, "HTR1", 4) || header[4] != sizeof(unsigned)
+		|| header[5] != sizeof(size_t)) return errno = EDOM, 0;
+	while((c = fgetc(fp)) != EOF) {
+		switch(c) {
+		case 'a': case 'r': case 'e':
+			if(!push((char)c, 1, 1)) return 0;
+			if(fread(trace.priority + trace.priorities, sizeof(unsigned), 1, fp)
+				!= 1) return errno = EDOM, 0;
+			trace.priorities++;
+			break;
+		case 'b':
+			if(fread(&n, sizeof n, 1, fp) != 1 || !push('b', n, 0))
+				return errno = EDOM, 0;
+			break;
+		case 'n':
+			if(fread(&n, sizeof n, 1, fp) != 1 || !push('n', n, n)
+				|| fread(trace.priority + trace.priorities, sizeof(unsigned), n,
+				fp) != n) return errno = EDOM, 0;
+			trace.priorities += n;
+			break;
+		case 'k': case 'p': case 'c': case 'd':
+			if(!push((char)c, 0, 0)) return 0;
+			break;
+		default: return errno = EDOM, 0;
+		}
+	}
+	return !ferror(fp);
+}
+
+/** Records the hold model on a heap of `n` to `fp`, adding in bursts of
+ `n / 10` appends every `n` calls. @return Success. */
+static int record(FILE *const fp, const size_t n) {
+	struct record_heap heap;
+	unsigned *buffer;
+	size_t i, j;
+	int is_ok = 0;
+	record_heap(&heap);
+	if(!record_heap_trace(&heap, fp)) goto finally;
+	for(i = 0; i < n; i++)
+		if(!record_heap_add(&heap, random32() >> 1)) goto finally;
+	for(i = 0; i < 10 * n; i++) {
+		const unsigned p = *record_heap_peek(&heap);
+		record_heap_pop(&heap);
+		if(!record_heap_add(&heap, p + (random32() >> 8))) goto finally;
+		if(i % n) continue;
+		if(!(buffer = record_heap_buffer(&heap, n / 10))) goto finally;
+		for(j = 0; j < n / 10; j++) buffer[j] = random32() >> 1;
+		if(!record_heap_append(&heap, n / 10)) goto finally;
+		for(j = 0; j < n / 10; j++) record_heap_pop(&heap);
+	}
+	while(heap.a.size) record_heap_pop(&heap);
+	is_ok = 1;
+finally:
+	record_heap_(&heap);
+	return is_ok;
+}
+
+/** @return Seconds of wall time. */
+static double now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+/** Replays `trace` on a new <tag:<H>heap> called `heap`. */
+#define REPLAY(H) \
+static double H##_replay(struct H##_heap *const heap) { \
+	const unsigned *p = trace.priority; \
+	unsigned *buffer; \
+	double t0; \
+	size_t i; \
+	volatile unsigned sink = 0; \
+	H##_heap(heap); \
+	t0 = now(); \
+	for(i = 0; i < trace.size; i++) { \
+		switch(trace.op[i]) { \
+		case 'a': case 'e': if(!H##_heap_add(heap, *p++)) return -1.0; break; \
+		case 'r': H##_heap_replace(heap, *p++); break; \
+		case 'k': if(heap->a.size) sink ^= *H##_heap_peek(heap); break; \
+		case 'p': H##_heap_pop(heap); break; \
+		case 'c': H##_heap_clear(heap); break; \
+		case 'd': H##_heap_(heap); break; \
+		case 'b': if(!H##_heap_buffer(heap, trace.n[i])) return -1.0; break; \
+		case 'n': \
+			if(!(buffer = H##_heap_buffer(heap, trace.n[i]))) return -1.0; \
+			memcpy(buffer, p, sizeof *p * trace.n[i]), p += trace.n[i]; \
+			H##_heap_append(heap, trace.n[i]); \
+			break; \
+		} \
+	} \
+	return now() - t0; \
+}
+REPLAY(plain)
+REPLAY(stats)
+REPLAY(tiny)
+REPLAY(huge)
+#undef REPLAY
+
+/** Prints the replay of `name` in `seconds`. */
+static void print(const char *const name, const double seconds) {
+	printf("%s,%lu,%f,%f", name, (unsigned long)trace.size, seconds,
+		seconds * 1e9 / (double)trace.size);
+}
+
+int main(int argc, char **argv) {
+	FILE *fp = 0;
+	struct plain_heap plain;
+	struct stats_heap stats;
+	struct tiny_heap tiny;
+	struct huge_heap huge;
+	const struct stats_heap_stats *st;
+	double t;
+	int is_ok = 0;
+	plain_heap(&plain), stats_heap(&stats), tiny_heap(&tiny), huge_heap(&huge);
+	if(argc > 1) {
+		if(!(fp = fopen(argv[1], "rb"))) goto finally;
+	} else {
+		if(!(fp = tmpfile()) || (srand(1), !record(fp, 100000))) goto finally;
+		rewind(fp);
+	}
+	if(!load(fp)) goto finally;
+	printf("config,calls,total_s,ns_per_call,compares,copies,levels,reallocs,"
+		"realloc_bytes,peak\n");
+	if((t = plain_replay(&plain)) < 0.0) goto finally;
+	print("plain", t), printf(",,,,,,\n");
+	if((t = stats_replay(&stats)) < 0.0) goto finally;
+	st = stats_heap_stats(&stats), print("stats", t);
+	printf(",%lu,%lu,%lu,%lu,%lu,%lu\n", (unsigned long)st->compares,
+		(unsigned long)st->copies, (unsigned long)st->levels,
+		(unsigned long)st->reallocs, (unsigned long)st->realloc_bytes,
+		(unsigned long)st->peak);
+	if((t = tiny_replay(&tiny)) < 0.0) goto finally;
+	print("inline", t), printf(",,,,,,\n");
+	if((t = huge_replay(&huge)) < 0.0) goto finally;
+	print("huge", t), printf(",,,,,,\n");
+	is_ok = 1;
+finally:
+	if(!is_ok) perror(argc > 1 ? argv[1] : "replay");
+	if(fp) fclose(fp);
+	plain_heap_(&plain), stats_heap_(&stats), tiny_heap_(&tiny);
+	huge_heap_(&huge);
+	free(trace.op), free(trace.n), free(trace.priority);
+	return is_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,134 @@
+/** @license 2020 Neil Edelman, distributed under the terms of the
+ [MIT License](https://opensource.org/licenses/MIT).
+
+ Benchmarks an external sort with runs from <../src/selection.h> against runs
+ of `memory` sorted with `qsort`; both are then merged with
+ <fn:unsigned_selection_merge_files>. The optional first argument is the
+ directory for the temporary run files, default `.`. The optional second is a
+ file of native `unsigned` records to sort instead of random ones; then
+ replacement selection reads it with <fn:unsigned_selection_file_read>.
+ Prints CSV to `stdout`.
+
+ @std POSIX.1b */
+
+#define _POSIX_C_SOURCE 199309L /* clock_gettime */
+#include <stdlib.h> /* EXIT qsort rand */
+#include <stdio.h>  /* printf tmpfile fopen fseek ftell */
+#include <time.h>   /* clock_gettime */
+
+#define SELECTION_NAME unsigned
+#include "../src/selection.h"
+
+/** @return Seconds of wall time; the sort waits on the disk. */
+static double now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+/** 32-bit random number; `rand` may only have 15 bits. */
+static unsigned random32(void) {
+	return (unsigned)rand() ^ (unsigned)rand() << 15 ^ (unsigned)rand() << 30;
+}
+
+/** Input of `size` records, random, or from `fp` if it is not null. */
+struct input { size_t i, size; FILE *fp; };
+
+/** @implements <typedef:<PR>read_fn> */
+static int input_read(void *const source, unsigned *const record) {
+	struct input *const in = source;
+	if(in->fp) return unsigned_selection_file_read(in->fp, record);
+	if(in->i >= in->size) return 0;
+	in->i++, *record = random32();
+	return 1;
+}
+
+/** @implements qsort */
+static int unsigned_cmp(const void *const a, const void *const b) {
+	const unsigned x = *(const unsigned *)a, y = *(const unsigned *)b;
+	return (x > y) - (x < y);
+}
+
+/** Runs of `memory` from `in` sorted with `qsort` to `files`.
+ @return Success. */
+static int load_sort_runs(const size_t memory, struct input *const in,
+	struct selection_files *const files, size_t *const runs) {
+	unsigned *buffer;
+	size_t i, run = 0;
+	int success = 0;
+	if(!(buffer = malloc(sizeof *buffer * memory))) return 0;
+	for( ; ; ) {
+		for(i = 0; i < memory && input_read(in, buffer + i); i++);
+		if(!i) break;
+		qsort(buffer, i, sizeof *buffer, &unsigned_cmp);
+		if(!(files->fp = selection_files_open(files, run, "wb"))
+			|| fwrite(buffer, sizeof *buffer, i, files->fp) != i
+			|| !selection_files_close(files)) goto catch;
+		run++;
+	}
+	*runs = run, success = 1;
+catch:
+	selection_files_close(files);
+	free(buffer);
+	return success;
+}
+
+/** Sorts `n` records, random, or all of `fp` if it is not null, with
+ `memory` using runs from replacement selection if `is_selection`, or `qsort`
+ otherwise, in `dir`.
+ @return Seconds, or negative on error. */
+static double external_sort(const int is_selection, const size_t n,
+	FILE *const fp, const size_t memory, const char *const dir,
+	size_t *const runs) {
+	struct selection_files files;
+	struct input in;
+	FILE *out = 0;
+	const double t0 = now();
+	int success;
+	files.dir = dir, files.fp = 0, files.run = 0;
+	in.i = 0, in.size = n, in.fp = fp, *runs = 0;
+	if(fp && fseek(fp, 0, SEEK_SET)) return -1.0;
+	success = is_selection ? (fp
+		? unsigned_selection_runs(memory, &unsigned_selection_file_read, fp,
+		&unsigned_selection_file_write, &files, runs)
+		: unsigned_selection_runs(memory, &input_read, &in,
+		&unsigned_selection_file_write, &files, runs))
+		&& selection_files_close(&files)
+		: load_sort_runs(memory, &in, &files, runs);
+	success = success && (out = tmpfile())
+		&& unsigned_selection_merge_files(&files, *runs, out);
+	if(out) fclose(out);
+	selection_files_remove(&files, *runs);
+	return success ? now() - t0 : -1.0;
+}
+
+int main(int argc, char **argv) {
+	static const size_t sizes[] = { 100000, 1000000, 10000000 };
+	const char *const dir = argc > 1 ? argv[1] : ".";
+	FILE *fp = 0;
+	size_t i, n, memory, rq, rs;
+	long bytes;
+	double tq, ts;
+	if(argc > 2) {
+		if(!(fp = fopen(argv[2], "rb")) || fseek(fp, 0, SEEK_END)
+			|| (bytes = ftell(fp)) < 0) goto catch;
+		n = (size_t)bytes / sizeof(unsigned);
+	}
+	printf("n,memory,qsort_runs,selection_runs,qsort_s,selection_s\n");
+	for(i = 0; i < (fp ? 1 : sizeof sizes / sizeof *sizes); i++) {
+		if(!fp) n = sizes[i];
+		if(!(memory = n / 64)) memory = 1;
+		srand(1), tq = external_sort(0, n, fp, memory, dir, &rq);
+		srand(1), ts = external_sort(1, n, fp, memory, dir, &rs);
+		if(tq < 0.0 || ts < 0.0) goto catch;
+		printf("%lu,%lu,%lu,%lu,%f,%f\n", (unsigned long)n,
+			(unsigned long)memory, (unsigned long)rq, (unsigned long)rs,
+			tq, ts);
+	}
+	if(fp) fclose(fp);
+	return EXIT_SUCCESS;
+catch:
+	perror("selection");
+	if(fp) fclose(fp);
+	return EXIT_FAILURE;
+}
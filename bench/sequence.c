@@ -0,0 +1,103 @@
+/** @license 2020 Neil Edelman, distributed under the terms of the
+ [MIT License](https://opensource.org/licenses/MIT).
+
+ Benchmarks <../src/sequence.h> against <../src/heap.h>. Each argument is a
+ size; the default is a range of sizes. Prints CSV to `stdout`.
+
+ @std C89 */
+
+#include <stdlib.h> /* EXIT strtoul rand */
+#include <stdio.h>  /* printf */
+#include <time.h>   /* clock */
+
+#define HEAP_NAME binary
+#include "../src/heap.h"
+
+#define SEQUENCE_NAME binary
+#include "../src/sequence.h"
+
+/** 32-bit random number; `rand` may only have 15 bits. */
+static unsigned random32(void) {
+	return (unsigned)rand() ^ (unsigned)rand() << 15 ^ (unsigned)rand() << 30;
+}
+
+/** Adds `n` random numbers to `heap`, then pops them all.
+ @return Seconds. */
+static double heap_fill_drain(struct binary_heap *const heap, const size_t n) {
+	const clock_t t0 = clock();
+	size_t i;
+	for(i = 0; i < n; i++) if(!binary_heap_add(heap, random32())) return -1.0;
+	for(i = 0; i < n; i++) binary_heap_pop(heap);
+	return (double)(clock() - t0) / CLOCKS_PER_SEC;
+}
+
+/** Same as <fn:heap_fill_drain> on `s`. */
+static double sequence_fill_drain(struct binary_sequence *const s,
+	const size_t n) {
+	const clock_t t0 = clock();
+	size_t i;
+	for(i = 0; i < n; i++)
+		if(!binary_sequence_add(s, random32())) return -1.0;
+	for(i = 0; i < n; i++) binary_sequence_pop(s);
+	return (double)(clock() - t0) / CLOCKS_PER_SEC;
+}
+
+/** The hold model: with `heap` at `n`, repeatedly pops the minimum and adds
+ it back with a random increment. @return Seconds. */
+static double heap_hold(struct binary_heap *const heap, const size_t n) {
+	clock_t t0;
+	size_t i;
+	unsigned p;
+	for(i = 0; i < n; i++)
+		if(!binary_heap_add(heap, random32() >> 1)) return -1.0;
+	t0 = clock();
+	for(i = 0; i < n; i++) {
+		p = *binary_heap_peek(heap), binary_heap_pop(heap);
+		if(!binary_heap_add(heap, p + (random32() >> 8))) return -1.0;
+	}
+	return (double)(clock() - t0) / CLOCKS_PER_SEC;
+}
+
+/** Same as <fn:heap_hold> on `s`. */
+static double sequence_hold(struct binary_sequence *const s, const size_t n) {
+	clock_t t0;
+	size_t i;
+	unsigned p;
+	for(i = 0; i < n; i++)
+		if(!binary_sequence_add(s, random32() >> 1)) return -1.0;
+	t0 = clock();
+	for(i = 0; i < n; i++) {
+		p = *binary_sequence_peek(s), binary_sequence_pop(s);
+		if(!binary_sequence_add(s, p + (random32() >> 8))) return -1.0;
+	}
+	return (double)(clock() - t0) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char **argv) {
+	static const size_t sizes[] = { 1000, 10000, 100000, 1000000, 10000000 };
+	const size_t sizes_size = argc > 1 ? (size_t)(argc - 1)
+		: sizeof sizes / sizeof *sizes;
+	size_t i, n;
+	struct binary_heap heap = HEAP_IDLE;
+	struct binary_sequence s = SEQUENCE_IDLE;
+	double th, ts;
+	printf("workload,n,heap_s,sequence_s,speedup\n");
+	for(i = 0; i < sizes_size; i++) {
+		n = argc > 1 ? (size_t)strtoul(argv[i + 1], 0, 0) : sizes[i];
+		srand(1), th = heap_fill_drain(&heap, n), binary_heap_(&heap);
+		srand(1), ts = sequence_fill_drain(&s, n), binary_sequence_(&s);
+		if(th < 0.0 || ts < 0.0) goto catch;
+		printf("fill-drain,%lu,%f,%f,%.2f\n", (unsigned long)n, th, ts,
+			ts > 0.0 ? th / ts : 0.0);
+		srand(1), th = heap_hold(&heap, n), binary_heap_(&heap);
+		srand(1), ts = sequence_hold(&s, n), binary_sequence_(&s);
+		if(th < 0.0 || ts < 0.0) goto catch;
+		printf("hold,%lu,%f,%f,%.2f\n", (unsigned long)n, th, ts,
+			ts > 0.0 ? th / ts : 0.0);
+	}
+	return EXIT_SUCCESS;
+catch:
+	perror("sequence");
+	binary_heap_(&heap), binary_sequence_(&s);
+	return EXIT_FAILURE;
+}
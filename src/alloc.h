@@ -0,0 +1,326 @@
+/** @license 2020 Neil Edelman, distributed under the terms of the
+ [MIT License](https://opensource.org/licenses/MIT).
+
+ @subtitle Allocators
+
+ Ready-made allocators for `ARRAY_ALLOC`, `ARRAY_REALLOC`, and `ARRAY_FREE` in
+ <array.h>, (and the same in <heap.h> and <pool.h>.) Each takes a `void *`
+ context and the size of the block on resize and free.
+
+ <fn:alloc_aligned> aligns to the power-of-two pointed to by the context, or
+ `ALLOC_ALIGN` if it's null, for wide-node layouts that should not straddle
+ cache lines. <fn:alloc_huge> maps blocks of at least `ALLOC_HUGE_MIN` on a
+ `ALLOC_HUGE_PAGE` boundary and advises the kernel to back them with huge
+ pages, `MADV_HUGEPAGE`, where it is available; smaller blocks go to `malloc`.
+ On Linux, with `_GNU_SOURCE`, <fn:alloc_huge_realloc> grows the mapping with
+ `mremap`, which moves page table entries instead of copying; in place if it
+ can, otherwise onto a new aligned mapping, so it stays on a huge page. The
+ latency of growing a huge array no longer depends on its size, apart from the
+ kernel.
+ On a system without `mmap`, or if it is not exposed, (eg, `-ansi` without
+ `_DEFAULT_SOURCE`,) it is the same as `malloc`.
+
+ <fn:alloc_file_open> maps a file shared, and <fn:alloc_file_realloc> grows
+ it with `ftruncate` and `mremap`, (or a new mapping without it,) so an array
+ lives in the file. A small <tag:alloc_file> header before the array remembers
+ the size of an element, the bytes, and a count for the user, such as the size
+ of the array. It only exists with POSIX `mmap`.
+
+ @std C89; POSIX `mmap` and Linux `MADV_HUGEPAGE` and `mremap` optional */
+
+#ifndef ALLOC_H /* <!-- idempotent */
+#define ALLOC_H
+
+#include <stdlib.h> /* malloc realloc free */
+#include <string.h> /* memcpy */
+#include <assert.h> /* assert */
+#include <errno.h>  /* errno */
+#if defined(__unix__) || defined(__unix) \
+	|| (defined(__APPLE__) && defined(__MACH__))
+#include <sys/mman.h>  /* mmap munmap madvise mremap msync */
+#include <sys/types.h> /* off_t */
+#include <sys/stat.h>  /* fstat */
+#include <fcntl.h>     /* open */
+#include <unistd.h>    /* ftruncate close */
+#endif
+
+#ifndef ALLOC_ALIGN /* <!-- !align */
+#define ALLOC_ALIGN 64 /* Cache line. */
+#endif /* !align --> */
+#ifndef ALLOC_HUGE_PAGE /* <!-- !page */
+#define ALLOC_HUGE_PAGE ((size_t)1 << 21) /* x86-64 and arm64. */
+#endif /* !page --> */
+#ifndef ALLOC_HUGE_MIN /* <!-- !min */
+#define ALLOC_HUGE_MIN ALLOC_HUGE_PAGE
+#endif /* !min --> */
+#if defined(MAP_ANONYMOUS) /* <!-- anon */
+#define ALLOC_MAP_ANON MAP_ANONYMOUS
+#elif defined(MAP_ANON) /* anon --><!-- bsd */
+#define ALLOC_MAP_ANON MAP_ANON
+#endif /* bsd --> */
+
+/** @return The alignment requested by `context`, at least the alignment of a
+ pointer. */
+static size_t alloc_alignment(const void *const context) {
+	size_t align = context ? *(const size_t *)context : ALLOC_ALIGN;
+	assert(align && !(align & (align - 1)));
+	if(align < sizeof(void *)) align = sizeof(void *);
+	return align;
+}
+
+/** Allocates `size` bytes aligned to `context`, a `size_t *` power-of-two,
+ or `ALLOC_ALIGN` if null. The block before the memory holds the pointer that
+ `malloc` returned. @return The memory or null. @throws[malloc, ERANGE] */
+static void *alloc_aligned(void *const context, const size_t size) {
+	const size_t align = alloc_alignment(context),
+		extra = align - 1 + sizeof(void *);
+	char *raw, *data;
+	if(size > (size_t)-1 - extra) return errno = ERANGE, (void *)0;
+	if(!(raw = malloc(size + extra))) { if(!errno) errno = ERANGE; return 0; }
+	data = raw + sizeof(void *);
+	data += (align - (size_t)((unsigned long)data & (align - 1))) & (align - 1);
+	((void **)data)[-1] = raw;
+	return data;
+}
+
+/** Frees `data` from <fn:alloc_aligned> with `context`, ignoring `size`. */
+static void alloc_aligned_free(void *const context, void *const data,
+	const size_t size) {
+	(void)context, (void)size;
+	if(data) free(((void **)data)[-1]);
+}
+
+/** Resizes `data` of `old_size` from <fn:alloc_aligned> to `size` bytes with
+ `context`. There is no aligned `realloc` in the standard library, so it always
+ copies. @return The memory or null. @throws[malloc, ERANGE] */
+static void *alloc_aligned_realloc(void *const context, void *const data,
+	const size_t old_size, const size_t size) {
+	void *const next = alloc_aligned(context, size);
+	if(!next) return 0;
+	if(data) memcpy(next, data, old_size < size ? old_size : size),
+		alloc_aligned_free(context, data, old_size);
+	return next;
+}
+
+#ifdef ALLOC_MAP_ANON /* <!-- mmap */
+
+/** @return `size` rounded up to a huge page. */
+static size_t alloc_huge_round(const size_t size)
+	{ return (size + ALLOC_HUGE_PAGE - 1) & ~(ALLOC_HUGE_PAGE - 1); }
+
+/** Maps `size`, which is at least `ALLOC_HUGE_MIN`, on a huge page boundary.
+ @return The memory or null. @throws[mmap, ERANGE] */
+static void *alloc_huge_map(const size_t size) {
+	const size_t bytes = alloc_huge_round(size);
+	char *raw, *data;
+	size_t head;
+	if(bytes < size || bytes > (size_t)-1 - ALLOC_HUGE_PAGE)
+		return errno = ERANGE, (void *)0;
+	/* Over-map by a page and trim to get the alignment. */
+	raw = mmap(0, bytes + ALLOC_HUGE_PAGE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | ALLOC_MAP_ANON, -1, 0);
+	if(raw == MAP_FAILED) { if(!errno) errno = ERANGE; return 0; }
+	head = (ALLOC_HUGE_PAGE - (size_t)((unsigned long)raw
+		& (ALLOC_HUGE_PAGE - 1))) & (ALLOC_HUGE_PAGE - 1);
+	data = raw + head;
+	if(head) munmap(raw, head);
+	munmap(data + bytes, ALLOC_HUGE_PAGE - head);
+#ifdef MADV_HUGEPAGE /* <!-- advise: it is only advice; ignore errors. */
+	{ const int e = errno; madvise(data, bytes, MADV_HUGEPAGE), errno = e; }
+#endif /* advise --> */
+	return data;
+}
+
+/** The start of a file from <fn:alloc_file_open>; the array follows at
+ `ALLOC_FILE_HEADER`. `used` is for the user. `fd` is only valid while it is
+ open. */
+struct alloc_file { char magic[8]; size_t unit, bytes, used; int fd; };
+#define ALLOC_FILE_HEADER 64
+
+/** @return The header of `data` from <fn:alloc_file_open>. */
+static struct alloc_file *alloc_file_header(void *const data)
+	{ return (struct alloc_file *)(void *)((char *)data - ALLOC_FILE_HEADER); }
+
+/** Opens or creates the file at `path` and maps it. A new file has room for
+ at least one of `unit` bytes.
+ @return The array in the file, or null.
+ @throws[EDOM] The file is not from here or has a different `unit`.
+ @throws[open, fstat, ftruncate, mmap] */
+static void *alloc_file_open(const char *const path, const size_t unit) {
+	struct alloc_file *f;
+	struct stat st;
+	size_t length;
+	void *map;
+	int fd, is_new;
+	assert(path && unit && sizeof *f <= ALLOC_FILE_HEADER);
+	if((fd = open(path, O_RDWR | O_CREAT, 0644)) == -1) return 0;
+	if(fstat(fd, &st)) goto catch;
+	if((is_new = !st.st_size)) {
+		length = ALLOC_FILE_HEADER + unit;
+		if(ftruncate(fd, (off_t)length)) goto catch;
+	} else if((length = (size_t)st.st_size) < ALLOC_FILE_HEADER
+		|| (off_t)length != st.st_size) { errno = EDOM; goto catch; }
+	if((map = mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0))
+		== MAP_FAILED) goto catch;
+	f = map;
+	if(is_new) {
+		memcpy(f->magic, "ALLOCFIL", sizeof f->magic);
+		f->unit = unit, f->bytes = length - ALLOC_FILE_HEADER, f->used = 0;
+	} else if(memcmp(f->magic, "ALLOCFIL", sizeof f->magic) || f->unit != unit
+		|| f->bytes > length - ALLOC_FILE_HEADER) {
+		munmap(map, length), errno = EDOM; goto catch;
+	} else {
+		/* It may have stopped after resizing the file, but not the header. */
+		f->bytes = length - ALLOC_FILE_HEADER;
+	}
+	f->fd = fd;
+	return (char *)map + ALLOC_FILE_HEADER;
+catch:
+	{ const int e = errno; close(fd), errno = e; }
+	return 0;
+}
+
+/** There is no file to allocate from; open one with <fn:alloc_file_open>.
+ @return Null. @throws[EBADF] */
+static void *alloc_file(void *const context, const size_t size)
+	{ (void)context, (void)size; return errno = EBADF, (void *)0; }
+
+/** Unmaps `data` from <fn:alloc_file_open> and closes the file, which stays;
+ `context` and `size` are ignored. */
+static void alloc_file_free(void *const context, void *const data,
+	const size_t size) {
+	struct alloc_file *f;
+	int fd;
+	(void)context, (void)size;
+	if(!data) return;
+	f = alloc_file_header(data), fd = f->fd;
+	munmap((void *)f, ALLOC_FILE_HEADER + f->bytes), close(fd);
+}
+
+/** Resizes the file of `data` from <fn:alloc_file_open> to hold `size` bytes
+ and maps it again; `context` and `old_size` are ignored.
+ @return The array or null. @throws[ftruncate, mremap, mmap, ERANGE] */
+static void *alloc_file_realloc(void *const context, void *const data,
+	const size_t old_size, const size_t size) {
+	struct alloc_file *f;
+	size_t old_length, length;
+	void *map;
+	int fd;
+	(void)context, (void)old_size;
+	if(!data) return alloc_file(context, size);
+	f = alloc_file_header(data), fd = f->fd;
+	old_length = ALLOC_FILE_HEADER + f->bytes;
+	length = ALLOC_FILE_HEADER + size;
+	if(size > (size_t)-1 - ALLOC_FILE_HEADER || (off_t)length < 0)
+		return errno = ERANGE, (void *)0;
+	if(length > old_length && ftruncate(fd, (off_t)length)) return 0;
+#ifdef MREMAP_MAYMOVE /* <!-- mremap */
+	map = mremap((void *)f, old_length, length, MREMAP_MAYMOVE);
+#else /* mremap --><!-- !mremap: the file has it, so no copying. */
+	if((map = mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0))
+		!= MAP_FAILED) munmap((void *)f, old_length);
+#endif /* !mremap --> */
+	if(map == MAP_FAILED) {
+		const int e = errno;
+		if(length > old_length && ftruncate(fd, (off_t)old_length)) errno = e;
+		return 0;
+	}
+	f = map, f->bytes = size;
+	/* Shrinking only gives back the disk; ignore errors. */
+	if(length < old_length)
+		{ const int e = errno; if(ftruncate(fd, (off_t)length)) errno = e; }
+	return (char *)map + ALLOC_FILE_HEADER;
+}
+
+/** Writes the mapping of `data` from <fn:alloc_file_open> to the disk and
+ waits for it. @return Success. @throws[msync] */
+static int alloc_file_sync(void *const data) {
+	struct alloc_file *const f = alloc_file_header(data);
+	return !msync((void *)f, ALLOC_FILE_HEADER + f->bytes, MS_SYNC);
+}
+
+#endif /* mmap --> */
+
+/** Allocates `size` bytes; if it's at least `ALLOC_HUGE_MIN`, it's mapped on
+ a huge page boundary and advised to use huge pages. `context` is ignored.
+ @return The memory or null. @throws[malloc, mmap, ERANGE] */
+static void *alloc_huge(void *const context, const size_t size) {
+	void *data;
+	(void)context;
+#ifdef ALLOC_MAP_ANON /* <!-- mmap */
+	if(size >= ALLOC_HUGE_MIN) return alloc_huge_map(size);
+#endif /* mmap --> */
+	if(!(data = malloc(size)) && !errno) errno = ERANGE;
+	return data;
+}
+
+/** Frees `data` of `size` from <fn:alloc_huge>; `context` is ignored. */
+static void alloc_huge_free(void *const context, void *const data,
+	const size_t size) {
+	(void)context, (void)size;
+	if(!data) return;
+#ifdef ALLOC_MAP_ANON /* <!-- mmap */
+	if(size >= ALLOC_HUGE_MIN) { munmap(data, alloc_huge_round(size)); return; }
+#endif /* mmap --> */
+	free(data);
+}
+
+/** Resizes `data` of `old_size` from <fn:alloc_huge> to `size`; `context` is
+ ignored. @return The memory or null. @throws[malloc, mmap, ERANGE] */
+static void *alloc_huge_realloc(void *const context, void *const data,
+	const size_t old_size, const size_t size) {
+	void *next;
+#ifdef ALLOC_MAP_ANON /* <!-- mmap */
+	if(old_size >= ALLOC_HUGE_MIN || size >= ALLOC_HUGE_MIN) {
+		if(old_size >= ALLOC_HUGE_MIN && size >= ALLOC_HUGE_MIN) {
+			const size_t old_bytes = alloc_huge_round(old_size),
+				bytes = alloc_huge_round(size);
+			if(old_bytes == bytes) return data;
+#if defined(MREMAP_MAYMOVE) && defined(MREMAP_FIXED) /* <!-- mremap */
+			{
+				const int e = errno;
+				void *aligned;
+				if(bytes < size) return errno = ERANGE, (void *)0;
+				/* Moving anywhere would only keep the page alignment; in place,
+				 or over a mapping on a huge page boundary, keeps that. */
+				if((next = mremap(data, old_bytes, bytes, 0)) == MAP_FAILED) {
+					if(!(aligned = alloc_huge_map(size))) return 0;
+					if((next = mremap(data, old_bytes, bytes, MREMAP_MAYMOVE
+						| MREMAP_FIXED, aligned)) == MAP_FAILED) {
+						munmap(aligned, bytes);
+						if(!errno) errno = ERANGE;
+						return 0;
+					}
+				}
+#ifdef MADV_HUGEPAGE /* <!-- advise */
+				if(bytes > old_bytes) madvise(next, bytes, MADV_HUGEPAGE);
+#endif /* advise --> */
+				errno = e;
+				return next;
+			}
+#endif /* mremap --> */
+		}
+		if(!(next = alloc_huge(context, size))) return 0;
+		if(data) memcpy(next, data, old_size < size ? old_size : size),
+			alloc_huge_free(context, data, old_size);
+		return next;
+	}
+#endif /* mmap --> */
+	(void)context, (void)old_size;
+	if(!(next = realloc(data, size)) && !errno) errno = ERANGE;
+	return next;
+}
+
+static void alloc_unused_coda(void);
+static void alloc_unused(void) {
+	alloc_aligned_realloc(0, 0, 0, 0);
+	alloc_huge(0, 0); alloc_huge_free(0, 0, 0); alloc_huge_realloc(0, 0, 0, 0);
+#ifdef ALLOC_MAP_ANON
+	alloc_file_open(0, 0); alloc_file_free(0, 0, 0);
+	alloc_file_realloc(0, 0, 0, 0); alloc_file_sync(0);
+#endif
+	alloc_unused_coda();
+}
+static void alloc_unused_coda(void) { alloc_unused(); }
+
+#endif /* idempotent --> */
@@ -14,6 +14,23 @@
  <typedef:<PA>type>, associated therewith; required. `<PA>` is private, whose
  names are prefixed in a manner to avoid collisions.
 
+ @param[ARRAY_ALLOC, ARRAY_REALLOC, ARRAY_FREE, ARRAY_ALLOC_CONTEXT]
+ Optional allocator; either all three functions or none, in which case it uses
+ `realloc` and `free`. They satisfy <typedef:<PA>alloc_fn>,
+ <typedef:<PA>realloc_fn>, and <typedef:<PA>free_fn>, and are passed
+ `ARRAY_ALLOC_CONTEXT`, an expression that is converted to `void *`, (default
+ null.) Some are in <alloc.h>.
+
+ @param[ARRAY_INLINE_CAPACITY]
+ Optional number of elements that are stored inside <tag:<A>array> before it
+ needs to allocate. Zero is still idle. The elements are found with
+ <fn:<A>array_data> instead of `data`, so the array can be moved. To
+ initialize it, `<A>array_idle` braces the storage; `ARRAY_IDLE` does not.
+
+ @param[ARRAY_STATIC_CAPACITY]
+ Optional; the same as `ARRAY_INLINE_CAPACITY`, but the array never allocates.
+ Asking for more fails with `ERANGE`.
+
  @param[ARRAY_FUNCTION]
  Include Function trait contained in <function.h>.
 
@@ -73,6 +90,23 @@
 	&& (!(!defined(ARRAY_COMPARE) ^ !defined(ARRAY_IS_EQUAL)))
 #error ARRAY_COMPARE_NAME requires ARRAY_COMPARE or ARRAY_IS_EQUAL not both.
 #endif
+#if (defined(ARRAY_ALLOC) || defined(ARRAY_REALLOC) || defined(ARRAY_FREE)) \
+	&& (!defined(ARRAY_ALLOC) || !defined(ARRAY_REALLOC) \
+	|| !defined(ARRAY_FREE))
+#error ARRAY_ALLOC, ARRAY_REALLOC, and ARRAY_FREE go together.
+#endif
+#if defined(ARRAY_ALLOC_CONTEXT) && !defined(ARRAY_ALLOC)
+#error ARRAY_ALLOC_CONTEXT requires ARRAY_ALLOC.
+#endif
+#ifdef ARRAY_STATIC_CAPACITY /* <!-- static */
+#ifdef ARRAY_INLINE_CAPACITY
+#error ARRAY_STATIC_CAPACITY and ARRAY_INLINE_CAPACITY are exclusive.
+#endif
+#define ARRAY_INLINE_CAPACITY ARRAY_STATIC_CAPACITY
+#endif /* static --> */
+#if defined(ARRAY_INLINE_CAPACITY) && ARRAY_INLINE_CAPACITY < 1
+#error ARRAY_INLINE_CAPACITY must be positive.
+#endif
 
 
 #if ARRAY_TRAITS == 0 /* <!-- base code */
@@ -97,25 +131,148 @@ typedef ARRAY_TYPE PA_(type);
 /** Manages the array field `data` which has `size` elements. The space is
  indexed up to `capacity`, which is at least `size`. To initialize it to an
  idle state, see <fn:<A>array>, `ARRAY_IDLE`, `{0}` (`C99`,) or being `static`.
+ If `ARRAY_INLINE_CAPACITY`, `data` is instead `u.data` when `capacity`
+ exceeds it, and `u.store` up to it; see <fn:<A>array_data>.
 
  ![States.](../web/states.png) */
 struct A_(array);
 /* !data -> !size, data -> capacity >= min && size <= capacity <= max */
-struct A_(array) { PA_(type) *data; size_t size, capacity; };
+struct A_(array) {
+#ifdef ARRAY_INLINE_CAPACITY /* <!-- inline */
+	union { PA_(type) *data; PA_(type) store[ARRAY_INLINE_CAPACITY]; } u;
+#else /* inline --><!-- !inline */
+	PA_(type) *data;
+#endif /* !inline --> */
+	size_t size, capacity;
+};
 #ifndef ARRAY_IDLE /* <!-- !zero; `{0}` is `C99`. */
 #define ARRAY_IDLE { 0, 0, 0 }
 #endif /* !zero --> */
+#ifdef ARRAY_INLINE_CAPACITY /* <!-- inline */
+/** An idle array; `ARRAY_IDLE` does not brace the storage. */
+static const struct A_(array) A_(array_idle);
+#endif /* inline --> */
 #ifndef ARRAY_MIN_CAPACITY /* <!-- !min; */
 #define ARRAY_MIN_CAPACITY 3 /* > 1 */
 #endif /* !min --> */
 
+#ifdef ARRAY_ALLOC /* <!-- alloc */
+#ifndef ARRAY_ALLOC_CONTEXT
+#define ARRAY_ALLOC_CONTEXT 0
+#endif
+/** Allocates `size` bytes with `context`, like `malloc`. */
+typedef void *(*PA_(alloc_fn))(void *context, size_t size);
+/** Resizes `data` of `old_size` to `size` bytes with `context`, like
+ `realloc`, but never called with null `data`. */
+typedef void *(*PA_(realloc_fn))(void *context, void *data, size_t old_size,
+	size_t size);
+/** Frees `data` of `size` bytes with `context`; never called with null. */
+typedef void (*PA_(free_fn))(void *context, void *data, size_t size);
+static const PA_(alloc_fn) PA_(alloc) = (ARRAY_ALLOC);
+static const PA_(realloc_fn) PA_(realloc) = (ARRAY_REALLOC);
+static const PA_(free_fn) PA_(free) = (ARRAY_FREE);
+#endif /* alloc --> */
+
+/** Resizes allocated `data`, which may be null, from `old_capacity` to
+ `capacity` elements. @return The new memory, or null. */
+static PA_(type) *PA_(reallocate)(PA_(type) *const data,
+	const size_t old_capacity, const size_t capacity) {
+#ifdef ARRAY_ALLOC /* <!-- alloc */
+	return data ? PA_(realloc)((void *)(ARRAY_ALLOC_CONTEXT), data,
+		sizeof *data * old_capacity, sizeof *data * capacity)
+		: PA_(alloc)((void *)(ARRAY_ALLOC_CONTEXT), sizeof *data * capacity);
+#else /* alloc --><!-- !alloc */
+	(void)old_capacity;
+	return realloc(data, sizeof *data * capacity);
+#endif /* !alloc --> */
+}
+
+/** Frees allocated `data`, which may be null, of `capacity`. */
+static void PA_(deallocate)(PA_(type) *const data, const size_t capacity) {
+#ifdef ARRAY_ALLOC /* <!-- alloc */
+	if(data) PA_(free)((void *)(ARRAY_ALLOC_CONTEXT), data,
+		sizeof *data * capacity);
+#else /* alloc --><!-- !alloc */
+	(void)capacity;
+	free(data);
+#endif /* !alloc --> */
+}
+
+/** Resizes the memory of `a` to `capacity` elements, which is at least
+ `ARRAY_INLINE_CAPACITY` and the size. @return The new memory, or null, in
+ which case `a` is unchanged. */
+static PA_(type) *PA_(resize)(struct A_(array) *const a,
+	const size_t capacity) {
+#ifdef ARRAY_INLINE_CAPACITY /* <!-- inline */
+	PA_(type) *data;
+	assert(capacity >= ARRAY_INLINE_CAPACITY && capacity >= a->size);
+	if(capacity == ARRAY_INLINE_CAPACITY) { /* Move in. */
+		if(a->capacity > ARRAY_INLINE_CAPACITY) {
+			/* The pointer shares bytes with the store. */
+			data = a->u.data;
+			memcpy(a->u.store, data, sizeof *data * a->size);
+			PA_(deallocate)(data, a->capacity);
+		}
+		return a->u.store;
+	}
+#ifdef ARRAY_STATIC_CAPACITY /* <!-- static */
+	if(capacity > ARRAY_STATIC_CAPACITY) return errno = ERANGE, (PA_(type) *)0;
+#endif /* static --> */
+	if(a->capacity <= ARRAY_INLINE_CAPACITY) { /* Spill. */
+		if((data = PA_(reallocate)(0, 0, capacity)))
+			memcpy(data, a->u.store, sizeof *data * a->size);
+		return data;
+	}
+	return PA_(reallocate)(a->u.data, a->capacity, capacity);
+#else /* inline --><!-- !inline */
+	return PA_(reallocate)(a->data, a->capacity, capacity);
+#endif /* !inline --> */
+}
+
+/** Sets the memory of `a` to `data`, from <fn:<PA>resize>, of `capacity`. */
+static void PA_(set)(struct A_(array) *const a, PA_(type) *const data,
+	const size_t capacity) {
+#ifdef ARRAY_INLINE_CAPACITY /* <!-- inline */
+	if(capacity > ARRAY_INLINE_CAPACITY) a->u.data = data;
+#else /* inline --><!-- !inline */
+	a->data = data;
+#endif /* !inline --> */
+	a->capacity = capacity;
+}
+
+/** Frees the memory of `a`, if any, without changing it. */
+static void PA_(release)(const struct A_(array) *const a) {
+#ifdef ARRAY_INLINE_CAPACITY /* <!-- inline */
+	if(a->capacity > ARRAY_INLINE_CAPACITY)
+		PA_(deallocate)(a->u.data, a->capacity);
+#else /* inline --><!-- !inline */
+	PA_(deallocate)(a->data, a->capacity);
+#endif /* !inline --> */
+}
+
+/** @return The elements of `a`, or null if it is idle. Without
+ `ARRAY_INLINE_CAPACITY`, this is `data`. @order \Theta(1) @allow */
+static PA_(type) *A_(array_data)(const struct A_(array) *const a) {
+#ifdef ARRAY_INLINE_CAPACITY /* <!-- inline */
+	/* The elements are not part of the value of a `const` array. */
+	union { const PA_(type) *c; PA_(type) *m; } store;
+	assert(a);
+	if(a->capacity > ARRAY_INLINE_CAPACITY) return a->u.data;
+	if(!a->capacity) return 0;
+	store.c = a->u.store;
+	return store.m;
+#else /* inline --><!-- !inline */
+	return assert(a), a->data;
+#endif /* !inline --> */
+}
+
 /** Initialises `a` to idle. @order \Theta(1) @allow */
 static void A_(array)(struct A_(array) *const a)
-	{ assert(a), a->data = 0, a->capacity = a->size = 0; }
+	{ assert(a), PA_(set)(a, 0, 0), a->size = 0; }
 
 /** Destroys `a` and returns it to idle. @allow */
 static void A_(array_)(struct A_(array) *const a)
-	{ assert(a), free(a->data), A_(array)(a); }
+	{ assert(a), PA_(release)(a), A_(array)(a); }
 
 /** Ensures `min` capacity of `a`. Invalidates pointers in `a`. @param[min] If
  zero, does nothing. @return Success; otherwise, `errno` will be set.
@@ -125,9 +282,9 @@ static void A_(array_)(struct A_(array) *const a)
 static int A_(array_reserve)(struct A_(array) *const a, const size_t min) {
 	size_t c0;
 	PA_(type) *data;
-	const size_t max_size = (size_t)-1 / sizeof *a->data;
+	const size_t max_size = (size_t)-1 / sizeof *data;
 	assert(a);
-	if(a->data) {
+	if(A_(array_data)(a)) {
 		assert(a->size <= a->capacity);
 		if(min <= a->capacity) return 1;
 		c0 = a->capacity < ARRAY_MIN_CAPACITY
@@ -144,9 +301,15 @@ static int A_(array_reserve)(struct A_(array) *const a, const size_t min) {
 		if(c0 >= c1) { c0 = max_size; break; } /* Unlikely. */
 		c0 = c1;
 	}
-	if(!(data = realloc(a->data, sizeof *a->data * c0)))
+#ifdef ARRAY_INLINE_CAPACITY /* <!-- inline */
+	if(c0 < ARRAY_INLINE_CAPACITY) c0 = ARRAY_INLINE_CAPACITY;
+#endif /* inline --> */
+#ifdef ARRAY_STATIC_CAPACITY /* <!-- static */
+	if(min <= ARRAY_STATIC_CAPACITY) c0 = ARRAY_STATIC_CAPACITY;
+#endif /* static --> */
+	if(!(data = PA_(resize)(a, c0)))
 		{ if(!errno) errno = ERANGE; return 0; }
-	a->data = data, a->capacity = c0;
+	PA_(set)(a, data, c0);
 	return 1;
 }
 
@@ -156,9 +319,11 @@ static int A_(array_reserve)(struct A_(array) *const a, const size_t min) {
  idle and `buffer` is zero, a null pointer is returned, otherwise null
  indicates an error. @throws[realloc, ERANGE] @allow */
 static PA_(type) *A_(array_buffer)(struct A_(array) *const a, const size_t n) {
+	PA_(type) *data;
 	assert(a);
 	if(a->size > (size_t)-1 - n) { errno = ERANGE; return 0; }
-	return A_(array_reserve)(a, a->size + n) && a->data ? a->data + a->size : 0;
+	return A_(array_reserve)(a, a->size + n) && (data = A_(array_data)(a))
+		? data + a->size : 0;
 }
 
 /** Adds `n` elements to the back of `a`. The buffer holds enough elements or
@@ -183,11 +348,12 @@ static PA_(type) *A_(array_append)(struct A_(array) *const a, const size_t n) {
 static PA_(type) *A_(array_append_at)(struct A_(array) *const a,
 	const size_t n, const size_t at) {
 	const size_t old_size = a->size;
-	PA_(type) *const buffer = A_(array_append)(a, n);
+	PA_(type) *const buffer = A_(array_append)(a, n), *data;
 	assert(a && at <= old_size);
 	if(!buffer) return 0;
-	memmove(a->data + at + n, a->data + at, sizeof a->data * (old_size - at));
-	return a->data + at;
+	data = A_(array_data)(a);
+	memmove(data + at + n, data + at, sizeof data * (old_size - at));
+	return data + at;
 }
 
 /** @return Adds (append, push back) one new element of `a`. The buffer holds 
@@ -203,19 +369,23 @@ static int A_(array_shrink)(struct A_(array) *const a) {
 	PA_(type) *data;
 	size_t c;
 	assert(a && a->capacity >= a->size);
-	if(!a->data) return assert(!a->size && !a->capacity), 1;
+	if(!A_(array_data)(a)) return assert(!a->size && !a->capacity), 1;
 	c = a->size && a->size > ARRAY_MIN_CAPACITY ? a->size : ARRAY_MIN_CAPACITY;
-	if(!(data = realloc(a->data, sizeof *a->data * c)))
+#ifdef ARRAY_INLINE_CAPACITY /* <!-- inline */
+	if(c < ARRAY_INLINE_CAPACITY) c = ARRAY_INLINE_CAPACITY;
+#endif /* inline --> */
+	if(!(data = PA_(resize)(a, c)))
 		{ if(!errno) errno = ERANGE; return 0; }
-	a->data = data, a->capacity = c;
+	PA_(set)(a, data, c);
 	return 1;
 }
 
 /** Removes `datum` from `a`. @order \O(`a.size`). @allow */
 static void A_(array_remove)(struct A_(array) *const a,
 	PA_(type) *const datum) {
-	const size_t n = (size_t)(datum - a->data);
-	assert(a && datum && datum >= a->data && datum < a->data + a->size);
+	PA_(type) *const data = A_(array_data)(a);
+	const size_t n = (size_t)(datum - data);
+	assert(a && datum && datum >= data && datum < data + a->size);
 	memmove(datum, datum + 1, sizeof *datum * (--a->size - n));
 }
 
@@ -223,9 +393,10 @@ static void A_(array_remove)(struct A_(array) *const a,
  @order \O(1). @allow */
 static void A_(array_lazy_remove)(struct A_(array) *const a,
 	PA_(type) *const datum) {
-	size_t n = (size_t)(datum - a->data);
-	assert(a && datum && datum >= a->data && datum < a->data + a->size);
-	if(--a->size != n) memcpy(datum, a->data + a->size, sizeof *datum);
+	PA_(type) *const data = A_(array_data)(a);
+	size_t n = (size_t)(datum - data);
+	assert(a && datum && datum >= data && datum < data + a->size);
+	if(--a->size != n) memcpy(datum, data + a->size, sizeof *datum);
 }
 
 /** Sets `a` to be empty. That is, the size of `a` will be zero, but if it was
@@ -236,12 +407,12 @@ static void A_(array_clear)(struct A_(array) *const a)
 
 /** @return The last element or null if `a` is empty. @order \Theta(1) @allow */
 static PA_(type) *A_(array_peek)(const struct A_(array) *const a)
-	{ return assert(a), a->size ? a->data + a->size - 1 : 0; }
+	{ return assert(a), a->size ? A_(array_data)(a) + a->size - 1 : 0; }
 
 /** @return Value from the the top of `a` that is removed or null if the array
  is empty. @order \Theta(1) @allow */
 static PA_(type) *A_(array_pop)(struct A_(array) *const a)
-	{ return assert(a), a->size ? a->data + --a->size : 0; }
+	{ return assert(a), a->size ? A_(array_data)(a) + --a->size : 0; }
 
 /** `a` indices [`i0`, `i1`) will be replaced with a copy of `b`.
  @param[b] Can be null, which acts as empty.
@@ -249,21 +420,24 @@ static PA_(type) *A_(array_pop)(struct A_(array) *const a)
 static int A_(array_splice)(struct A_(array) *const a, const size_t i0,
 	const size_t i1, const struct A_(array) *const b) {
 	const size_t a_range = i1 - i0, b_range = b ? b->size : 0;
+	PA_(type) *data;
 	assert(a && a != b && i0 <= i1 && i1 <= a->size);
 	if(a_range < b_range) { /* The output is bigger. */
 		const size_t diff = b_range - a_range;
 		/*if(a->size > (size_t)-1 - diff) return errno = ERANGE, 0;*/
 		if(!A_(array_buffer)(a, diff)) return 0;
 		/*if(!A_(array_reserve)(a, a->size + diff)) return 0;*/
-		memmove(a->data + i1 + diff, a->data + i1,
-			(a->size - i1) * sizeof *a->data);
+		data = A_(array_data)(a);
+		memmove(data + i1 + diff, data + i1, (a->size - i1) * sizeof *data);
 		a->size += diff;
 	} else if(b_range < a_range) { /* The output is smaller. */
-		memmove(a->data + i0 + b_range, a->data + i1,
-			(a->size - i1) * sizeof *a->data);
+		data = A_(array_data)(a);
+		memmove(data + i0 + b_range, data + i1,
+			(a->size - i1) * sizeof *data);
 		a->size -= a_range - b_range;
 	}
-	if(b) memcpy(a->data + i0, b->data, b->size * sizeof *a->data);
+	if(b) memcpy(A_(array_data)(a) + i0, A_(array_data)(b),
+		b->size * sizeof *data);
 	return 1;
 }
 
@@ -288,7 +462,8 @@ static void PA_(begin)(struct PA_(iterator) *const it,
 
 /** Advances `it`. @implements next */
 static PA_(type) *PA_(next)(struct PA_(iterator) *const it) {
-	return assert(it && it->a), it->i < it->a->size ? it->a->data + it->i++ : 0;
+	return assert(it && it->a),
+		it->i < it->a->size ? A_(array_data)(it->a) + it->i++ : 0;
 }
 
 /* iterate --><!-- reverse interface */
@@ -302,7 +477,7 @@ static void PA_(end)(struct PA_(iterator) *const it,
 /** Advances `it`. @implements next */
 static const PA_(type) *PA_(prev)(struct PA_(iterator) *const it) {
 	return assert(it && it->a && it->i <= it->a->size),
-		it->i ? it->a->data + --it->i : 0;
+		it->i ? A_(array_data)(it->a) + --it->i : 0;
 }
 
 /* reverse --><!-- copy interface */
@@ -342,13 +517,16 @@ static const char *(*PA_(array_to_string))(const struct A_(array) *);
 
 static void PA_(unused_base_coda)(void);
 static void PA_(unused_base)(void) {
-	A_(array_)(0); A_(array_append_at)(0, 0, 0);
+	A_(array_)(0); A_(array_data)(0); A_(array_append_at)(0, 0, 0);
 	A_(array_new)(0); A_(array_shrink)(0); A_(array_remove)(0, 0);
 	A_(array_lazy_remove)(0, 0); A_(array_clear)(0); A_(array_peek)(0);
 	A_(array_pop)(0); A_(array_splice)(0, 0, 0, 0); A_(array_copy)(0, 0);
 	PA_(begin)(0, 0); PA_(next)(0);
 	PA_(end)(0, 0); PA_(prev)(0);
 	PA_(copy)(0, 0, 0); PA_(move)(0, 0, 0); PA_(append)(0, 0);
+#ifdef ARRAY_INLINE_CAPACITY /* <!-- inline */
+	(void)A_(array_idle);
+#endif /* inline --> */
 	PA_(unused_base_coda)();
 }
 static void PA_(unused_base_coda)(void) { PA_(unused_base)(); }
@@ -433,6 +611,18 @@ static const char *(*PA_(array_to_string))(const struct A_(array) *)
 #undef BOX_ITERATE
 #undef BOX_REVERSE
 #undef BOX_COPY
+#ifdef ARRAY_ALLOC
+#undef ARRAY_ALLOC
+#undef ARRAY_REALLOC
+#undef ARRAY_FREE
+#undef ARRAY_ALLOC_CONTEXT
+#endif
+#ifdef ARRAY_INLINE_CAPACITY
+#undef ARRAY_INLINE_CAPACITY
+#endif
+#ifdef ARRAY_STATIC_CAPACITY
+#undef ARRAY_STATIC_CAPACITY
+#endif
 #endif /* !trait --> */
 #undef ARRAY_TO_STRING_TRAIT
 #undef ARRAY_COMPARE_TRAIT
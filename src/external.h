@@ -0,0 +1,496 @@
+/** @license 2020 Neil Edelman, distributed under the terms of the
+ [MIT License](https://opensource.org/licenses/MIT).
+
+ @subtitle External Priority Queue
+
+ A <tag:<X>external> is a priority queue that can hold more than fits in
+ memory. Additions go to an insertion <tag:<X>external_heap> of at most a
+ memory budget; when it is full, it is sorted and written to a temporary file
+ as a run. Runs are read back lazily, a block at a time, and merged on
+ <fn:<X>external_pop>. When there are as many runs of the same level as blocks
+ that fit in the budget, they are merged into one run of the next level, so
+ memory is about the budget plus a block for each run. One needs to have
+ <heap.h> and <array.h> in the same directory.
+
+ @param[EXTERNAL_NAME, EXTERNAL_TYPE]
+ `<X>` that satisfies `C` naming conventions when mangled and an assignable
+ type <typedef:<PX>priority> associated therewith. `EXTERNAL_NAME` is required
+ but `EXTERNAL_TYPE` defaults to `unsigned int` if not specified. `<PX>` is
+ private, whose names are prefixed in a manner to avoid collisions. Nodes are
+ written to disk as bytes, so `EXTERNAL_TYPE` should not have pointers.
+
+ @param[EXTERNAL_COMPARE]
+ A function satisfying <typedef:<PX>compare_fn>; the same contract as
+ `HEAP_COMPARE`. Defaults to minimum-hash on `EXTERNAL_TYPE`.
+
+ @param[EXTERNAL_VALUE]
+ Optional payload, the same as `HEAP_VALUE`. The pointer is written to disk,
+ so it is only meaningful in the same process.
+
+ @param[EXTERNAL_BUDGET, EXTERNAL_BLOCK]
+ The default memory budget of the insertion heap and the default size of the
+ blocks read and written, in bytes; 64MiB and 64KiB. Both may be changed with
+ <fn:<X>external_tune>.
+
+ @param[EXTERNAL_TEST]
+ Unit testing framework <../test/test_external.h>, using `assert`. Must be
+ defined equal to a random filler function, satisfying
+ `void (*<PX>biaction_fn)(<PX>node *, void *)` with the `param` of
+ <fn:<X>external_test>.
+
+ @depend [heap](https://github.com/neil-edelman/heap)
+ @std C89 */
+
+#include <stdio.h>  /* FILE fopen fread fwrite tmpfile remove sprintf */
+#include <string.h> /* strlen */
+#include <time.h>   /* time */
+
+
+#ifndef EXTERNAL_NAME
+#error Generic EXTERNAL_NAME undefined.
+#endif
+/* <Kernighan and Ritchie, 1988, p. 231>. */
+#if defined(X_) || defined(PX_) || defined(PXH_) \
+	|| (defined(EXTERNAL_SUBTYPE) ^ (defined(CAT) || defined(CAT_)))
+#error Unexpected P?X_ or CAT_?; possible stray EXTERNAL_SUBTYPE?
+#endif
+#ifndef EXTERNAL_SUBTYPE /* <!-- !sub-type */
+#define CAT_(x, y) x ## _ ## y
+#define CAT(x, y) CAT_(x, y)
+#endif /* !sub-type --> */
+#define X_(n) CAT(EXTERNAL_NAME, n)
+#define PX_(n) CAT(external, X_(n))
+/* Private names of the insertion heap, <tag:<X>external_heap>. */
+#define PXH_(n) CAT(heap, CAT(X_(external), n))
+#ifndef EXTERNAL_TYPE
+#define EXTERNAL_TYPE unsigned
+#endif
+#ifndef EXTERNAL_BUDGET
+#define EXTERNAL_BUDGET ((size_t)1 << 26)
+#endif
+#ifndef EXTERNAL_BLOCK
+#define EXTERNAL_BLOCK ((size_t)1 << 16)
+#endif
+
+/** Valid assignable type used for priority. Defaults to `unsigned int` if not
+ set by `EXTERNAL_TYPE`. */
+typedef EXTERNAL_TYPE PX_(priority);
+
+/** Returns a positive result if `a` comes after `b`; see `HEAP_COMPARE`. */
+typedef int (*PX_(compare_fn))(const PX_(priority) a, const PX_(priority) b);
+#ifndef EXTERNAL_COMPARE /* <!-- !cmp */
+/** Pre-order with `a` and `b`. @implements <typedef:<PX>compare_fn> */
+static int PX_(default_compare)(const PX_(priority) a, const PX_(priority) b)
+	{ return a > b; }
+#define EXTERNAL_COMPARE &PX_(default_compare)
+#endif /* !cmp --> */
+static const PX_(compare_fn) PX_(compare) = (EXTERNAL_COMPARE);
+
+/* The insertion heap; this relies on `heap.h` in the same directory. */
+#define HEAP_NAME X_(external)
+#define HEAP_TYPE PX_(priority)
+#define HEAP_COMPARE EXTERNAL_COMPARE
+#ifdef EXTERNAL_VALUE
+#define HEAP_VALUE EXTERNAL_VALUE
+#endif
+#define HEAP_SUBTYPE
+#include "heap.h"
+
+/** Internal nodes, the same as in the insertion heap. */
+typedef PXH_(node) PX_(node);
+/** If `EXTERNAL_VALUE` is set, a pointer to it, otherwise a boolean. */
+typedef PXH_(value) PX_(value);
+
+/** A sorted run in the file `fp`, (with `name` if it's not anonymous,) which
+ has `block` loaded with `size` that is read from `cursor` and `unread` more
+ on disk. The `mark` fields save the position while merging. */
+struct PX_(run) {
+	FILE *fp;
+	char *name;
+	PX_(node) *block;
+	size_t size, cursor, unread, level, mark_cursor, mark_unread;
+	long mark;
+};
+
+#define ARRAY_NAME PX_(run)
+#define ARRAY_TYPE struct PX_(run)
+#define ARRAY_SUBTYPE
+#include "array.h"
+
+/* The multi-way merge of runs; the value is the run of the head. */
+#define HEAP_NAME PX_(merge)
+#define HEAP_TYPE PX_(priority)
+#define HEAP_COMPARE EXTERNAL_COMPARE
+#define HEAP_VALUE struct PX_(run)
+#define HEAP_SUBTYPE
+#include "heap.h"
+
+/** Stores the insertion heap, `insert`, the runs on disk in non-increasing
+ `level`, `runs`, and the heads of the runs, `merge`. `budget` and `block` are
+ in bytes, and `dir` is the temporary directory, or null to use `tmpfile`.
+ `error` is the `errno` of items that were lost, until <fn:<X>external_pop>
+ reports it. To
+ initialize it to an idle state with the default parameters, see
+ <fn:<X>external>, `EXTERNAL_IDLE`, `{0}` (`C99`), or being `static`. */
+struct X_(external);
+struct X_(external) {
+	struct X_(external_heap) insert;
+	struct PX_(run_array) runs;
+	struct PX_(merge_heap) merge;
+	size_t size, budget, block;
+	const char *dir;
+	unsigned long id;
+	int error;
+};
+#ifndef EXTERNAL_IDLE /* <!-- !zero */
+#define EXTERNAL_IDLE \
+	{ HEAP_IDLE, ARRAY_IDLE, HEAP_IDLE, 0, 0, 0, 0, 0, 0 }
+#endif /* !zero --> */
+
+/** @return The capacity of the insertion heap of `x`. */
+static size_t PX_(capacity)(const struct X_(external) *const x) {
+	const size_t c = (x->budget ? x->budget : EXTERNAL_BUDGET)
+		/ sizeof(PX_(node));
+	return c ? c : 1;
+}
+
+/** @return The number of nodes in a block of `x`. */
+static size_t PX_(block)(const struct X_(external) *const x) {
+	const size_t b = (x->block ? x->block : EXTERNAL_BLOCK)
+		/ sizeof(PX_(node));
+	return b ? b : 1;
+}
+
+/** @return The number of runs of `x` in a level before they are merged. */
+static size_t PX_(fan_in)(const struct X_(external) *const x) {
+	const size_t f = (x->budget ? x->budget : EXTERNAL_BUDGET)
+		/ (x->block ? x->block : EXTERNAL_BLOCK);
+	return f < 2 ? 2 : f;
+}
+
+/** Closes and removes the file of `run` and frees it's memory. */
+static void PX_(run_close)(struct PX_(run) *const run) {
+	assert(run);
+	if(run->fp) fclose(run->fp), run->fp = 0;
+	if(run->name) remove(run->name), free(run->name), run->name = 0;
+	free(run->block), run->block = 0;
+	run->size = run->cursor = 0;
+}
+
+/** Initializes `run` with a new temporary file for `x`. @return Success.
+ @throws[fopen, tmpfile, malloc] */
+static int PX_(run_open)(struct X_(external) *const x,
+	struct PX_(run) *const run) {
+	FILE *exists;
+	int e;
+	assert(x && run);
+	run->fp = 0, run->name = 0;
+	run->size = run->cursor = run->unread = run->level = 0;
+	if(!(run->block = malloc(sizeof *run->block * PX_(block)(x)))) goto catch;
+	if(!x->dir) {
+		if(!(run->fp = tmpfile())) goto catch;
+		return 1;
+	}
+	/* "/" "external-" 20 "-" 20 ".run" "\0" */
+	if(!(run->name = malloc(strlen(x->dir) + 1 + 9 + 20 + 1 + 20 + 4 + 1)))
+		goto catch;
+	/* Probing for a name that is not taken is not an error. */
+	for(e = errno; ; ) {
+		sprintf(run->name, "%s/external-%lu-%lu.run", x->dir,
+			(unsigned long)time(0), ++x->id);
+		if(!(exists = fopen(run->name, "rb"))) break;
+		fclose(exists);
+	}
+	errno = e;
+	if(!(run->fp = fopen(run->name, "w+b"))) goto catch;
+	return 1;
+catch:
+	if(!errno) errno = ERANGE;
+	free(run->name), run->name = 0;
+	free(run->block), run->block = 0;
+	return 0;
+}
+
+/** Reads the next block of `run` in `x`.
+ @return Whether there was anything to read. @throws[fread] */
+static int PX_(run_load)(const struct X_(external) *const x,
+	struct PX_(run) *const run) {
+	assert(x && run && run->fp && run->block);
+	run->cursor = 0;
+	run->size = fread(run->block, sizeof *run->block, PX_(block)(x), run->fp);
+	if(run->size > run->unread) run->size = run->unread;
+	if(!run->size && run->unread && !errno) errno = ERANGE;
+	run->unread -= run->size;
+	return !!run->size;
+}
+
+/** Rebuilds the merge heap of `x` from the heads of the runs from `r0`, which
+ must all have something loaded. The merge heap must have the capacity. */
+static void PX_(remerge)(struct X_(external) *const x, const size_t r0) {
+	struct PX_(run) *run, *run_end;
+	struct PX_(merge_heap_node) head;
+	assert(x && r0 <= x->runs.size && x->merge.a.capacity >= x->runs.size);
+	PX_(merge_heap_clear)(&x->merge);
+	for(run = x->runs.data + r0, run_end = x->runs.data + x->runs.size;
+		run < run_end; run++) {
+		assert(run->cursor < run->size);
+		head.priority = PXH_(get_priority)(run->block + run->cursor);
+		head.value = run;
+		if(!PX_(merge_heap_add)(&x->merge, head)) assert(0);
+	}
+}
+
+/** The head of `run`, which is on top of the merge heap of `x`, has been
+ consumed; loads the next one and updates the merge heap.
+ @return Whether `run` has anything left. @throws[fread] */
+static int PX_(advance)(struct X_(external) *const x,
+	struct PX_(run) *const run) {
+	struct PX_(merge_heap_node) head;
+	assert(x && run && x->merge.a.size && x->merge.a.data->value == run);
+	if(++run->cursor >= run->size && !PX_(run_load)(x, run))
+		return PX_(merge_heap_pop)(&x->merge), 0;
+	head.priority = PXH_(get_priority)(run->block + run->cursor);
+	head.value = run;
+	PX_(merge_heap_replace)(&x->merge, head);
+	return 1;
+}
+
+/** Merges the runs `[r0, runs.size)` of `x` into one run of a higher level.
+ @return Success; on failure, the runs are restored, except those that can not
+ be rewound, which are lost and recorded in `error` of `x`.
+ @throws[fopen, tmpfile, malloc, fread, fwrite] */
+static int PX_(merge_runs)(struct X_(external) *const x, const size_t r0) {
+	struct PX_(run) out, *run, *const run_end = x->runs.data + x->runs.size;
+	struct PX_(merge_heap_node) *top;
+	const size_t block = PX_(block)(x);
+	size_t total = 0;
+	assert(x && r0 < x->runs.size);
+	for(run = x->runs.data + r0; run < run_end; run++) run->mark = -1;
+	if(!PX_(run_open)(x, &out)) return 0;
+	for(run = x->runs.data + r0; run < run_end; run++) {
+		long at = ftell(run->fp);
+		if(at < 0) goto catch;
+		run->mark = at - (long)(run->size * sizeof *run->block);
+		run->mark_cursor = run->cursor;
+		run->mark_unread = run->unread + run->size;
+		total += run->size - run->cursor + run->unread;
+	}
+	PX_(remerge)(x, r0);
+	while((top = PX_(merge_heap_peek)(&x->merge))) {
+		run = top->value;
+		PXH_(copy)(run->block + run->cursor, out.block + out.size++);
+		if(out.size >= block) {
+			if(fwrite(out.block, sizeof *out.block, out.size, out.fp)
+				!= out.size) goto catch;
+			out.size = 0;
+		}
+		if(!PX_(advance)(x, run) && run->unread) goto catch;
+	}
+	out.unread = total;
+	if(out.size && fwrite(out.block, sizeof *out.block, out.size, out.fp)
+		!= out.size || fflush(out.fp) || fseek(out.fp, 0, SEEK_SET)
+		|| !PX_(run_load)(x, &out)) goto catch;
+	out.level = x->runs.data[r0].level + 1;
+	for(run = x->runs.data + r0; run < run_end; run++) PX_(run_close)(run);
+	x->runs.size = r0;
+	run = PX_(run_array_new)(&x->runs), assert(run);
+	*run = out;
+	return 1;
+catch:
+	if(!errno) errno = ERANGE;
+	PX_(run_close)(&out);
+	/* Rewind to the marks: the block before and the cursor in it. Backwards,
+	 so removing a run that can not be rewound does not skip any. */
+	for(run = run_end; run > x->runs.data + r0; ) {
+		if((--run)->mark < 0) continue;
+		clearerr(run->fp);
+		run->unread = run->mark_unread;
+		if(!fseek(run->fp, run->mark, SEEK_SET) && PX_(run_load)(x, run)
+			&& run->mark_cursor < run->size)
+			{ run->cursor = run->mark_cursor; continue; }
+		if(!x->error) x->error = errno ? errno : ERANGE;
+		x->size -= run->mark_unread - run->mark_cursor;
+		PX_(run_close)(run);
+		PX_(run_array_remove)(&x->runs, run);
+	}
+	return 0;
+}
+
+/** Merges any level of `x` that is full into one run of the next level.
+ Failing is not an error; the level just stays over-full. */
+static void PX_(cascade)(struct X_(external) *const x) {
+	size_t level, r0;
+	for(level = 0; ; level++) {
+		for(r0 = x->runs.size; r0 && x->runs.data[r0 - 1].level == level; r0--);
+		if(x->runs.size - r0 < PX_(fan_in)(x) || !PX_(merge_runs)(x, r0))
+			break;
+	}
+}
+
+/** The insertion heap of `x` is full; it is sorted and written as a run.
+ @return Success; on failure, `x` is unchanged.
+ @throws[fopen, tmpfile, malloc, fread, fwrite] */
+static int PX_(spill)(struct X_(external) *const x) {
+	struct X_(external_heap) *const h = &x->insert;
+	PX_(node) *const n0 = h->a.data, temp;
+	const size_t n = h->a.size;
+	size_t i;
+	struct PX_(run) *run;
+	assert(x && n);
+	if(!PX_(run_array_buffer)(&x->runs, 1)
+		|| !PX_(merge_heap_buffer)(&x->merge, x->runs.size + 1)) return 0;
+	run = x->runs.data + x->runs.size;
+	if(!PX_(run_open)(x, run)) return 0;
+	/* Heap-sort in place, the top going to the vacated back; descending. */
+	for(i = n; i; i--)
+		temp = *n0, X_(external_heap_pop)(h), PXH_(copy)(&temp, n0 + i - 1);
+	for(i = 0; i < n >> 1; i++)
+		temp = n0[i], PXH_(copy)(n0 + n - 1 - i, n0 + i),
+		PXH_(copy)(&temp, n0 + n - 1 - i);
+	/* Ascending order is also a valid heap if we have to back out. */
+	h->a.size = run->unread = n;
+	if(fwrite(n0, sizeof *n0, n, run->fp) != n || fflush(run->fp)
+		|| fseek(run->fp, 0, SEEK_SET) || !PX_(run_load)(x, run)) {
+		if(!errno) errno = ERANGE;
+		PX_(run_close)(run);
+		return 0;
+	}
+	h->a.size = 0;
+	x->runs.size++;
+	PX_(cascade)(x);
+	PX_(remerge)(x, 0);
+	return 1;
+}
+
+/** Initializes `x` to be idle with the default parameters.
+ @order \Theta(1) @allow */
+static void X_(external)(struct X_(external) *const x) {
+	assert(x);
+	X_(external_heap)(&x->insert);
+	PX_(run_array)(&x->runs);
+	PX_(merge_heap)(&x->merge);
+	x->size = x->budget = x->block = 0;
+	x->dir = 0;
+	x->id = 0;
+	x->error = 0;
+}
+
+/** Returns `x` to the idle state, closing and removing all the temporary
+ files. The parameters are reset. @order \O(`runs`) @allow */
+static void X_(external_)(struct X_(external) *const x) {
+	struct PX_(run) *r, *r_end;
+	assert(x);
+	for(r = x->runs.data, r_end = r + x->runs.size; r < r_end; r++)
+		PX_(run_close)(r);
+	X_(external_heap_)(&x->insert);
+	PX_(run_array_)(&x->runs);
+	PX_(merge_heap_)(&x->merge);
+	X_(external)(x);
+}
+
+/** Sets the parameters of `x`, which must be empty.
+ @param[budget] The bytes of memory for the insertion heap; zero is
+ `EXTERNAL_BUDGET`. @param[block] The bytes of each read or write; zero is
+ `EXTERNAL_BLOCK`. @param[dir] A directory on local disk for temporary files
+ that must last as long as `x`; null uses `tmpfile`.
+ @order \Theta(1) @allow */
+static void X_(external_tune)(struct X_(external) *const x,
+	const size_t budget, const size_t block, const char *const dir) {
+	assert(x && !x->size);
+	x->budget = budget, x->block = block, x->dir = dir;
+}
+
+/** @return The number of items in `x`. @order \Theta(1) @allow */
+static size_t X_(external_size)(const struct X_(external) *const x)
+	{ return assert(x), x->size; }
+
+/** Copies `node` into `x`.
+ @return Success. @throws[ERANGE, realloc, fopen, tmpfile, fread, fwrite]
+ @order amortized \O(log `size`) @allow */
+static int X_(external_add)(struct X_(external) *const x, PX_(node) node) {
+	assert(x);
+	if(x->insert.a.size >= PX_(capacity)(x) && !PX_(spill)(x)) return 0;
+	if(!X_(external_heap_add)(&x->insert, node)) return 0;
+	return x->size++, 1;
+}
+
+/** @return Lowest in `x` according to `EXTERNAL_COMPARE` or null if it is
+ empty. This pointer is valid only until one makes structural changes.
+ @order \O(1) @allow */
+static PX_(node) *X_(external_peek)(const struct X_(external) *const x) {
+	PX_(node) *const i = X_(external_heap_peek)(&x->insert), *r;
+	const struct PX_(merge_heap_node) *const top
+		= PX_(merge_heap_peek)(&x->merge);
+	assert(x);
+	if(!top) return i;
+	r = top->value->block + top->value->cursor;
+	return i && PX_(compare)(PXH_(get_priority)(r), PXH_(get_priority)(i)) > 0
+		? i : r;
+}
+
+/** @return Lowest <typedef:<PX>value> in `x` according to `EXTERNAL_COMPARE`;
+ if it is empty, null or zero. @order \O(1) @allow */
+static PX_(value) X_(external_peek_value)(const struct X_(external) *const x) {
+	const PX_(node) *const n = X_(external_peek)(x);
+	return n ? PXH_(get_value)(n) : 0;
+}
+
+/** Remove the lowest element according to `EXTERNAL_COMPARE`. If a block can
+ not be read, the rest of that run is lost and `errno` is set; so is it if
+ items were lost before, when a failed merge could not rewind a run.
+ @return The <typedef:<PX>value> of the element that was removed; if it is
+ empty, null or zero. @throws[fread] @order amortized \O(log `size`) @allow */
+static PX_(value) X_(external_pop)(struct X_(external) *const x) {
+	PX_(node) *const n = X_(external_peek)(x);
+	PX_(value) v;
+	struct PX_(run) *run;
+	if(x->error) errno = x->error, x->error = 0;
+	if(!n) return 0;
+	v = PXH_(get_value)(n);
+	run = x->merge.a.size ? x->merge.a.data->value : 0;
+	if(run && n == run->block + run->cursor) {
+		if(!PX_(advance)(x, run)) {
+			x->size -= run->unread;
+			PX_(run_close)(run);
+			PX_(run_array_remove)(&x->runs, run);
+			PX_(remerge)(x, 0);
+		}
+	} else {
+		X_(external_heap_pop)(&x->insert);
+	}
+	x->size--;
+	return v;
+}
+
+#ifdef EXTERNAL_TEST /* <!-- test */
+#include "../test/test_external.h" /** \include */
+#endif /* test --> */
+
+static void PX_(unused_base_coda)(void);
+static void PX_(unused_base)(void) {
+	X_(external)(0); X_(external_)(0); X_(external_tune)(0, 0, 0, 0);
+	X_(external_size)(0); X_(external_peek_value)(0); X_(external_pop)(0);
+	PX_(unused_base_coda)();
+}
+static void PX_(unused_base_coda)(void) { PX_(unused_base)(); }
+
+#ifndef EXTERNAL_SUBTYPE /* <!-- !sub-type */
+#undef CAT
+#undef CAT_
+#else /* !sub-type --><!-- sub-type */
+#undef EXTERNAL_SUBTYPE
+#endif /* sub-type --> */
+#undef X_
+#undef PX_
+#undef PXH_
+#undef EXTERNAL_NAME
+#undef EXTERNAL_TYPE
+#undef EXTERNAL_COMPARE
+#ifdef EXTERNAL_VALUE
+#undef EXTERNAL_VALUE
+#endif
+#undef EXTERNAL_BUDGET
+#undef EXTERNAL_BLOCK
+#ifdef EXTERNAL_TEST
+#undef EXTERNAL_TEST
+#endif
@@ -16,7 +16,8 @@
  `<H>` that satisfies `C` naming conventions when mangled and an assignable
  type <typedef:<PH>priority> associated therewith. `HEAP_NAME` is required but
  `HEAP_TYPE` defaults to `unsigned int` if not specified. `<PH>` is private,
- whose names are prefixed in a manner to avoid collisions.
+ whose names are prefixed in a manner to avoid collisions. For `double`,
+ signed, or tuple priorities, `key_u64` from <key.h> keeps the default compare.
 
  @param[HEAP_COMPARE]
  A function satisfying <typedef:<PH>compare_fn>. Defaults to minimum-hash on
@@ -27,6 +28,88 @@
  Optional payload <typedef:<PH>adjunct>, that is stored as a reference in
  <tag:<H>heap_node> as <typedef:<PH>value>; declaring it is sufficient.
 
+ @param[HEAP_HANDLE]
+ Optional payload that is stored by value in <tag:<H>heap_node> as
+ <typedef:<PH>value>, instead of `HEAP_VALUE`; zero is null. For example,
+ `pool_handle` from a pool with `POOL_HANDLE` in <../test/pool.h>, which is 32
+ bits: with an `unsigned` priority, a node is 8 bytes instead of 16.
+
+ @param[HEAP_ALLOC, HEAP_REALLOC, HEAP_FREE, HEAP_ALLOC_CONTEXT]
+ Optional allocator of the node array; passed to `ARRAY_ALLOC`,
+ `ARRAY_REALLOC`, `ARRAY_FREE`, and `ARRAY_ALLOC_CONTEXT` in <array.h>.
+
+ @param[HEAP_INLINE_CAPACITY]
+ Optional number of nodes stored inside <tag:<H>heap> before it allocates;
+ passed to `ARRAY_INLINE_CAPACITY` in <array.h>. The heap may be moved.
+
+ @param[HEAP_STATIC_CAPACITY]
+ Optional fixed number of nodes stored inside <tag:<H>heap>; it never
+ allocates, (`ARRAY_STATIC_CAPACITY` in <array.h>.) <fn:<H>heap_add> fails
+ with `ERANGE` when it's full; <fn:<H>heap_add_evict> drops the lowest
+ priority instead. Worst-case, <fn:<H>heap_add>, <fn:<H>heap_pop>, and
+ <fn:<H>heap_replace> are \O(log `HEAP_STATIC_CAPACITY`),
+ <fn:<H>heap_add_evict> is \O(`HEAP_STATIC_CAPACITY`), and
+ <fn:<H>heap_peek> is \O(1). Exclusive with `HEAP_INLINE_CAPACITY`.
+
+ @param[HEAP_STATS]
+ Optional; each <tag:<H>heap> counts the work under it in a
+ <tag:<H>heap_stats>, see <fn:<H>heap_stats>. Otherwise, the counters are
+ compiled out. `HEAP_IDLE` leaves them out; `<H>heap_idle` lists them.
+
+ @param[HEAP_TRACE]
+ Optional; <fn:<H>heap_trace> starts logging every call to the public
+ functions that take a <tag:<H>heap> to a binary file for replay, as in
+ <../bench/replay.c>. The file starts with `HTR1`, the size of
+ <typedef:<PH>priority>, and the size of `size_t`, one byte each. Each call is
+ a byte, `a` add, `k` peek, `p` pop, `r` replace, `e` evict, `c` clear, `d`
+ destroy, `b` buffer, or `n` append, followed by the priority for `a`, `r`, and
+ `e`, and by the `size_t` count for `b` and `n`, which `n` follows with the
+ priorities it appended. Everything is in the byte order of the machine.
+ Values are not logged, nor are calls that fail. `HEAP_IDLE` leaves out the
+ file; `<H>heap_idle` lists it.
+
+ @param[HEAP_FILE]
+ Optional; the array lives in a file mapped with <fn:alloc_file_open> from
+ <alloc.h>, which must be in the same directory, instead of `HEAP_ALLOC`.
+ <fn:<H>heap_open> opens it in \O(1), with the size stored in the file after
+ every call that changes it, so it survives the process stopping between
+ calls; <fn:<H>heap_sync> makes it survive the system, too. It can not have
+ `HEAP_VALUE` pointers, (but `HEAP_HANDLE` is fine,) nor an inline or static
+ capacity. The file must be opened by the same type of heap and machine.
+
+ @param[HEAP_SAVE, HEAP_SAVE_ID, HEAP_SAVE_VALUE, HEAP_LOAD_VALUE]
+ Optional; <fn:<H>heap_save> writes a snapshot of the array that
+ <fn:<H>heap_load> reads back in heap order, without adding or heapifying. The
+ header has a version, the size of a node, `HEAP_SAVE_ID`, an
+ `unsigned long` that should name `HEAP_COMPARE`, (default zero,) the count,
+ and a checksum; all in the byte order of the machine. Nodes are written as
+ bytes, so with `HEAP_VALUE`, which is a pointer, one must also define
+ `HEAP_SAVE_VALUE` and `HEAP_LOAD_VALUE` satisfying
+ <typedef:<PH>save_value_fn> and <typedef:<PH>load_value_fn>; then only the
+ priorities are written as bytes. `HEAP_HANDLE` is written as it is.
+
+ @param[HEAP_JOURNAL]
+ Optional with `HEAP_SAVE`; a write-ahead log for a durable priority queue.
+ <fn:<H>heap_journal> appends every change to a <tag:<H>heap> to a stream,
+ which buffers them, and commits a batch with one `fdatasync` every so many
+ calls, or at <fn:<H>heap_commit>, so durability costs one sequential write
+ per batch instead of per call. <fn:<H>heap_checkpoint> compacts it by
+ replacing a snapshot and starting over the journal, and
+ <fn:<H>heap_recover> loads the snapshot and replays the committed tail. The
+ heap in memory is the same; a failure of the journal only shows up at the
+ next <fn:<H>heap_commit>. POSIX; it can not have `HEAP_VALUE` pointers.
+ `HEAP_IDLE` leaves out the journal; `<H>heap_idle` lists it.
+
+ @param[HEAP_THREADS]
+ Optional maximum number of POSIX threads that heapify in
+ <fn:<H>heap_append>; build with `-pthread`. The subtrees below the top few
+ levels are independent, so they are split between the threads, and the top
+ levels are finished on the calling thread; the array is the same as with one.
+ <fn:<H>heap_drain> sorts pieces of the array on the threads and merges them
+ on the threads, split evenly by merge path, <Odeh, Green, et al., 2012>. It
+ is only worth it with a lot of nodes for each thread, otherwise it stays on
+ the calling thread, as it does with `HEAP_STATS`, which counts exactly.
+
  @param[HEAP_TEST]
  To string trait contained in <../test/heap_test.h>; optional unit testing
  framework using `assert`. Must be defined equal to a random filler function,
@@ -69,6 +152,23 @@
 
 #if HEAP_TRAITS == 0 /* <!-- base code */
 
+#if defined(HEAP_TRACE) || defined(HEAP_SAVE) /* <!-- file */
+#include <stdio.h> /* FILE fwrite fread */
+#endif /* file --> */
+#ifdef HEAP_JOURNAL /* <!-- journal */
+#ifndef HEAP_SAVE
+#error HEAP_JOURNAL requires HEAP_SAVE.
+#endif
+#if defined(HEAP_VALUE) && !defined(HEAP_HANDLE)
+#error HEAP_JOURNAL can not have HEAP_VALUE pointers.
+#endif
+#include <stdlib.h> /* malloc free */
+#include <unistd.h> /* fdatasync fsync ftruncate close */
+#include <fcntl.h>  /* open */
+#endif /* journal --> */
+#ifdef HEAP_THREADS /* <!-- threads */
+#include <pthread.h> /* pthread_create pthread_join */
+#endif /* threads --> */
 
 /* <Kernighan and Ritchie, 1988, p. 231>. */
 #if defined(H_) || defined(PH_) \
@@ -84,6 +184,12 @@
 #ifndef HEAP_TYPE
 #define HEAP_TYPE unsigned
 #endif
+#ifdef HEAP_HANDLE /* <!-- handle: the same as a value, but not a pointer. */
+#ifdef HEAP_VALUE
+#error HEAP_VALUE and HEAP_HANDLE are exclusive.
+#endif
+#define HEAP_VALUE HEAP_HANDLE
+#endif /* handle --> */
 
 /** Valid assignable type used for priority in <typedef:<PH>node>. Defaults to
  `unsigned int` if not set by `HEAP_TYPE`. */
@@ -106,11 +212,16 @@ static int PH_(default_compare)(const PH_(priority) a, const PH_(priority) b)
 static const PH_(compare_fn) PH_(compare) = (HEAP_COMPARE);
 
 #ifdef HEAP_VALUE /* <!-- value */
+#ifdef HEAP_HANDLE /* <!-- handle */
+/** If `HEAP_HANDLE` is set, the handle itself. */
+typedef HEAP_HANDLE PH_(value);
+#else /* handle --><!-- !handle */
 /** If `HEAP_VALUE` is set, a declared tag type. */
 typedef HEAP_VALUE PH_(adjunct);
 /** If `HEAP_VALUE` is set, this is a pointer to it, otherwise a boolean
  value that is true when there is an item. */
 typedef PH_(adjunct) *PH_(value);
+#endif /* !handle --> */
 /** If `HEAP_VALUE` is set, creates a value as the payload of
  <typedef:<PH>node>. */
 struct H_(heap_node) { PH_(priority) priority; PH_(value) value; };
@@ -126,18 +237,81 @@ typedef PH_(priority) PH_(node);
 #define ARRAY_NAME PH_(node)
 #define ARRAY_TYPE PH_(node)
 #define ARRAY_SUBTYPE
+#ifdef HEAP_FILE /* <!-- file */
+#if defined(HEAP_ALLOC) || defined(HEAP_INLINE_CAPACITY) \
+	|| defined(HEAP_STATIC_CAPACITY) \
+	|| (defined(HEAP_VALUE) && !defined(HEAP_HANDLE))
+#error HEAP_FILE is exclusive with an allocator, a capacity, and HEAP_VALUE.
+#endif
+#include "alloc.h"
+#ifndef ALLOC_MAP_ANON
+#error HEAP_FILE needs mmap.
+#endif
+#define HEAP_ALLOC &alloc_file
+#define HEAP_REALLOC &alloc_file_realloc
+#define HEAP_FREE &alloc_file_free
+#endif /* file --> */
+#ifdef HEAP_ALLOC /* <!-- alloc */
+#define ARRAY_ALLOC HEAP_ALLOC
+#endif /* alloc --> */
+#ifdef HEAP_REALLOC /* <!-- realloc */
+#define ARRAY_REALLOC HEAP_REALLOC
+#endif /* realloc --> */
+#ifdef HEAP_FREE /* <!-- free */
+#define ARRAY_FREE HEAP_FREE
+#endif /* free --> */
+#ifdef HEAP_ALLOC_CONTEXT /* <!-- context */
+#define ARRAY_ALLOC_CONTEXT HEAP_ALLOC_CONTEXT
+#endif /* context --> */
+#ifdef HEAP_INLINE_CAPACITY /* <!-- inline */
+#define ARRAY_INLINE_CAPACITY HEAP_INLINE_CAPACITY
+#endif /* inline --> */
+#ifdef HEAP_STATIC_CAPACITY /* <!-- static */
+#define ARRAY_STATIC_CAPACITY HEAP_STATIC_CAPACITY
+#endif /* static --> */
 #include "array.h"
 
 /** Stores the heap as an implicit binary tree in an array called `a`. To
- initialize it to an idle state, see <fn:<H>heap>, `HEAP_IDLE`, `{0}` (`C99`),
- or being `static`.
+ initialize it to an idle state, see <fn:<H>heap>, `<H>heap_idle`, `HEAP_IDLE`,
+ `{0}` (`C99`), or being `static`.
 
  ![States.](../web/states.png) */
 struct H_(heap);
-struct H_(heap) { struct PH_(node_array) a; };
+#ifdef HEAP_STATS /* <!-- stats */
+/** If `HEAP_STATS`, counts of the work done by a <tag:<H>heap>: calls to
+ `HEAP_COMPARE`, nodes copied, levels travelled by sifting up or down,
+ allocations of the array and the bytes allocated by them, and the most nodes
+ it has held. */
+struct H_(heap_stats) { size_t compares, copies, levels, reallocs,
+	realloc_bytes, peak; };
+#endif /* stats --> */
+#ifdef HEAP_JOURNAL /* <!-- journal */
+/** If `HEAP_JOURNAL`, the write-ahead log of a <tag:<H>heap>: the stream, or
+ null if there is none, the checksum of the records so far, the calls between
+ commits, the calls since the last commit, and the first error. */
+struct H_(heap_journal) { FILE *fp; unsigned long hash; size_t interval,
+	pending; int error; };
+#endif /* journal --> */
+struct H_(heap) { struct PH_(node_array) a;
+#ifdef HEAP_STATS /* <!-- stats */
+	struct H_(heap_stats) stats;
+#endif /* stats --> */
+#ifdef HEAP_TRACE /* <!-- trace */
+	FILE *trace;
+#endif /* trace --> */
+#ifdef HEAP_JOURNAL /* <!-- journal */
+	struct H_(heap_journal) journal;
+#endif /* journal --> */
+};
 #ifndef HEAP_IDLE /* <!-- !zero */
 #define HEAP_IDLE { ARRAY_IDLE }
 #endif /* !zero --> */
+/** An idle heap of this type; unlike `HEAP_IDLE`, it has every member. */
+static const struct H_(heap) H_(heap_idle);
+
+/** @return The nodes of `heap`, or null if it is idle. */
+static PH_(node) *PH_(nodes)(const struct H_(heap) *const heap)
+	{ return PH_(node_array_data)(&heap->a); }
 
 /** Extracts the <typedef:<PH>priority> of `node`, which must not be null. */
 static PH_(priority) PH_(get_priority)(const PH_(node) *const node) {
@@ -172,45 +346,215 @@ static void PH_(copy)(const PH_(node) *const src, PH_(node) *const dest) {
 #endif /* !value --> */
 }
 
-/** Find the spot in `heap` where `node` goes and put it there.
- @param[heap] At least one entry; the last entry will be replaced by `node`.
- @order \O(log `size`) */
-static void PH_(sift_up)(struct H_(heap) *const heap, PH_(node) *const node) {
-	PH_(node) *const n0 = heap->a.data;
+/** @return `HEAP_COMPARE` of `a` and `b`, counted in `heap`. */
+static int PH_(order)(struct H_(heap) *const heap, const PH_(priority) a,
+	const PH_(priority) b) {
+#ifdef HEAP_STATS /* <!-- stats */
+	heap->stats.compares++;
+#else /* stats --><!-- !stats */
+	(void)heap;
+#endif /* !stats --> */
+	return PH_(compare)(a, b);
+}
+
+/** <fn:<PH>copy> `src` to `dest`, counted in `heap`; `is_level` if it moves
+ along a sift. */
+static void PH_(move)(struct H_(heap) *const heap, const PH_(node) *const src,
+	PH_(node) *const dest, const int is_level) {
+#ifdef HEAP_STATS /* <!-- stats */
+	heap->stats.copies++, heap->stats.levels += !!is_level;
+#else /* stats --><!-- !stats */
+	(void)heap, (void)is_level;
+#endif /* !stats --> */
+	PH_(copy)(src, dest);
+}
+
+/** Counts in `heap` that it may have been resized from `capacity`. */
+static void PH_(grown)(struct H_(heap) *const heap, const size_t capacity) {
+#ifdef HEAP_STATS /* <!-- stats */
+	if(heap->a.capacity != capacity) heap->stats.reallocs++,
+		heap->stats.realloc_bytes += sizeof(PH_(node)) * heap->a.capacity;
+	if(heap->a.size > heap->stats.peak) heap->stats.peak = heap->a.size;
+#else /* stats --><!-- !stats */
+	(void)heap, (void)capacity;
+#endif /* !stats --> */
+}
+
+/** Logs the call `op` on `heap` with the priority of `node`, if not null. */
+static void PH_(trace)(const struct H_(heap) *const heap, const char op,
+	const PH_(node) *const node) {
+#ifdef HEAP_TRACE /* <!-- trace */
+	PH_(priority) p;
+	if(!heap->trace) return;
+	fputc(op, heap->trace);
+	if(node) p = PH_(get_priority)(node), fwrite(&p, sizeof p, 1, heap->trace);
+#else /* trace --><!-- !trace */
+	(void)heap, (void)op, (void)node;
+#endif /* !trace --> */
+}
+
+/** Logs the call `op` on `heap` with the count `n`, followed by the
+ priorities of `nodes`, if not null. */
+static void PH_(trace_n)(const struct H_(heap) *const heap, const char op,
+	const size_t n, const PH_(node) *const nodes) {
+#ifdef HEAP_TRACE /* <!-- trace */
+	PH_(priority) p;
+	size_t i;
+	if(!heap->trace) return;
+	fputc(op, heap->trace), fwrite(&n, sizeof n, 1, heap->trace);
+	if(nodes) for(i = 0; i < n; i++)
+		p = PH_(get_priority)(nodes + i), fwrite(&p, sizeof p, 1, heap->trace);
+#else /* trace --><!-- !trace */
+	(void)heap, (void)op, (void)n, (void)nodes;
+#endif /* !trace --> */
+}
+
+#ifdef HEAP_SAVE /* <!-- save */
+/** @return FNV-1a, 32-bit, of `size` bytes at `data`, continuing `hash`. */
+static unsigned long PH_(checksum)(unsigned long hash, const void *const data,
+	const size_t size) {
+	const unsigned char *b = data, *const end = b + size;
+	while(b < end) hash = ((hash ^ *b++) * 16777619ul) & 0xfffffffful;
+	return hash;
+}
+#endif /* save --> */
+
+#ifdef HEAP_JOURNAL /* <!-- journal */
+/** Flushes `fp` and waits for the disk. @return Success. */
+static int PH_(journal_sync)(FILE *const fp) {
+	if(fflush(fp)) return 0;
+#if defined(_POSIX_SYNCHRONIZED_IO) && _POSIX_SYNCHRONIZED_IO > 0
+	return !fdatasync(fileno(fp));
+#else
+	return !fsync(fileno(fp));
+#endif
+}
+
+/** Waits for the directory of `path` to be on the disk, so that a rename in it
+ is durable. @return Success. @throws[malloc, open, fsync] */
+static int PH_(journal_sync_dir)(const char *const path) {
+	const char *const slash = strrchr(path, '/');
+	const size_t length = !slash ? 0 : slash == path ? 1
+		: (size_t)(slash - path);
+	char *dir = 0;
+	int fd, is_ok;
+	if(length) {
+		if(!(dir = malloc(length + 1))) return 0;
+		memcpy(dir, path, length), dir[length] = '\0';
+	}
+	fd = open(dir ? dir : ".", O_RDONLY);
+	free(dir);
+	if(fd < 0) return 0;
+	is_ok = !fsync(fd);
+	if(close(fd)) is_ok = 0;
+	return is_ok;
+}
+
+/** Writes `size` bytes of `data` to the journal of `heap` and the checksum. */
+static void PH_(journal_write)(struct H_(heap) *const heap,
+	const void *const data, const size_t size) {
+	struct H_(heap_journal) *const j = &heap->journal;
+	if(fwrite(data, 1, size, j->fp) != size && !j->error)
+		j->error = errno ? errno : ERANGE;
+	j->hash = PH_(checksum)(j->hash, data, size);
+}
+
+/** Ends the batch in the journal of `heap`, if any, with a commit record of
+ the checksum, and waits for the disk. @return The journal has not failed. */
+static int PH_(journal_commit)(struct H_(heap) *const heap) {
+	struct H_(heap_journal) *const j = &heap->journal;
+	unsigned long hash;
+	if(!j->fp || !j->pending) return !j->error;
+	PH_(journal_write)(heap, "C", 1), hash = j->hash, j->pending = 0;
+	if((fwrite(&hash, sizeof hash, 1, j->fp) != 1
+		|| !PH_(journal_sync)(j->fp)) && !j->error)
+		j->error = errno ? errno : ERANGE;
+	return !j->error;
+}
+#endif /* journal --> */
+
+/** Journals the change `op` to `heap` with `n` `nodes`, if `HEAP_JOURNAL`;
+ the count is also written for `n`, append. Commits every `interval`. */
+static void PH_(journal)(struct H_(heap) *const heap, const char op,
+	const size_t n, const PH_(node) *const nodes) {
+#ifdef HEAP_JOURNAL /* <!-- journal */
+	struct H_(heap_journal) *const j = &heap->journal;
+	if(!j->fp) return;
+	PH_(journal_write)(heap, &op, 1);
+	if(op == 'n') PH_(journal_write)(heap, &n, sizeof n);
+	if(nodes && n) PH_(journal_write)(heap, nodes, sizeof *nodes * n);
+	if(++j->pending == j->interval) PH_(journal_commit)(heap);
+#else /* journal --><!-- !journal */
+	(void)heap, (void)op, (void)n, (void)nodes;
+#endif /* !journal --> */
+}
+
+/** Stores the size of `heap` in its file, if `HEAP_FILE`. */
+static void PH_(persist)(struct H_(heap) *const heap) {
+#ifdef HEAP_FILE /* <!-- file */
+	if(heap->a.data) alloc_file_header(heap->a.data)->used = heap->a.size;
+#else /* file --><!-- !file */
+	(void)heap;
+#endif /* !file --> */
+}
+
+/** Find the spot in `heap` above `i` where `node` goes and put it there.
+ @param[heap] At least one entry; entry `i` will be replaced by `node`.
+ @order \O(log `i`) */
+static void PH_(sift_up_i)(struct H_(heap) *const heap, size_t i,
+	PH_(node) *const node) {
+	PH_(node) *const n0 = PH_(nodes)(heap);
 	PH_(priority) p = PH_(get_priority)(node);
-	size_t i = heap->a.size - 1;
-	assert(heap && heap->a.size && node);
+	assert(heap && i < heap->a.size && node);
 	if(i) {
 		size_t i_up;
 		do { /* Note: don't change the `<=`; it's a queue. */
 			i_up = (i - 1) >> 1;
-			if(PH_(compare)(PH_(get_priority)(n0 + i_up), p) <= 0) break;
-			PH_(copy)(n0 + i_up, n0 + i);
+			if(PH_(order)(heap, PH_(get_priority)(n0 + i_up), p) <= 0) break;
+			PH_(move)(heap, n0 + i_up, n0 + i, 1);
 		} while((i = i_up));
 	}
-	PH_(copy)(node, n0 + i);
+	PH_(move)(heap, node, n0 + i, 0);
 }
 
-/** Pop the head of `heap` and restore the heap by sifting down the last
- element. @param[heap] At least one entry. The head is popped, and the size
- will be one less. */
-static void PH_(sift_down)(struct H_(heap) *const heap) {
-	const size_t size = (assert(heap && heap->a.size), --heap->a.size),
+/** Find the spot in `heap` where `node` goes and put it there.
+ @param[heap] At least one entry; the last entry will be replaced by `node`.
+ @order \O(log `size`) */
+static void PH_(sift_up)(struct H_(heap) *const heap, PH_(node) *const node) {
+	assert(heap && heap->a.size);
+	PH_(sift_up_i)(heap, heap->a.size - 1, node);
+}
+
+/** Replace the head of `heap` with `down` and restore the heap by sifting it
+ down. @param[heap] At least one entry. @param[down] Not in the first `size`
+ entries of `heap`. */
+static void PH_(sift_root)(struct H_(heap) *const heap,
+	const PH_(node) *const down) {
+	const size_t size = (assert(heap && heap->a.size), heap->a.size),
 		half = size >> 1;
 	size_t i = 0, c;
-	PH_(node) *const n0 = heap->a.data,
-		*const down = n0 + size /* Put it at the top. */, *child;
+	PH_(node) *const n0 = PH_(nodes)(heap), *child;
 	const PH_(priority) down_p = PH_(get_priority)(down);
 	while(i < half) {
 		c = (i << 1) + 1;
-		if(c + 1 < size && PH_(compare)(PH_(get_priority)(n0 + c),
+		if(c + 1 < size && PH_(order)(heap, PH_(get_priority)(n0 + c),
 			PH_(get_priority)(n0 + c + 1)) > 0) c++;
 		child = n0 + c;
-		if(PH_(compare)(down_p, PH_(get_priority)(child)) <= 0) break;
-		PH_(copy)(child, n0 + i);
+		if(PH_(order)(heap, down_p, PH_(get_priority)(child)) <= 0) break;
+		PH_(move)(heap, child, n0 + i, 1);
 		i = c;
 	}
-	PH_(copy)(down, n0 + i);
+	PH_(move)(heap, down, n0 + i, 0);
+}
+
+/** Pop the head of `heap` and restore the heap by sifting down the last
+ element. @param[heap] At least one entry. The head is popped, and the size
+ will be one less. */
+static void PH_(sift_down)(struct H_(heap) *const heap) {
+	assert(heap && heap->a.size);
+	/* Put the last at the top; it is outside the new size. */
+	heap->a.size--;
+	PH_(sift_root)(heap, PH_(nodes)(heap) + heap->a.size);
 }
 
 /** Restore the `heap` by permuting the elements so `i` is in the proper place.
@@ -221,40 +565,204 @@ static void PH_(sift_down_i)(struct H_(heap) *const heap, size_t i) {
 	const size_t size = (assert(heap && i < heap->a.size), heap->a.size),
 		half = size >> 1;
 	size_t c;
-	PH_(node) *const n0 = heap->a.data, *child, temp;
+	PH_(node) *const n0 = PH_(nodes)(heap), *child, temp;
 	int temp_valid = 0;
 	while(i < half) {
 		c = (i << 1) + 1;
-		if(c + 1 < size && PH_(compare)(PH_(get_priority)(n0 + c),
+		if(c + 1 < size && PH_(order)(heap, PH_(get_priority)(n0 + c),
 			PH_(get_priority)(n0 + c + 1)) > 0) c++;
 		child = n0 + c;
 		if(temp_valid) {
-			if(PH_(compare)(PH_(get_priority)(&temp),
+			if(PH_(order)(heap, PH_(get_priority)(&temp),
 				PH_(get_priority)(child)) <= 0) break;
 		} else {
 			/* Only happens on the first compare when `i` is in it's original
 			 position. */
-			if(PH_(compare)(PH_(get_priority)(n0 + i),
+			if(PH_(order)(heap, PH_(get_priority)(n0 + i),
 				PH_(get_priority)(child)) <= 0) break;
-			PH_(copy)(n0 + i, &temp), temp_valid = 1;
+			PH_(move)(heap, n0 + i, &temp, 0), temp_valid = 1;
 		}
-		PH_(copy)(child, n0 + i);
+		PH_(move)(heap, child, n0 + i, 1);
 		i = c;
 	}
-	if(temp_valid) PH_(copy)(&temp, n0 + i);
+	if(temp_valid) PH_(move)(heap, &temp, n0 + i, 0);
 }
 
+#if defined(HEAP_THREADS) && !defined(HEAP_STATS) /* <!-- threads */
+/** Fewest internal nodes for each thread. */
+static const size_t PH_(thread_min) = 16384;
+
+/** The share of one thread in <fn:<PH>heapify>: the subtrees of `heap` with
+ roots `[root, root_end)` on one level. */
+struct PH_(heapify_share) { struct H_(heap) *heap; size_t root, root_end;
+	pthread_t thread; int is_thread; };
+
+/** Sifts down the internal nodes in the subtrees of `share`, deepest first;
+ the descendants of a range of nodes on one level are a range on each level
+ below. @return Null. */
+static void *PH_(heapify_subtrees)(void *const share) {
+	const struct PH_(heapify_share) *const s = share;
+	const size_t half = s->heap->a.size >> 1;
+	size_t depth = 0, lo, hi;
+	assert(s->root < s->root_end && s->root < half);
+	while(((s->root + 1) << (depth + 1)) - 1 < half) depth++;
+	do {
+		lo = ((s->root + 1) << depth) - 1;
+		hi = ((s->root_end + 1) << depth) - 1;
+		if(hi > half) hi = half;
+		while(hi > lo) PH_(sift_down_i)(s->heap, --hi);
+	} while(depth--);
+	return 0;
+}
+#endif /* threads --> */
+
 /** Create a `heap` from an array. @order \O(`heap.size`) */
 static void PH_(heapify)(struct H_(heap) *const heap) {
 	size_t i;
+#if defined(HEAP_THREADS) && !defined(HEAP_STATS) /* <!-- threads */
+	struct PH_(heapify_share) share[HEAP_THREADS];
+	const size_t half = (assert(heap), heap->a.size >> 1);
+	size_t threads = half / PH_(thread_min), level = 0, first, roots, t;
+	if(threads > HEAP_THREADS) threads = HEAP_THREADS;
+	if(threads > 1) {
+		/* A few subtrees for each thread, so they come out about even. */
+		while(((size_t)1 << level) < threads << 2) level++;
+		first = ((size_t)1 << level) - 1, roots = first + 1;
+		if(first + roots > half) roots = half - first;
+		for(t = 0; t < threads; t++) {
+			share[t].heap = heap;
+			share[t].root = first + roots * t / threads;
+			share[t].root_end = first + roots * (t + 1) / threads;
+			share[t].is_thread = t && !pthread_create(&share[t].thread, 0,
+				&PH_(heapify_subtrees), share + t);
+		}
+		PH_(heapify_subtrees)(share);
+		/* If a thread could not start, its share is done here. */
+		for(t = 1; t < threads; t++) if(share[t].is_thread)
+			pthread_join(share[t].thread, 0);
+			else PH_(heapify_subtrees)(share + t);
+		for(i = first; i; ) PH_(sift_down_i)(heap, --i);
+		return;
+	}
+#endif /* threads --> */
 	assert(heap);
-	if(heap->a.size)
+	if(heap->a.size > 1)
 		for(i = (heap->a.size >> 1) - 1; (PH_(sift_down_i)(heap, i), i); i--);
 }
 
+/** Copies `n` of `src` to `dest` in order by insertion; they can be the
+ same. */
+static void PH_(insertion)(struct H_(heap) *const heap,
+	const PH_(node) *const src, PH_(node) *const dest, const size_t n) {
+	PH_(node) x;
+	size_t i, j;
+	for(i = 0; i < n; i++) {
+		PH_(move)(heap, src + i, &x, 0);
+		for(j = i; j && PH_(order)(heap, PH_(get_priority)(dest + j - 1),
+			PH_(get_priority)(&x)) > 0; j--)
+			PH_(move)(heap, dest + j - 1, dest + j, 0);
+		PH_(move)(heap, &x, dest + j, 0);
+	}
+}
+
+/** Merges `a` of `a_size` and `b` of `b_size`, which are in order, into
+ `dest`; `a` goes first on ties. */
+static void PH_(merge)(struct H_(heap) *const heap, const PH_(node) *a,
+	size_t a_size, const PH_(node) *b, size_t b_size, PH_(node) *dest) {
+	while(a_size && b_size)
+		if(PH_(order)(heap, PH_(get_priority)(a), PH_(get_priority)(b)) > 0)
+		PH_(move)(heap, b++, dest++, 0), b_size--;
+		else PH_(move)(heap, a++, dest++, 0), a_size--;
+	while(a_size) PH_(move)(heap, a++, dest++, 0), a_size--;
+	while(b_size) PH_(move)(heap, b++, dest++, 0), b_size--;
+}
+
+static void PH_(sort_in)(struct H_(heap) *, PH_(node) *, PH_(node) *,
+	const size_t);
+
+/** Puts `n` of `src` in order in `dest` by merge sort; `src` is scratch. */
+static void PH_(sort_to)(struct H_(heap) *const heap, PH_(node) *const src,
+	PH_(node) *const dest, const size_t n) {
+	const size_t h = n >> 1;
+	if(n <= 16) { PH_(insertion)(heap, src, dest, n); return; }
+	PH_(sort_in)(heap, src, dest, h);
+	PH_(sort_in)(heap, src + h, dest + h, n - h);
+	PH_(merge)(heap, src, h, src + h, n - h, dest);
+}
+
+/** Puts `n` of `a` in order by merge sort, with `scratch` of the same size. */
+static void PH_(sort_in)(struct H_(heap) *const heap, PH_(node) *const a,
+	PH_(node) *const scratch, const size_t n) {
+	const size_t h = n >> 1;
+	if(n <= 16) { PH_(insertion)(heap, a, a, n); return; }
+	PH_(sort_to)(heap, a, scratch, h);
+	PH_(sort_to)(heap, a + h, scratch + h, n - h);
+	PH_(merge)(heap, scratch, h, scratch + h, n - h, a);
+}
+
+#if defined(HEAP_THREADS) && !defined(HEAP_STATS) /* <!-- threads */
+/** @return The start of piece `p` of `n` split into `pieces`, without
+ overflow. */
+static size_t PH_(piece)(const size_t n, const size_t p, const size_t pieces)
+	{ return n / pieces * p + n % pieces * p / pieces; }
+
+/** The share of one thread in <fn:<H>heap_drain>: either a piece `a` of
+ `a_size` to sort, into the scratch `dest` if `is_to`; or the output `[lo, hi)`
+ of merging `a` of `a_size` and `b` of `b_size` into `dest`. */
+struct PH_(drain_share) { struct H_(heap) *heap; PH_(node) *a, *b, *dest;
+	size_t a_size, b_size, lo, hi; int is_to; pthread_t thread;
+	int is_thread; };
+
+/** Sorts the piece of `share`. @return Null. */
+static void *PH_(drain_sort)(void *const share) {
+	const struct PH_(drain_share) *const s = share;
+	if(s->is_to) PH_(sort_to)(s->heap, s->a, s->dest, s->a_size);
+	else PH_(sort_in)(s->heap, s->a, s->dest, s->a_size);
+	return 0;
+}
+
+/** @return How many of `a` of `a_size` are in the first `d` of the merge with
+ `b` of `b_size`; a binary search along the diagonal `d`. */
+static size_t PH_(merge_path)(struct H_(heap) *const heap,
+	const PH_(node) *const a, const size_t a_size, const PH_(node) *const b,
+	const size_t b_size, const size_t d) {
+	size_t lo = d > b_size ? d - b_size : 0, hi = d < a_size ? d : a_size, mid;
+	while(lo < hi) {
+		mid = lo + ((hi - lo) >> 1);
+		if(PH_(order)(heap, PH_(get_priority)(a + mid),
+			PH_(get_priority)(b + d - mid - 1)) > 0) hi = mid;
+		else lo = mid + 1;
+	}
+	return lo;
+}
+
+/** Merges the output range of `share`. @return Null. */
+static void *PH_(drain_merge)(void *const share) {
+	const struct PH_(drain_share) *const s = share;
+	const size_t i0 = PH_(merge_path)(s->heap, s->a, s->a_size, s->b,
+		s->b_size, s->lo), i1 = PH_(merge_path)(s->heap, s->a, s->a_size,
+		s->b, s->b_size, s->hi);
+	PH_(merge)(s->heap, s->a + i0, i1 - i0, s->b + s->lo - i0,
+		(s->hi - i1) - (s->lo - i0), s->dest + s->lo);
+	return 0;
+}
+
+/** Calls `fn` on each of `threads` of `share`, the first on this thread, and
+ waits for them. If a thread could not start, its share is done here. */
+static void PH_(drain_run)(struct PH_(drain_share) *const share,
+	const size_t threads, void *(*const fn)(void *)) {
+	size_t t;
+	for(t = 1; t < threads; t++) share[t].is_thread
+		= !pthread_create(&share[t].thread, 0, fn, share + t);
+	fn(share);
+	for(t = 1; t < threads; t++) if(share[t].is_thread)
+		pthread_join(share[t].thread, 0); else fn(share + t);
+}
+#endif /* threads --> */
+
 /** Removes from `heap`. Must have a non-zero size. */
 static PH_(node) PH_(remove)(struct H_(heap) *const heap) {
-	const PH_(node) result = *heap->a.data;
+	const PH_(node) result = *PH_(nodes)(heap);
 	assert(heap);
 	if(heap->a.size > 1) {
 		PH_(sift_down)(heap);
@@ -266,32 +774,57 @@ static PH_(node) PH_(remove)(struct H_(heap) *const heap) {
 }
 
 /** Initializes `heap` to be idle. @order \Theta(1) @allow */
-static void H_(heap)(struct H_(heap) *const heap)
-	{ assert(heap), PH_(node_array)(&heap->a); }
+static void H_(heap)(struct H_(heap) *const heap) {
+	assert(heap), PH_(node_array)(&heap->a);
+#ifdef HEAP_STATS /* <!-- stats */
+	memset(&heap->stats, 0, sizeof heap->stats);
+#endif /* stats --> */
+#ifdef HEAP_TRACE /* <!-- trace */
+	heap->trace = 0;
+#endif /* trace --> */
+#ifdef HEAP_JOURNAL /* <!-- journal */
+	memset(&heap->journal, 0, sizeof heap->journal);
+#endif /* journal --> */
+}
 
-/** Returns `heap` to the idle state where it takes no dynamic memory.
+/** Returns `heap` to the idle state where it takes no dynamic memory. With
+ `HEAP_JOURNAL`, it commits and stops journaling; the durable heap stays.
  @order \Theta(1) @allow */
-static void H_(heap_)(struct H_(heap) *const heap)
-	{ assert(heap), PH_(node_array_)(&heap->a); }
+static void H_(heap_)(struct H_(heap) *const heap) {
+	assert(heap), PH_(trace)(heap, 'd', 0);
+#ifdef HEAP_JOURNAL /* <!-- journal */
+	PH_(journal_commit)(heap), heap->journal.fp = 0;
+#endif /* journal --> */
+	PH_(node_array_)(&heap->a);
+}
 
 /** Sets `heap` to be empty. That is, the size of `heap` will be zero, but if
  it was previously in an active non-idle state, it continues to be.
  @param[heap] If null, does nothing. @order \Theta(1) @allow */
-static void H_(heap_clear)(struct H_(heap) *const heap)
-	{ assert(heap), PH_(node_array_clear)(&heap->a); }
+static void H_(heap_clear)(struct H_(heap) *const heap) {
+	assert(heap), PH_(trace)(heap, 'c', 0);
+	PH_(node_array_clear)(&heap->a), PH_(persist)(heap);
+	PH_(journal)(heap, 'c', 0, 0);
+}
 
 /** Copies `node` into `heap`.
  @return Success. @throws[ERANGE, realloc] @order \O(log `heap.size`) @allow */
 static int H_(heap_add)(struct H_(heap) *const heap, PH_(node) node) {
-	assert(heap);
-	return PH_(node_array_new)(&heap->a) && (PH_(sift_up)(heap, &node), 1);
+	const size_t capacity = (assert(heap), heap->a.capacity);
+	if(!PH_(node_array_new)(&heap->a)) return 0;
+	PH_(grown)(heap, capacity);
+	PH_(sift_up)(heap, &node), PH_(persist)(heap);
+	PH_(trace)(heap, 'a', &node), PH_(journal)(heap, 'a', 1, &node);
+	return 1;
 }
 
 /** @return Lowest in `heap` according to `HEAP_COMPARE` or null if the heap is
  empty. This pointer is valid only until one makes structural changes to the
  heap. @order \O(1) @allow */
-static PH_(node) *H_(heap_peek)(const struct H_(heap) *const heap)
-	{ return assert(heap), heap->a.size ? heap->a.data : 0; }
+static PH_(node) *H_(heap_peek)(const struct H_(heap) *const heap) {
+	assert(heap), PH_(trace)(heap, 'k', 0);
+	return heap->a.size ? PH_(nodes)(heap) : 0;
+}
 
 /** This returns the <typedef:<PH>value> of the <typedef:<PH>node> returned by
  <fn:<H>heap_peek>, for convenience with some applications. If `HEAP_VALUE`,
@@ -307,8 +840,28 @@ static PH_(value) H_(heap_peek_value)(struct H_(heap) *const heap)
  @order \O(log `size`) @allow */
 static PH_(value) H_(heap_pop)(struct H_(heap) *const heap) {
 	PH_(node) n;
-	return assert(heap), heap->a.size
-		? (n = PH_(remove)(heap), PH_(get_value)(&n)) : 0;
+	return assert(heap), PH_(trace)(heap, 'p', 0), heap->a.size
+		? (n = PH_(remove)(heap), PH_(persist)(heap),
+		PH_(journal)(heap, 'p', 0, 0), PH_(get_value)(&n)) : 0;
+}
+
+/** Removes the lowest element according to `HEAP_COMPARE` and copies `node`
+ into `heap` in one pass, as in replacement selection. This is faster than
+ <fn:<H>heap_pop> followed by <fn:<H>heap_add>.
+ @param[heap] If empty, this is the same as <fn:<H>heap_add>, and failure can
+ be detected by the size being zero.
+ @return The <typedef:<PH>value> of the element that was removed; if the heap
+ is empty, null or zero. @throws[ERANGE, realloc] Only if the heap is empty.
+ @order \O(log `size`) @allow */
+static PH_(value) H_(heap_replace)(struct H_(heap) *const heap,
+	PH_(node) node) {
+	PH_(value) v;
+	assert(heap);
+	if(!heap->a.size) { H_(heap_add)(heap, node); return 0; }
+	PH_(trace)(heap, 'r', &node);
+	v = PH_(get_value)(PH_(nodes)(heap));
+	PH_(sift_root)(heap, &node), PH_(journal)(heap, 'r', 1, &node);
+	return v;
 }
 
 /** The capacity of `heap` will be increased to at least `n` elements beyond
@@ -317,7 +870,14 @@ static PH_(value) H_(heap_pop)(struct H_(heap) *const heap) {
  a null pointer is returned, otherwise null indicates an error.
  @throws[realloc, ERANGE] @allow */
 static PH_(node) *H_(heap_buffer)(struct H_(heap) *const heap,
-	const size_t n) { return PH_(node_array_buffer)(&heap->a, n); }
+	const size_t n) {
+	const size_t capacity = (assert(heap), heap->a.capacity);
+	PH_(node) *buffer;
+	if((buffer = PH_(node_array_buffer)(&heap->a, n)))
+		PH_(trace_n)(heap, 'b', n, 0);
+	PH_(grown)(heap, capacity);
+	return buffer;
+}
 
 /** Adds and heapifies `n` elements to `heap`. Uses <Doberkat, 1984, Floyd> to
  sift-down all the internal nodes of heap, including any previous elements. As
@@ -331,11 +891,479 @@ static PH_(node) *H_(heap_buffer)(struct H_(heap) *const heap,
  called first, in which case, one is guaranteed success.
  @order \O(`heap.size` + `n`) @allow */
 static int H_(heap_append)(struct H_(heap) *const heap, const size_t n) {
+	const size_t capacity = (assert(heap), heap->a.capacity);
+	if(!n) return 1;
+	if(!PH_(node_array_append)(&heap->a, n)) return 0;
+	PH_(trace_n)(heap, 'n', n, PH_(nodes)(heap) + heap->a.size - n);
+	PH_(journal)(heap, 'n', n, PH_(nodes)(heap) + heap->a.size - n);
+	PH_(grown)(heap, capacity);
+	PH_(heapify)(heap), PH_(persist)(heap);
+	return 1;
+}
+
+/** Removes all of `heap` into `sorted`, in the order of <fn:<H>heap_pop>, in
+ one bulk operation: it merge sorts the array, using it as scratch.
+ @param[sorted] Room for the size of `heap`, not in it.
+ @return The number of nodes in `sorted`. @order \O(`size` log `size`)
+ @allow */
+static size_t H_(heap_drain)(struct H_(heap) *const heap,
+	PH_(node) *const sorted) {
+	const size_t n = (assert(heap && (sorted || !heap->a.size)), heap->a.size);
+#if defined(HEAP_THREADS) && !defined(HEAP_STATS) /* <!-- threads */
+	struct PH_(drain_share) share[HEAP_THREADS];
+	PH_(node) *src, *dest, *swap;
+	size_t threads = 1, level = 0, width, run, lo, mid, hi, t;
+	/* A power of two, so the merges pair up. */
+	while(threads << 1 <= HEAP_THREADS
+		&& threads << 1 <= n / PH_(thread_min)) threads <<= 1, level++;
+	if(threads > 1) {
+		/* Sort the pieces where they will be merged an odd number of times
+		 from `sorted`. */
+		src = level & 1 ? PH_(nodes)(heap) : sorted;
+		dest = level & 1 ? sorted : PH_(nodes)(heap);
+		for(t = 0; t < threads; t++) {
+			lo = PH_(piece)(n, t, threads), hi = PH_(piece)(n, t + 1, threads);
+			share[t].heap = heap, share[t].a = PH_(nodes)(heap) + lo;
+			share[t].a_size = hi - lo, share[t].dest = sorted + lo;
+			share[t].is_to = !(level & 1);
+		}
+		PH_(drain_run)(share, threads, &PH_(drain_sort));
+		/* Every thread merges an even part of one pair of runs. */
+		for(width = 2; width <= threads; width <<= 1) {
+			for(t = 0; t < threads; t++) {
+				run = t / width * width;
+				lo = PH_(piece)(n, run, threads);
+				mid = PH_(piece)(n, run + (width >> 1), threads);
+				hi = PH_(piece)(n, run + width, threads);
+				share[t].a = src + lo, share[t].a_size = mid - lo;
+				share[t].b = src + mid, share[t].b_size = hi - mid;
+				share[t].dest = dest + lo;
+				share[t].lo = PH_(piece)(hi - lo, t - run, width);
+				share[t].hi = PH_(piece)(hi - lo, t - run + 1, width);
+			}
+			PH_(drain_run)(share, threads, &PH_(drain_merge));
+			swap = src, src = dest, dest = swap;
+		}
+		assert(src == sorted);
+		H_(heap_clear)(heap);
+		return n;
+	}
+#endif /* threads --> */
+	PH_(sort_to)(heap, PH_(nodes)(heap), sorted, n);
+	H_(heap_clear)(heap);
+	return n;
+}
+
+#ifdef HEAP_STATS /* <!-- stats */
+/** @return The counters of `heap`, which live as long as it does.
+ @order \Theta(1) @allow */
+static const struct H_(heap_stats) *H_(heap_stats)(
+	const struct H_(heap) *const heap) { return assert(heap), &heap->stats; }
+
+/** Zeros the counters of `heap`, except the peak, which starts at the size.
+ @order \Theta(1) @allow */
+static void H_(heap_stats_reset)(struct H_(heap) *const heap) {
+	assert(heap);
+	memset(&heap->stats, 0, sizeof heap->stats);
+	heap->stats.peak = heap->a.size;
+}
+#endif /* stats --> */
+
+#ifdef HEAP_TRACE /* <!-- trace */
+/** Logs every call on `heap` to `fp`, a binary stream open for writing, from
+ now on, or stops if `fp` is null. It is not closed.
+ @return Success. @throws[fwrite] @allow */
+static int H_(heap_trace)(struct H_(heap) *const heap, FILE *const fp) {
+	const unsigned char sizes[] = { sizeof(PH_(priority)), sizeof(size_t) };
+	assert(heap);
+	if(fp && (fwrite("HTR1", 1, 4, fp) != 4
+		|| fwrite(sizes, 1, sizeof sizes, fp) != sizeof sizes)) return 0;
+	heap->trace = fp;
+	return 1;
+}
+#endif /* trace --> */
+
+#ifdef HEAP_FILE /* <!-- file */
+/** Opens the file at `path` as the array of the idle `heap`, or creates it
+ empty. The nodes are used where they are. @return Success.
+ @throws[EDOM] The file is not of this heap. @throws[open, fstat, ftruncate,
+ mmap] @order \O(1) @allow */
+static int H_(heap_open)(struct H_(heap) *const heap, const char *const path) {
+	PH_(node) *data;
+	struct alloc_file *f;
+	assert(heap && path && !heap->a.data);
+	if(!(data = alloc_file_open(path, sizeof *data))) return 0;
+	f = alloc_file_header(data);
+	if(f->used > f->bytes / sizeof *data)
+		{ alloc_file_free(0, data, 0); return errno = EDOM, 0; }
+	heap->a.data = data, heap->a.capacity = f->bytes / sizeof *data;
+	heap->a.size = f->used;
+	return 1;
+}
+
+/** Writes `heap` from <fn:<H>heap_open> to the disk and waits for it. Closing
+ it is <fn:<H>heap_>. @return Success. @throws[msync] @allow */
+static int H_(heap_sync)(const struct H_(heap) *const heap)
+	{ return assert(heap), !heap->a.data || alloc_file_sync(heap->a.data); }
+#endif /* file --> */
+
+#ifdef HEAP_SAVE /* <!-- save */
+#ifndef HEAP_SAVE_ID
+#define HEAP_SAVE_ID 0
+#endif
+#if defined(HEAP_VALUE) && !defined(HEAP_HANDLE) /* <!-- pointer */
+#if !defined(HEAP_SAVE_VALUE) || !defined(HEAP_LOAD_VALUE)
+#error HEAP_SAVE with HEAP_VALUE requires HEAP_SAVE_VALUE and HEAP_LOAD_VALUE.
+#endif
+/** Writes `value` to `fp` for <fn:<H>heap_save>. @return Success. */
+typedef int (*PH_(save_value_fn))(FILE *fp, const PH_(value) value);
+/** Reads `value` from `fp` for <fn:<H>heap_load>. @return Success. */
+typedef int (*PH_(load_value_fn))(FILE *fp, PH_(value) *value);
+static const PH_(save_value_fn) PH_(save_value) = (HEAP_SAVE_VALUE);
+static const PH_(load_value_fn) PH_(load_value) = (HEAP_LOAD_VALUE);
+#define HEAP_SAVE_POINTER
+#endif /* pointer --> */
+
+/** Is in the header; change it if the format changes. */
+static const unsigned long PH_(save_version) = 1;
+
+/** @return What <fn:<H>heap_save> writes of a node as bytes. */
+static size_t PH_(save_size)(void) {
+#ifdef HEAP_SAVE_POINTER /* <!-- pointer */
+	return sizeof(PH_(priority));
+#else /* pointer --><!-- !pointer */
+	return sizeof(PH_(node));
+#endif /* !pointer --> */
+}
+
+/** @return The checksum of what <fn:<H>heap_save> writes of `heap`. */
+static unsigned long PH_(save_hash)(const struct H_(heap) *const heap) {
+	const unsigned long hash = 2166136261ul;
+	const PH_(node) *const n0 = PH_(nodes)(heap);
+#ifdef HEAP_SAVE_POINTER /* <!-- pointer */
+	unsigned long h = hash;
+	size_t i;
+	for(i = 0; i < heap->a.size; i++) h = PH_(checksum)(h,
+		&n0[i].priority, sizeof n0[i].priority);
+	return h;
+#else /* pointer --><!-- !pointer */
+	return PH_(checksum)(hash, n0, sizeof *n0 * heap->a.size);
+#endif /* !pointer --> */
+}
+
+/** Writes `heap` to `fp`, a binary stream open for writing.
+ @return Success. @throws[fwrite, HEAP_SAVE_VALUE] @order \O(`size`) @allow */
+static int H_(heap_save)(const struct H_(heap) *const heap, FILE *const fp) {
+	unsigned long header[5];
+	const size_t n = (assert(heap && fp), heap->a.size);
+	const PH_(node) *const n0 = PH_(nodes)(heap);
+#ifdef HEAP_SAVE_POINTER /* <!-- pointer */
+	size_t i;
+#endif /* pointer --> */
+	header[0] = PH_(save_version), header[1] = (unsigned long)PH_(save_size)();
+	header[2] = (unsigned long)(HEAP_SAVE_ID), header[3] = (unsigned long)n;
+	header[4] = PH_(save_hash)(heap);
+	if(fwrite("HEAP", 1, 4, fp) != 4
+		|| fwrite(header, sizeof header, 1, fp) != 1) goto catch;
+#ifdef HEAP_SAVE_POINTER /* <!-- pointer */
+	for(i = 0; i < n; i++) if(fwrite(&n0[i].priority,
+		sizeof n0[i].priority, 1, fp) != 1
+		|| !PH_(save_value)(fp, n0[i].value)) goto catch;
+#else /* pointer --><!-- !pointer */
+	if(n && fwrite(n0, sizeof *n0, n, fp) != n) goto catch;
+#endif /* !pointer --> */
+	return 1;
+catch:
+	if(!errno) errno = ERANGE;
+	return 0;
+}
+
+/** Replaces the contents of `heap` with what <fn:<H>heap_save> wrote to `fp`,
+ a binary stream open for reading. The nodes are read into space from
+ <fn:<H>heap_buffer>, in one read unless there are `HEAP_VALUE` pointers, and
+ not heapified; they must have been saved with the same `HEAP_COMPARE`.
+ @return Success; otherwise, `heap` is empty.
+ @throws[EDOM] The header or checksum do not match. @throws[fread, realloc,
+ ERANGE, HEAP_LOAD_VALUE] @order \O(`size`) @allow */
+static int H_(heap_load)(struct H_(heap) *const heap, FILE *const fp) {
+	unsigned long header[5], hash = 2166136261ul;
+	char magic[4];
+	PH_(node) *buffer;
+	size_t n, capacity;
+#ifdef HEAP_SAVE_POINTER /* <!-- pointer */
+	size_t i;
+#endif /* pointer --> */
+	assert(heap && fp);
+	H_(heap_clear)(heap);
+	capacity = heap->a.capacity;
+	if(fread(magic, 1, sizeof magic, fp) != sizeof magic
+		|| fread(header, sizeof header, 1, fp) != 1) goto catch;
+	if(memcmp(magic, "HEAP", sizeof magic) || header[0] != PH_(save_version)
+		|| header[1] != (unsigned long)PH_(save_size)()
+		|| header[2] != (unsigned long)(HEAP_SAVE_ID)
+		|| (n = (size_t)header[3]) != header[3]) return errno = EDOM, 0;
+	if(!(buffer = PH_(node_array_buffer)(&heap->a, n)) && n) return 0;
+#ifdef HEAP_SAVE_POINTER /* <!-- pointer */
+	for(i = 0; i < n; i++) {
+		if(fread(&buffer[i].priority, sizeof buffer[i].priority, 1, fp) != 1
+			|| !PH_(load_value)(fp, &buffer[i].value)) goto catch;
+		hash = PH_(checksum)(hash, &buffer[i].priority,
+			sizeof buffer[i].priority);
+	}
+#else /* pointer --><!-- !pointer */
+	if(n && fread(buffer, sizeof *buffer, n, fp) != n) goto catch;
+	hash = PH_(checksum)(hash, buffer, sizeof *buffer * n);
+#endif /* !pointer --> */
+	if(hash != header[4]) return errno = EDOM, 0;
+	if(!PH_(node_array_append)(&heap->a, n)) { assert(0); return 0; }
+	PH_(grown)(heap, capacity), PH_(trace_n)(heap, 'n', n, buffer);
+	PH_(persist)(heap), PH_(journal)(heap, 'n', n, buffer);
+	return 1;
+catch:
+	if(!errno) errno = EDOM;
+	return 0;
+}
+#ifdef HEAP_SAVE_POINTER
+#undef HEAP_SAVE_POINTER
+#endif
+#endif /* save --> */
+
+#ifdef HEAP_STATIC_CAPACITY /* <!-- static */
+/** Copies `node` into `heap`; if it is full, the lowest priority according to
+ `HEAP_COMPARE` of `heap` and `node` is evicted. Never allocates.
+ @param[evicted] If non-null, gets a copy of the node that was evicted.
+ @return Whether a node was evicted; it may be `node` itself.
+ @order \O(`HEAP_STATIC_CAPACITY`) when full, otherwise \O(log `size`).
+ @allow */
+static int H_(heap_add_evict)(struct H_(heap) *const heap, PH_(node) node,
+	PH_(node) *const evicted) {
+	PH_(node) *const n0 = PH_(nodes)(heap), *worst, *n, *n_end;
+	assert(heap);
+	if(heap->a.size < HEAP_STATIC_CAPACITY) {
+		if(!H_(heap_add)(heap, node)) assert(0);
+		return 0;
+	}
+	PH_(trace)(heap, 'e', &node), PH_(journal)(heap, 'e', 1, &node);
+	/* The lowest priority is one of the leaves. */
+	for(n = worst = n0 + (heap->a.size >> 1), n_end = n0 + heap->a.size;
+		++n < n_end; )
+		if(PH_(order)(heap, PH_(get_priority)(n), PH_(get_priority)(worst)) > 0)
+		worst = n;
+	if(PH_(order)(heap, PH_(get_priority)(worst), PH_(get_priority)(&node))
+		<= 0)
+		{ if(evicted) *evicted = node; return 1; }
+	if(evicted) *evicted = *worst;
+	PH_(sift_up_i)(heap, (size_t)(worst - n0), &node);
+	return 1;
+}
+#endif /* static --> */
+
+#ifdef HEAP_JOURNAL /* <!-- journal */
+/** Starts a write-ahead log of every change to `heap` in `fp`, a binary
+ stream open for writing at the start of an empty file. It starts from the
+ state `heap` is in now, which must be empty or the snapshot from
+ <fn:<H>heap_checkpoint>. The changes are committed with one `fdatasync`
+ every `interval` calls, (never if zero,) and at <fn:<H>heap_commit>. If `fp`
+ is null, it commits and stops. Streams are not closed.
+ @return Success. @throws[fwrite, fflush, fdatasync] @allow */
+static int H_(heap_journal)(struct H_(heap) *const heap, FILE *const fp,
+	const size_t interval) {
+	struct H_(heap_journal) *const j = (assert(heap), &heap->journal);
+	unsigned long base[2];
+	int is_ok = PH_(journal_commit)(heap);
+	if(!is_ok) errno = j->error;
+	j->fp = 0, j->hash = 2166136261ul, j->interval = interval, j->pending = 0;
+	j->error = 0;
+	if(!fp) return is_ok;
+	base[0] = (unsigned long)heap->a.size, base[1] = PH_(save_hash)(heap);
+	if(fwrite("HWL1", 1, 4, fp) != 4 || fwrite(base, sizeof base, 1, fp) != 1
+		|| !PH_(journal_sync)(fp)) { if(!errno) errno = ERANGE; return 0; }
+	j->fp = fp;
+	return is_ok;
+}
+
+/** Commits the changes to `heap` since the last commit to its journal, if
+ any, and waits for them to be on the disk.
+ @return The journal has not failed since <fn:<H>heap_journal>.
+ @throws[fwrite, fflush, fdatasync] @allow */
+static int H_(heap_commit)(struct H_(heap) *const heap) {
 	assert(heap);
-	PH_(node_array_append)(&heap->a, n);
-	if(n) PH_(heapify)(heap);
+	if(PH_(journal_commit)(heap)) return 1;
+	errno = heap->journal.error;
+	return 0;
+}
+
+/** Compacts the journal of `heap`: it commits, saves a snapshot to `path`
+ with `.new` after it, waits for the disk, ends the journal, if any, with a
+ record of the snapshot, renames it to `path` and waits for the directory, then
+ starts over the journal from the start. If it stops at any point,
+ <fn:<H>heap_recover> sees the old snapshot and the whole journal, or the new
+ snapshot and a journal that it ends, which is started over. This is
+ synchronous.
+ @return Success. @throws[malloc, fopen, fwrite, fflush, fdatasync, rename,
+ open, fsync, ftruncate] @order \O(`size`) @allow */
+static int H_(heap_checkpoint)(struct H_(heap) *const heap,
+	const char *const path) {
+	FILE *const journal = (assert(heap && path), heap->journal.fp), *fp = 0;
+	const size_t length = strlen(path);
+	unsigned long base[2];
+	char *temp = 0;
+	int is_ok = 0;
+	if(!H_(heap_commit)(heap)) return 0;
+	if(!(temp = malloc(length + sizeof ".new"))) goto finally;
+	memcpy(temp, path, length), memcpy(temp + length, ".new", sizeof ".new");
+	if(!(fp = fopen(temp, "wb")) || !H_(heap_save)(heap, fp)
+		|| !PH_(journal_sync)(fp)) goto finally;
+	if(fclose(fp)) { fp = 0; goto finally; }
+	fp = 0;
+	/* Ends the journal with the snapshot that replaces it; not committed, so
+	 the old snapshot ignores it. */
+	if(journal) {
+		base[0] = (unsigned long)heap->a.size, base[1] = PH_(save_hash)(heap);
+		PH_(journal_write)(heap, "S", 1);
+		PH_(journal_write)(heap, base, sizeof base);
+		if(heap->journal.error) { errno = heap->journal.error; goto finally; }
+		if(!PH_(journal_sync)(journal)) goto finally;
+	}
+	if(rename(temp, path) || !PH_(journal_sync_dir)(path)) goto finally;
+	if(journal && (fseek(journal, 0, SEEK_SET) || ftruncate(fileno(journal), 0)
+		|| !H_(heap_journal)(heap, journal, heap->journal.interval)))
+		goto finally;
+	is_ok = 1;
+finally:
+	if(!is_ok) {
+		const int e = errno ? errno : ERANGE;
+		if(fp) fclose(fp);
+		if(temp) remove(temp);
+		errno = e;
+	}
+	free(temp);
+	return is_ok;
+}
+
+/** Replaces the contents of `heap` with the latest snapshot from
+ <fn:<H>heap_checkpoint> in `snapshot`, or empty if null, and replays the
+ batches that were committed to `journal` after it. The tail of `journal` that
+ was not committed is cut off, and `heap` journals to it from there with a
+ commit every `interval` calls. A journal that was never started is started.
+ One that starts from another snapshot is only started over if it ends with a
+ record of this one, as <fn:<H>heap_checkpoint> leaves it; otherwise, it is
+ untouched.
+ @param[journal] A binary stream open for reading and writing, (`r+b`.)
+ @return Success; otherwise, `heap` is not journaled.
+ @throws[EDOM] `journal` is not a journal, it is from another snapshot, or the
+ snapshot is corrupt.
+ @throws[fread, fseek, ftruncate, realloc, ERANGE]
+ @order \O(`size` + calls in `journal`) @allow */
+static int H_(heap_recover)(struct H_(heap) *const heap, FILE *const snapshot,
+	FILE *const journal, const size_t interval) {
+	struct H_(heap_journal) *const j = (assert(heap && journal),
+		&heap->journal);
+	unsigned long base[2], snap[2], hash = 2166136261ul, commit_hash = hash,
+		stored;
+	char magic[4], op;
+	PH_(node) chunk[64], *buffer;
+	size_t got, n, m;
+	long start, end;
+	int c;
+	H_(heap_journal)(heap, 0, 0);
+	if(snapshot) { if(!H_(heap_load)(heap, snapshot)) return 0; }
+	else H_(heap_clear)(heap);
+	snap[0] = (unsigned long)heap->a.size, snap[1] = PH_(save_hash)(heap);
+	/* A journal that was never started, or is not from this snapshot. */
+	if((got = fread(magic, 1, sizeof magic, journal)) != sizeof magic
+		|| fread(base, sizeof base, 1, journal) != 1
+		|| memcmp(base, snap, sizeof base)) {
+		if(ferror(journal)) goto catch;
+		if(got == sizeof magic && memcmp(magic, "HWL1", sizeof magic))
+			return errno = EDOM, 0;
+		/* A whole header: only one that this snapshot ends is older. */
+		if(!feof(journal) && (fseek(journal, -(long)(1 + sizeof base),
+			SEEK_END) || fgetc(journal) != 'S'
+			|| fread(base, sizeof base, 1, journal) != 1
+			|| memcmp(base, snap, sizeof base))) return errno = EDOM, 0;
+		if(fseek(journal, 0, SEEK_SET) || ftruncate(fileno(journal), 0))
+			goto catch;
+		return H_(heap_journal)(heap, journal, interval);
+	}
+	/* Find the last commit that has the checksum of everything before it. */
+	if((start = end = ftell(journal)) < 0) goto catch;
+	while((c = fgetc(journal)) != EOF) {
+		op = (char)c, hash = PH_(checksum)(hash, &op, 1);
+		switch(op) {
+		case 'a': case 'r': n = 1; break;
+#ifdef HEAP_STATIC_CAPACITY
+		case 'e': n = 1; break;
+#endif
+		case 'p': case 'c': n = 0; break;
+		case 'n':
+			if(fread(&n, sizeof n, 1, journal) != 1) goto scanned;
+			hash = PH_(checksum)(hash, &n, sizeof n);
+			break;
+		case 'C':
+			if(fread(&stored, sizeof stored, 1, journal) != 1
+				|| stored != hash || (end = ftell(journal)) < 0) goto scanned;
+			commit_hash = hash;
+			continue;
+		case 'S':
+			if(fread(base, sizeof base, 1, journal) != 1) goto scanned;
+			hash = PH_(checksum)(hash, base, sizeof base);
+			continue;
+		default: goto scanned;
+		}
+		for( ; n; n -= m) {
+			m = n < sizeof chunk / sizeof *chunk ? n
+				: sizeof chunk / sizeof *chunk;
+			if(fread(chunk, sizeof *chunk, m, journal) != m) goto scanned;
+			hash = PH_(checksum)(hash, chunk, sizeof *chunk * m);
+		}
+	}
+scanned:
+	/* Replay up to it. */
+	if(ferror(journal) || fseek(journal, start, SEEK_SET)) goto catch;
+	while(ftell(journal) < end) {
+		switch(fgetc(journal)) {
+		case 'a':
+			if(fread(chunk, sizeof *chunk, 1, journal) != 1
+				|| !H_(heap_add)(heap, *chunk)) goto catch;
+			break;
+		case 'r':
+			if(fread(chunk, sizeof *chunk, 1, journal) != 1) goto catch;
+			H_(heap_replace)(heap, *chunk);
+			break;
+#ifdef HEAP_STATIC_CAPACITY
+		case 'e':
+			if(fread(chunk, sizeof *chunk, 1, journal) != 1) goto catch;
+			H_(heap_add_evict)(heap, *chunk, 0);
+			break;
+#endif
+		case 'p': H_(heap_pop)(heap); break;
+		case 'c': H_(heap_clear)(heap); break;
+		case 'n':
+			if(fread(&n, sizeof n, 1, journal) != 1
+				|| (!(buffer = H_(heap_buffer)(heap, n)) && n)
+				|| fread(buffer, sizeof *buffer, n, journal) != n
+				|| !H_(heap_append)(heap, n)) goto catch;
+			break;
+		case 'C':
+			if(fread(&stored, sizeof stored, 1, journal) != 1) goto catch;
+			break;
+		case 'S':
+			if(fread(base, sizeof base, 1, journal) != 1) goto catch;
+			break;
+		default: goto catch;
+		}
+	}
+	/* Cut off the rest and journal from there. */
+	if(fseek(journal, end, SEEK_SET) || fflush(journal)
+		|| ftruncate(fileno(journal), (off_t)end)) goto catch;
+	j->fp = journal, j->hash = commit_hash, j->interval = interval;
 	return 1;
+catch:
+	if(!errno) errno = EDOM;
+	return 0;
 }
+#endif /* journal --> */
 
 /* <!-- iterate interface */
 #define BOX_ITERATE
@@ -366,8 +1394,30 @@ static const char *(*PH_(heap_to_string))(const struct H_(heap) *);
 
 static void PH_(unused_base_coda)(void);
 static void PH_(unused_base)(void) {
+	PH_(node) unused;
+	memset(&unused, 0, sizeof unused);
 	H_(heap)(0); H_(heap_)(0); H_(heap_clear)(0); H_(heap_peek_value)(0);
 	H_(heap_pop)(0); H_(heap_buffer)(0, 0); H_(heap_append)(0, 0);
+	H_(heap_replace)(0, unused); H_(heap_drain)(0, 0); (void)H_(heap_idle);
+#ifdef HEAP_STATIC_CAPACITY
+	H_(heap_add_evict)(0, unused, 0);
+#endif
+#ifdef HEAP_STATS
+	H_(heap_stats)(0); H_(heap_stats_reset)(0);
+#endif
+#ifdef HEAP_TRACE
+	H_(heap_trace)(0, 0);
+#endif
+#ifdef HEAP_SAVE
+	H_(heap_save)(0, 0); H_(heap_load)(0, 0);
+#endif
+#ifdef HEAP_FILE
+	H_(heap_open)(0, 0); H_(heap_sync)(0);
+#endif
+#ifdef HEAP_JOURNAL
+	H_(heap_journal)(0, 0, 0); H_(heap_commit)(0); H_(heap_checkpoint)(0, 0);
+	H_(heap_recover)(0, 0, 0, 0);
+#endif
 	PH_(begin)(0, 0); PH_(next)(0); PH_(unused_base_coda)();
 }
 static void PH_(unused_base_coda)(void) { PH_(unused_base)(); }
@@ -424,9 +1474,55 @@ static void PH_(unused_to_string_coda)(void) { PH_(unused_to_string)(); }
 #ifdef HEAP_VALUE
 #undef HEAP_VALUE
 #endif
+#ifdef HEAP_HANDLE
+#undef HEAP_HANDLE
+#endif
+#ifdef HEAP_STATS
+#undef HEAP_STATS
+#endif
+#ifdef HEAP_TRACE
+#undef HEAP_TRACE
+#endif
+#ifdef HEAP_SAVE
+#undef HEAP_SAVE
+#undef HEAP_SAVE_ID
+#endif
+#ifdef HEAP_FILE
+#undef HEAP_FILE
+#endif
+#ifdef HEAP_JOURNAL
+#undef HEAP_JOURNAL
+#endif
+#ifdef HEAP_THREADS
+#undef HEAP_THREADS
+#endif
+#ifdef HEAP_SAVE_VALUE
+#undef HEAP_SAVE_VALUE
+#endif
+#ifdef HEAP_LOAD_VALUE
+#undef HEAP_LOAD_VALUE
+#endif
 #ifdef HEAP_TEST
 #undef HEAP_TEST
 #endif
+#ifdef HEAP_ALLOC
+#undef HEAP_ALLOC
+#endif
+#ifdef HEAP_REALLOC
+#undef HEAP_REALLOC
+#endif
+#ifdef HEAP_FREE
+#undef HEAP_FREE
+#endif
+#ifdef HEAP_ALLOC_CONTEXT
+#undef HEAP_ALLOC_CONTEXT
+#endif
+#ifdef HEAP_INLINE_CAPACITY
+#undef HEAP_INLINE_CAPACITY
+#endif
+#ifdef HEAP_STATIC_CAPACITY
+#undef HEAP_STATIC_CAPACITY
+#endif
 #undef BOX_
 #undef BOX_CONTAINER
 #undef BOX_CONTENTS
@@ -0,0 +1,124 @@
+/** @license 2021 Neil Edelman, distributed under the terms of the
+ [MIT License](https://opensource.org/licenses/MIT).
+
+ @subtitle Ordered Keys
+
+ Encoders that map priorities order-preservingly onto one unsigned 64-bit
+ <typedef:key_u64>, so that `HEAP_TYPE key_u64` in <heap.h> works with the
+ default `a > b` instead of a `HEAP_COMPARE` for each type. A comparison is
+ then one integer instruction, and needs no branches on the sign or the kind of
+ number.
+
+ <fn:key_double> and <fn:key_float> flip the sign bit of positive numbers and
+ all the bits of negative ones, so IEEE 754 numbers compare as unsigned
+ integers; `-0` is the same as `+0`, and a `NaN` goes past the infinity with
+ its sign. <fn:key_long> biases the sign. <fn:key_pack> puts two keys side by
+ side for a lexicographic tuple, such as a priority and a sequence number to
+ break ties; <fn:key_truncate> keeps the most significant bits of a key to make
+ room, which still preserves order, but not strictly. <fn:key_reverse> turns a
+ minimum-heap into a maximum-heap. Each has an inverse.
+
+ @std C89; if `unsigned long` is narrower than 64 bits, C99 `uint64_t` */
+
+#ifndef KEY_H /* <!-- idempotent */
+#define KEY_H
+
+#include <string.h> /* memcpy */
+#include <assert.h> /* assert */
+#include <limits.h> /* ULONG_MAX */
+
+#if ULONG_MAX >> 31 >> 31 >> 1 /* <!-- long */
+/** Unsigned integer of 64 bits. */
+typedef unsigned long key_u64;
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L /* long --><!-- c99 */
+#include <stdint.h> /* uint64_t */
+typedef uint64_t key_u64;
+#else /* c99 --><!-- none */
+#error No 64-bit unsigned integer; try C99.
+#endif /* none --> */
+
+#define KEY_SIGN ((key_u64)1 << 63)
+
+/** @return A key of `x` that compares as `x` does. */
+static key_u64 key_double(const double x) {
+	key_u64 bits;
+	assert(sizeof x == sizeof bits);
+	memcpy(&bits, &x, sizeof bits);
+	if(!(bits << 1)) return KEY_SIGN; /* `-0 == +0`. */
+	return bits & KEY_SIGN ? ~bits : bits | KEY_SIGN;
+}
+
+/** @return The number that <fn:key_double> encoded in `key`. */
+static double key_to_double(const key_u64 key) {
+	const key_u64 bits = key & KEY_SIGN ? key & ~KEY_SIGN : ~key;
+	double x;
+	memcpy(&x, &bits, sizeof x);
+	return x;
+}
+
+/** @return A key of `x` that compares as `x` does, in the low 32 bits. */
+static key_u64 key_float(const float x) {
+	unsigned bits;
+	assert(sizeof x == sizeof bits && sizeof bits == 4);
+	memcpy(&bits, &x, sizeof bits);
+	if(!(bits & 0x7fffffffu)) return 0x80000000u;
+	return bits & 0x80000000u ? ~bits & 0xffffffffu : bits | 0x80000000u;
+}
+
+/** @return The number that <fn:key_float> encoded in `key`. */
+static float key_to_float(const key_u64 key) {
+	const unsigned bits = (unsigned)(key & 0x80000000u
+		? key & 0x7fffffffu : ~key & 0xffffffffu);
+	float x;
+	memcpy(&x, &bits, sizeof x);
+	return x;
+}
+
+/** @return A key of `x` that compares as `x` does. */
+static key_u64 key_long(const long x) { return (key_u64)x ^ KEY_SIGN; }
+
+/** @return The number that <fn:key_long> encoded in `key`, which must be in
+ range. */
+static long key_to_long(const key_u64 key) {
+	/* Converting an unsigned out of range is implementation-defined. */
+	return key & KEY_SIGN ? (long)(key & ~KEY_SIGN)
+		: -(long)(KEY_SIGN - 1 - key) - 1;
+}
+
+/** @return The most significant `64 - bits` of `key` in the low bits; if `a`
+ compares less than `b`, the results compare less or equal. */
+static key_u64 key_truncate(const key_u64 key, const unsigned bits)
+	{ assert(bits < 64); return key >> bits; }
+
+/** @param[high] Compares first; must be less than `2^(64 - bits)`, (see
+ <fn:key_truncate>.)
+ @param[low] Compares if `high` is equal; must be less than `2^bits`.
+ @return A key that compares lexicographically as `(high, low)`. */
+static key_u64 key_pack(const key_u64 high, const key_u64 low,
+	const unsigned bits) {
+	assert(bits && bits < 64 && !(high >> (63 - bits) >> 1)
+		&& !(low >> (bits - 1) >> 1));
+	return high << bits | low;
+}
+
+/** @return The `high` of <fn:key_pack> with `bits` in `key`. */
+static key_u64 key_high(const key_u64 key, const unsigned bits)
+	{ assert(bits && bits < 64); return key >> bits; }
+
+/** @return The `low` of <fn:key_pack> with `bits` in `key`. */
+static key_u64 key_low(const key_u64 key, const unsigned bits)
+	{ assert(bits && bits < 64); return key & (((key_u64)1 << bits) - 1); }
+
+/** @return A key that compares opposite to `key`; it is its own inverse. */
+static key_u64 key_reverse(const key_u64 key) { return ~key; }
+
+static void key_unused_coda(void);
+static void key_unused(void) {
+	key_double(0); key_to_double(0); key_float(0); key_to_float(0);
+	key_long(0); key_to_long(0); key_truncate(0, 0); key_pack(0, 0, 0);
+	key_high(0, 0); key_low(0, 0); key_reverse(0);
+	key_unused_coda();
+}
+static void key_unused_coda(void) { key_unused(); }
+
+#endif /* idempotent --> */
@@ -0,0 +1,319 @@
+/** @license 2020 Neil Edelman, distributed under the terms of the
+ [MIT License](https://opensource.org/licenses/MIT).
+
+ @subtitle Replacement Selection
+
+ Generates sorted runs for an external sort with replacement selection,
+ <Knuth, 1973, Sorting, p. 254>. A <tag:<R>selection_heap> of `memory` records
+ is tagged with a run number; the lowest is written to its run and replaced
+ by the next record from the input, which goes to the next run if it is lower
+ than the one just written. On random input, runs are about twice `memory`,
+ and on nearly sorted input, there is one run. <fn:<R>selection_merge> is the
+ companion multi-way merge. Records are read and written through callbacks,
+ and there are callbacks for `FILE`. One needs to have <heap.h> and <array.h>
+ in the same directory.
+
+ @param[SELECTION_NAME, SELECTION_TYPE]
+ `<R>` that satisfies `C` naming conventions when mangled and an assignable
+ record type <typedef:<PR>record> associated therewith. `SELECTION_NAME` is
+ required but `SELECTION_TYPE` defaults to `unsigned int` if not specified.
+ `<PR>` is private, whose names are prefixed in a manner to avoid collisions.
+
+ @param[SELECTION_COMPARE]
+ A function satisfying <typedef:<PR>compare_fn>; the same contract as
+ `HEAP_COMPARE`. Defaults to ascending order on `SELECTION_TYPE`; as such,
+ required if `SELECTION_TYPE` is changed to an incomparable type.
+
+ @param[SELECTION_TEST]
+ Unit testing framework <../test/test_selection.h>, using `assert`. Must be
+ defined equal to a random filler function, satisfying
+ `void (*<PR>biaction_fn)(<PR>record *, void *)` with the `param` of
+ <fn:<R>selection_test>.
+
+ @depend [heap](https://github.com/neil-edelman/heap)
+ @std C89 */
+
+#include <stdlib.h> /* malloc free */
+#include <stdio.h>  /* FILE fopen fread fwrite sprintf FILENAME_MAX */
+#include <string.h> /* strlen */
+#include <assert.h> /* assert */
+#include <errno.h>  /* errno */
+
+
+#ifndef SELECTION_H /* <!-- idempotent */
+#define SELECTION_H
+/** Output to files named `dir/run-<n>.bin` in order of run for
+ <fn:<R>selection_file_write>. Start with `{ dir, 0, 0 }`, and finish with
+ <fn:selection_files_close>. */
+struct selection_files { const char *dir; FILE *fp; size_t run; };
+
+/** Puts the name of `run` in `files` in `name`. @return Success.
+ @throws[ERANGE] The name is too long. */
+static int selection_files_name(const struct selection_files *const files,
+	const size_t run, char (*const name)[FILENAME_MAX]) {
+	/* "/" "run-" 20 ".bin" "\0" */
+	assert(files && files->dir && name);
+	if(strlen(files->dir) > FILENAME_MAX - (1 + 4 + 20 + 4 + 1))
+		return errno = ERANGE, 0;
+	sprintf(*name, "%s/run-%lu.bin", files->dir, (unsigned long)run);
+	return 1;
+}
+
+/** Opens `run` of `files` with `mode`. @return The file or null.
+ @throws[fopen, ERANGE] */
+static FILE *selection_files_open(const struct selection_files *const files,
+	const size_t run, const char *const mode) {
+	char name[FILENAME_MAX];
+	return selection_files_name(files, run, &name) ? fopen(name, mode) : 0;
+}
+
+/** Closes the current run of `files`. @return Success. @throws[fclose] */
+static int selection_files_close(struct selection_files *const files) {
+	int success = 1;
+	assert(files);
+	if(files->fp) success = !fclose(files->fp), files->fp = 0;
+	return success;
+}
+
+/** Removes the first `runs` files of `files`. */
+static void selection_files_remove(const struct selection_files *const files,
+	const size_t runs) {
+	char name[FILENAME_MAX];
+	size_t run;
+	for(run = 0; run < runs; run++)
+		if(selection_files_name(files, run, &name)) remove(name);
+}
+
+static void selection_unused_coda(void);
+static void selection_unused(void) {
+	selection_files_open(0, 0, 0); selection_files_close(0);
+	selection_files_remove(0, 0); selection_unused_coda();
+}
+static void selection_unused_coda(void) { selection_unused(); }
+#endif /* idempotent --> */
+
+
+#ifndef SELECTION_NAME
+#error Generic SELECTION_NAME undefined.
+#endif
+/* <Kernighan and Ritchie, 1988, p. 231>. */
+#if defined(R_) || defined(PR_) \
+	|| (defined(SELECTION_SUBTYPE) ^ (defined(CAT) || defined(CAT_)))
+#error Unexpected P?R_ or CAT_?; possible stray SELECTION_SUBTYPE?
+#endif
+#ifndef SELECTION_SUBTYPE /* <!-- !sub-type */
+#define CAT_(x, y) x ## _ ## y
+#define CAT(x, y) CAT_(x, y)
+#endif /* !sub-type --> */
+#define R_(n) CAT(SELECTION_NAME, n)
+#define PR_(n) CAT(selection, R_(n))
+#ifndef SELECTION_TYPE
+#define SELECTION_TYPE unsigned
+#endif
+
+/** Valid assignable type of the records. Defaults to `unsigned int` if not
+ set by `SELECTION_TYPE`. */
+typedef SELECTION_TYPE PR_(record);
+
+/** Returns a positive result if `a` comes after `b`; see `HEAP_COMPARE`. */
+typedef int (*PR_(compare_fn))(const PR_(record) a, const PR_(record) b);
+#ifndef SELECTION_COMPARE /* <!-- !cmp */
+/** Pre-order with `a` and `b`. @implements <typedef:<PR>compare_fn> */
+static int PR_(default_compare)(const PR_(record) a, const PR_(record) b)
+	{ return a > b; }
+#define SELECTION_COMPARE &PR_(default_compare)
+#endif /* !cmp --> */
+static const PR_(compare_fn) PR_(compare) = (SELECTION_COMPARE);
+
+/** Reads the next record from `source` into `record`.
+ @return Whether a record was read. If it was not, and `errno` is set, it is
+ an error, otherwise it is the end. */
+typedef int (*PR_(read_fn))(void *source, PR_(record) *record);
+
+/** Writes `record` to the end of `run` of `sink`. Runs start at zero, and
+ they are written in order. @return Success; otherwise `errno` is set. */
+typedef int (*PR_(write_fn))(void *sink, size_t run, const PR_(record) *record);
+
+/** A record tagged with the number of the run it is in. */
+struct PR_(tagged) { size_t run; PR_(record) record; };
+
+/** Orders `a` and `b` by run, then record.
+ @implements <typedef:<PH>compare_fn> */
+static int PR_(tagged_compare)(const struct PR_(tagged) a,
+	const struct PR_(tagged) b) {
+	return a.run != b.run ? a.run > b.run : PR_(compare)(a.record, b.record);
+}
+
+/* The selection heap; this relies on `heap.h` in the same directory. */
+#define HEAP_NAME R_(selection)
+#define HEAP_TYPE struct PR_(tagged)
+#define HEAP_COMPARE &PR_(tagged_compare)
+#define HEAP_SUBTYPE
+#include "heap.h"
+
+/* The multi-way merge; the value is the source of the record. */
+#define HEAP_NAME PR_(merge)
+#define HEAP_TYPE PR_(record)
+#define HEAP_COMPARE SELECTION_COMPARE
+#define HEAP_VALUE void *
+#define HEAP_SUBTYPE
+#include "heap.h"
+
+/** Reads all of `read` with `source` and writes sorted runs to `write` with
+ `sink`, using replacement selection.
+ @param[memory] The number of records in the heap, at least one.
+ @param[runs] If non-null, the number of runs written on success.
+ @return Success. @throws[ERANGE, realloc] @throws[read, write]
+ @order \O(`records` log `memory`) @allow */
+static int R_(selection_runs)(const size_t memory, const PR_(read_fn) read,
+	void *const source, const PR_(write_fn) write, void *const sink,
+	size_t *const runs) {
+	struct R_(selection_heap) heap = HEAP_IDLE;
+	struct PR_(tagged) next, *top, *buffer;
+	PR_(record) last;
+	size_t i, run = 0;
+	int is_written = 0, success = 0;
+	const int e = errno;
+	assert(read && write);
+	if(!memory) { errno = ERANGE; goto catch; }
+	if(!(buffer = R_(selection_heap_buffer)(&heap, memory))) goto catch;
+	errno = 0;
+	for(i = 0; i < memory && read(source, &buffer[i].record); i++)
+		buffer[i].run = 0;
+	if(errno) goto catch;
+	R_(selection_heap_append)(&heap, i);
+	while((top = R_(selection_heap_peek)(&heap))) {
+		run = top->run, last = top->record, is_written = 1;
+		if(!write(sink, run, &last)) { if(!errno) errno = ERANGE; goto catch; }
+		if(read(source, &next.record)) {
+			/* Smaller than the one just written has to wait. */
+			next.run = PR_(compare)(last, next.record) > 0 ? run + 1 : run;
+			R_(selection_heap_replace)(&heap, next);
+		} else {
+			if(errno) goto catch;
+			R_(selection_heap_pop)(&heap);
+		}
+	}
+	if(runs) *runs = is_written ? run + 1 : 0;
+	success = 1, errno = e;
+catch:
+	R_(selection_heap_)(&heap);
+	return success;
+}
+
+/** Merges the sorted `sources`, each read with `read`, into run zero of
+ `write` with `sink`.
+ @return Success. @throws[ERANGE, realloc] @throws[read, write]
+ @order \O(`records` log `sources_size`) @allow */
+static int R_(selection_merge)(const PR_(read_fn) read, void **const sources,
+	const size_t sources_size, const PR_(write_fn) write, void *const sink) {
+	struct PR_(merge_heap) heap = HEAP_IDLE;
+	struct PR_(merge_heap_node) next, *top;
+	size_t i;
+	int success = 0;
+	const int e = errno;
+	assert(read && (sources || !sources_size) && write);
+	if(sources_size && !PR_(merge_heap_buffer)(&heap, sources_size))
+		goto catch;
+	errno = 0;
+	for(i = 0; i < sources_size; i++) {
+		if(!read(sources[i], &next.priority)) { if(errno) goto catch; continue; }
+		next.value = sources + i;
+		if(!PR_(merge_heap_add)(&heap, next)) assert(0);
+	}
+	while((top = PR_(merge_heap_peek)(&heap))) {
+		if(!write(sink, 0, &top->priority))
+			{ if(!errno) errno = ERANGE; goto catch; }
+		next.value = top->value;
+		if(read(*next.value, &next.priority)) {
+			PR_(merge_heap_replace)(&heap, next);
+		} else {
+			if(errno) goto catch;
+			PR_(merge_heap_pop)(&heap);
+		}
+	}
+	success = 1, errno = e;
+catch:
+	PR_(merge_heap_)(&heap);
+	return success;
+}
+
+/** Reads one record from the `FILE` `source` into `record`.
+ @implements <typedef:<PR>read_fn> @allow */
+static int R_(selection_file_read)(void *const source,
+	PR_(record) *const record) {
+	FILE *const fp = source;
+	assert(fp && record);
+	if(fread(record, sizeof *record, 1, fp) == 1) return 1;
+	if(ferror(fp) && !errno) errno = ERANGE;
+	return 0;
+}
+
+/** Writes `record` to the `FILE` `sink`, ignoring `run`.
+ @implements <typedef:<PR>write_fn> @allow */
+static int R_(selection_file_append)(void *const sink, const size_t run,
+	const PR_(record) *const record) {
+	FILE *const fp = sink;
+	(void)run;
+	assert(fp && record);
+	return fwrite(record, sizeof *record, 1, fp) == 1;
+}
+
+/** Writes `record` to `run` of `sink`, a <tag:selection_files>, opening the
+ file of `run` if it is new. @implements <typedef:<PR>write_fn> @allow */
+static int R_(selection_file_write)(void *const sink, const size_t run,
+	const PR_(record) *const record) {
+	struct selection_files *const files = sink;
+	assert(files && record);
+	if(!files->fp || files->run != run) {
+		if(!selection_files_close(files)
+			|| !(files->fp = selection_files_open(files, run, "wb"))) return 0;
+		files->run = run;
+	}
+	return fwrite(record, sizeof *record, 1, files->fp) == 1;
+}
+
+/** Merges the first `runs` of `files` into `out`.
+ @return Success. @throws[fopen, malloc, fread, fwrite, ERANGE] @allow */
+static int R_(selection_merge_files)(const struct selection_files *const files,
+	const size_t runs, FILE *const out) {
+	void **sources;
+	size_t i;
+	int success = 0;
+	assert(files && out);
+	if(!runs) return 1;
+	if(!(sources = malloc(sizeof *sources * runs))) return 0;
+	for(i = 0; i < runs; i++)
+		if(!(sources[i] = selection_files_open(files, i, "rb"))) break;
+	if(i == runs) success = R_(selection_merge)(&R_(selection_file_read),
+		sources, runs, &R_(selection_file_append), out);
+	while(i) fclose(sources[--i]);
+	free(sources);
+	return success;
+}
+
+#ifdef SELECTION_TEST /* <!-- test */
+#include "../test/test_selection.h" /** \include */
+#endif /* test --> */
+
+static void PR_(unused_base_coda)(void);
+static void PR_(unused_base)(void) {
+	R_(selection_runs)(0, 0, 0, 0, 0, 0); R_(selection_file_write)(0, 0, 0);
+	R_(selection_merge_files)(0, 0, 0); PR_(unused_base_coda)();
+}
+static void PR_(unused_base_coda)(void) { PR_(unused_base)(); }
+
+#ifndef SELECTION_SUBTYPE /* <!-- !sub-type */
+#undef CAT
+#undef CAT_
+#else /* !sub-type --><!-- sub-type */
+#undef SELECTION_SUBTYPE
+#endif /* sub-type --> */
+#undef R_
+#undef PR_
+#undef SELECTION_NAME
+#undef SELECTION_TYPE
+#undef SELECTION_COMPARE
+#ifdef SELECTION_TEST
+#undef SELECTION_TEST
+#endif
@@ -0,0 +1,363 @@
+/** @license 2020 Neil Edelman, distributed under the terms of the
+ [MIT License](https://opensource.org/licenses/MIT).
+
+ @subtitle Sequence Heap
+
+ A <tag:<S>sequence> is a priority queue for very many items, after
+ <Sanders, 2000, Fast>. Additions go to a small insertion
+ <tag:<S>sequence_heap>; when that is full, it is sorted into a run. Runs are
+ kept in groups, and when a group has `SEQUENCE_ARITY` runs, they are merged
+ into one run of the next group. The smallest items of all the runs are kept,
+ sorted, in a deletion buffer that is refilled by a multi-way merge, at most
+ `SEQUENCE_BUFFER` at a time. Almost all access to the runs is sequential, so
+ it makes better use of the cache than a binary heap when the size is much
+ greater than the cache. One needs to have <heap.h> and <array.h> in the same
+ directory.
+
+ @param[SEQUENCE_NAME, SEQUENCE_TYPE]
+ `<S>` that satisfies `C` naming conventions when mangled and an assignable
+ type <typedef:<PS>priority> associated therewith. `SEQUENCE_NAME` is required
+ but `SEQUENCE_TYPE` defaults to `unsigned int` if not specified. `<PS>` is
+ private, whose names are prefixed in a manner to avoid collisions.
+
+ @param[SEQUENCE_COMPARE]
+ A function satisfying <typedef:<PS>compare_fn>; the same contract as
+ `HEAP_COMPARE`. Defaults to minimum-hash on `SEQUENCE_TYPE`.
+
+ @param[SEQUENCE_VALUE]
+ Optional payload, the same as `HEAP_VALUE`.
+
+ @param[SEQUENCE_INSERT, SEQUENCE_ARITY, SEQUENCE_BUFFER]
+ The maximum size of the insertion heap, which is also the length of the
+ runs in the first group, defaults to 512; the number of runs in a group
+ before they are merged, defaults to 16; and the size of the deletion buffer,
+ defaults to `SEQUENCE_INSERT`. The insertion heap and deletion buffer should
+ together fit in cache.
+
+ @param[SEQUENCE_TEST]
+ Unit testing framework <../test/test_sequence.h>, using `assert`. Must be
+ defined equal to a random filler function, satisfying
+ `void (*<PS>biaction_fn)(<PS>node *, void *)` with the `param` of
+ <fn:<S>sequence_test>.
+
+ @depend [heap](https://github.com/neil-edelman/heap)
+ @std C89 */
+
+
+#ifndef SEQUENCE_NAME
+#error Generic SEQUENCE_NAME undefined.
+#endif
+/* <Kernighan and Ritchie, 1988, p. 231>. */
+#if defined(S_) || defined(PS_) || defined(PSH_) \
+	|| (defined(SEQUENCE_SUBTYPE) ^ (defined(CAT) || defined(CAT_)))
+#error Unexpected P?S_ or CAT_?; possible stray SEQUENCE_SUBTYPE?
+#endif
+#ifndef SEQUENCE_SUBTYPE /* <!-- !sub-type */
+#define CAT_(x, y) x ## _ ## y
+#define CAT(x, y) CAT_(x, y)
+#endif /* !sub-type --> */
+#define S_(n) CAT(SEQUENCE_NAME, n)
+#define PS_(n) CAT(sequence, S_(n))
+/* Private names of the insertion heap, <tag:<S>sequence_heap>. */
+#define PSH_(n) CAT(heap, CAT(S_(sequence), n))
+#ifndef SEQUENCE_TYPE
+#define SEQUENCE_TYPE unsigned
+#endif
+#ifndef SEQUENCE_INSERT
+#define SEQUENCE_INSERT 512
+#endif
+#ifndef SEQUENCE_ARITY
+#define SEQUENCE_ARITY 16
+#endif
+#ifndef SEQUENCE_BUFFER
+#define SEQUENCE_BUFFER SEQUENCE_INSERT
+#endif
+#if SEQUENCE_INSERT < 1 || SEQUENCE_ARITY < 2 || SEQUENCE_BUFFER < 1
+#error SEQUENCE_INSERT, SEQUENCE_ARITY, or SEQUENCE_BUFFER out of range.
+#endif
+
+/** Valid assignable type used for priority. Defaults to `unsigned int` if not
+ set by `SEQUENCE_TYPE`. */
+typedef SEQUENCE_TYPE PS_(priority);
+
+/** Returns a positive result if `a` comes after `b`; see `HEAP_COMPARE`. */
+typedef int (*PS_(compare_fn))(const PS_(priority) a, const PS_(priority) b);
+#ifndef SEQUENCE_COMPARE /* <!-- !cmp */
+/** Pre-order with `a` and `b`. @implements <typedef:<PS>compare_fn> */
+static int PS_(default_compare)(const PS_(priority) a, const PS_(priority) b)
+	{ return a > b; }
+#define SEQUENCE_COMPARE &PS_(default_compare)
+#endif /* !cmp --> */
+static const PS_(compare_fn) PS_(compare) = (SEQUENCE_COMPARE);
+
+/* The insertion heap; this relies on `heap.h` in the same directory. */
+#define HEAP_NAME S_(sequence)
+#define HEAP_TYPE PS_(priority)
+#define HEAP_COMPARE SEQUENCE_COMPARE
+#ifdef SEQUENCE_VALUE
+#define HEAP_VALUE SEQUENCE_VALUE
+#endif
+#define HEAP_SUBTYPE
+#include "heap.h"
+
+/** Internal nodes, the same as in the insertion heap. */
+typedef PSH_(node) PS_(node);
+/** If `SEQUENCE_VALUE` is set, a pointer to it, otherwise a boolean. */
+typedef PSH_(value) PS_(value);
+
+/** A sorted run that is read from `cursor`. */
+struct PS_(run) { struct PSH_(node_array) a; size_t cursor, level; };
+
+#define ARRAY_NAME PS_(run)
+#define ARRAY_TYPE struct PS_(run)
+#define ARRAY_SUBTYPE
+#include "array.h"
+
+/* The multi-way merge of runs; the value is the run of the head. */
+#define HEAP_NAME PS_(merge)
+#define HEAP_TYPE PS_(priority)
+#define HEAP_COMPARE SEQUENCE_COMPARE
+#define HEAP_VALUE struct PS_(run)
+#define HEAP_SUBTYPE
+#include "heap.h"
+
+/** Stores the insertion heap, `insert`, the deletion buffer, `buffer`, and
+ the runs in groups of non-increasing `level`, `runs`. The deletion buffer
+ holds the smallest of all the runs, and is only empty when there are no runs.
+ To initialize it to an idle state, see <fn:<S>sequence>, `SEQUENCE_IDLE`,
+ `{0}` (`C99`), or being `static`. */
+struct S_(sequence);
+struct S_(sequence) {
+	struct S_(sequence_heap) insert;
+	struct PS_(run) buffer;
+	struct PS_(run_array) runs;
+	struct PS_(merge_heap) merge;
+	size_t size;
+};
+#ifndef SEQUENCE_IDLE /* <!-- !zero */
+#define SEQUENCE_IDLE \
+	{ HEAP_IDLE, { ARRAY_IDLE, 0, 0 }, ARRAY_IDLE, HEAP_IDLE, 0 }
+#endif /* !zero --> */
+
+/** @return How many items are left in `run`. */
+static size_t PS_(run_size)(const struct PS_(run) *const run)
+	{ return assert(run && run->cursor <= run->a.size),
+	run->a.size - run->cursor; }
+
+/** Merges, in order, at most `n` items from the runs `[r0, r1)` of `s` onto
+ the back of `out`, which must have a buffer of at least `n`. The merge heap
+ must have a buffer for all the runs.
+ @return The number of items merged. @order \O(`n` log `r1 - r0`) */
+static size_t PS_(merge)(struct S_(sequence) *const s, const size_t r0,
+	const size_t r1, struct PSH_(node_array) *const out, const size_t n) {
+	struct PS_(run) *run, *const run_end = s->runs.data + r1;
+	struct PS_(merge_heap_node) head, *top;
+	PS_(node) *const o = out->data + out->size;
+	size_t moved = 0;
+	assert(s && r0 <= r1 && r1 <= s->runs.size && out
+		&& out->capacity - out->size >= n && s->merge.a.capacity >= r1 - r0);
+	PS_(merge_heap_clear)(&s->merge);
+	for(run = s->runs.data + r0; run < run_end; run++) {
+		if(!PS_(run_size)(run)) continue;
+		head.priority = PSH_(get_priority)(run->a.data + run->cursor);
+		head.value = run;
+		if(!PS_(merge_heap_add)(&s->merge, head)) assert(0);
+	}
+	while(moved < n && (top = PS_(merge_heap_peek)(&s->merge))) {
+		run = top->value;
+		PSH_(copy)(run->a.data + run->cursor++, o + moved++);
+		if(!PS_(run_size)(run)) { PS_(merge_heap_pop)(&s->merge); continue; }
+		head.priority = PSH_(get_priority)(run->a.data + run->cursor);
+		head.value = run;
+		PS_(merge_heap_replace)(&s->merge, head);
+	}
+	out->size += moved;
+	return moved;
+}
+
+/** Refills the empty deletion buffer of `s` from the runs and removes any
+ runs that are exhausted. Does not allocate. */
+static void PS_(refill)(struct S_(sequence) *const s) {
+	struct PS_(run) *r, *w, *r_end;
+	assert(s && !PS_(run_size)(&s->buffer)
+		&& s->buffer.a.capacity >= SEQUENCE_BUFFER);
+	s->buffer.a.size = s->buffer.cursor = 0;
+	PS_(merge)(s, 0, s->runs.size, &s->buffer.a, SEQUENCE_BUFFER);
+	for(w = r = s->runs.data, r_end = r + s->runs.size; r < r_end; r++) {
+		if(PS_(run_size)(r)) { if(w != r) *w = *r; w++; }
+		else PSH_(node_array_)(&r->a);
+	}
+	s->runs.size = (size_t)(w - s->runs.data);
+}
+
+/** Merges any group of `s` that is full into one run of the next group.
+ Failing to allocate is not an error; the group just stays over-full. */
+static void PS_(cascade)(struct S_(sequence) *const s) {
+	size_t level, r0, r, total;
+	struct PS_(run) *run;
+	struct PSH_(node_array) merged;
+	for(level = 0; ; level++) {
+		for(r0 = s->runs.size, total = 0; r0
+			&& s->runs.data[r0 - 1].level == level; r0--)
+			total += PS_(run_size)(s->runs.data + r0 - 1);
+		if(s->runs.size - r0 < SEQUENCE_ARITY) break;
+		PSH_(node_array)(&merged);
+		if(!PSH_(node_array_buffer)(&merged, total)) break;
+		PS_(merge)(s, r0, s->runs.size, &merged, total);
+		assert(merged.size == total);
+		for(r = r0; r < s->runs.size; r++)
+			PSH_(node_array_)(&s->runs.data[r].a);
+		s->runs.size = r0;
+		run = PS_(run_array_new)(&s->runs), assert(run);
+		run->a = merged, run->cursor = 0, run->level = level + 1;
+	}
+}
+
+/** The insertion heap of `s` is full; it is merged with the deletion buffer,
+ the smallest part staying in the buffer and the rest going to a new run.
+ @return Success; on failure, `s` is unchanged. @throws[realloc, ERANGE] */
+static int PS_(spill)(struct S_(sequence) *const s) {
+	const size_t del = PS_(run_size)(&s->buffer),
+		total = s->insert.a.size + del;
+	size_t keep;
+	struct PSH_(node_array) merged;
+	struct PS_(run) *run;
+	PS_(node) *b, *i, *o;
+	assert(s && (del || !s->runs.size));
+	PSH_(node_array)(&merged);
+	if(!PSH_(node_array_reserve)(&s->buffer.a, SEQUENCE_BUFFER)
+		|| !PS_(run_array_buffer)(&s->runs, 1)
+		|| !PS_(merge_heap_buffer)(&s->merge, s->runs.size + 1)
+		|| !PSH_(node_array_buffer)(&merged, total))
+		return PSH_(node_array_)(&merged), 0;
+	/* Two-way merge of the insertion heap and the deletion buffer. */
+	b = s->buffer.a.data + s->buffer.cursor, o = merged.data;
+	while((i = S_(sequence_heap_peek)(&s->insert))) {
+		if(b < s->buffer.a.data + s->buffer.a.size
+			&& PS_(compare)(PSH_(get_priority)(b), PSH_(get_priority)(i)) <= 0)
+			{ PSH_(copy)(b++, o++); continue; }
+		PSH_(copy)(i, o++);
+		S_(sequence_heap_pop)(&s->insert);
+	}
+	while(b < s->buffer.a.data + s->buffer.a.size) PSH_(copy)(b++, o++);
+	merged.size = total;
+	/* The buffer can only keep what it had, unless there are no runs. */
+	keep = s->runs.size ? del : total < SEQUENCE_BUFFER ? total
+		: SEQUENCE_BUFFER;
+	memcpy(s->buffer.a.data, merged.data, sizeof *merged.data * keep);
+	s->buffer.a.size = keep, s->buffer.cursor = 0;
+	if(keep == total) return PSH_(node_array_)(&merged), 1;
+	run = PS_(run_array_new)(&s->runs), assert(run);
+	run->a = merged, run->cursor = keep, run->level = 0;
+	PS_(cascade)(s);
+	return 1;
+}
+
+/** Initializes `s` to be idle. @order \Theta(1) @allow */
+static void S_(sequence)(struct S_(sequence) *const s) {
+	assert(s);
+	S_(sequence_heap)(&s->insert);
+	PSH_(node_array)(&s->buffer.a), s->buffer.cursor = s->buffer.level = 0;
+	PS_(run_array)(&s->runs);
+	PS_(merge_heap)(&s->merge);
+	s->size = 0;
+}
+
+/** Returns `s` to the idle state where it takes no dynamic memory.
+ @order \O(`runs`) @allow */
+static void S_(sequence_)(struct S_(sequence) *const s) {
+	struct PS_(run) *r, *r_end;
+	assert(s);
+	for(r = s->runs.data, r_end = r + s->runs.size; r < r_end; r++)
+		PSH_(node_array_)(&r->a);
+	S_(sequence_heap_)(&s->insert);
+	PSH_(node_array_)(&s->buffer.a);
+	PS_(run_array_)(&s->runs);
+	PS_(merge_heap_)(&s->merge);
+	S_(sequence)(s);
+}
+
+/** @return The number of items in `s`. @order \Theta(1) @allow */
+static size_t S_(sequence_size)(const struct S_(sequence) *const s)
+	{ return assert(s), s->size; }
+
+/** Copies `node` into `s`.
+ @return Success. @throws[ERANGE, realloc]
+ @order amortized \O(log `size`) @allow */
+static int S_(sequence_add)(struct S_(sequence) *const s, PS_(node) node) {
+	assert(s);
+	if(s->insert.a.size >= SEQUENCE_INSERT && !PS_(spill)(s)) return 0;
+	if(!S_(sequence_heap_add)(&s->insert, node)) return 0;
+	return s->size++, 1;
+}
+
+/** @return Lowest in `s` according to `SEQUENCE_COMPARE` or null if it is
+ empty. This pointer is valid only until one makes structural changes.
+ @order \O(1) @allow */
+static PS_(node) *S_(sequence_peek)(const struct S_(sequence) *const s) {
+	PS_(node) *const i = S_(sequence_heap_peek)(&s->insert), *b;
+	assert(s);
+	if(!PS_(run_size)(&s->buffer)) return assert(!s->runs.size), i;
+	b = s->buffer.a.data + s->buffer.cursor;
+	return i && PS_(compare)(PSH_(get_priority)(b), PSH_(get_priority)(i)) > 0
+		? i : b;
+}
+
+/** @return Lowest <typedef:<PS>value> in `s` according to `SEQUENCE_COMPARE`;
+ if it is empty, null or zero. @order \O(1) @allow */
+static PS_(value) S_(sequence_peek_value)(const struct S_(sequence) *const s) {
+	const PS_(node) *const n = S_(sequence_peek)(s);
+	return n ? PSH_(get_value)(n) : 0;
+}
+
+/** Remove the lowest element according to `SEQUENCE_COMPARE`.
+ @return The <typedef:<PS>value> of the element that was removed; if it is
+ empty, null or zero. @order amortized \O(log `size`) @allow */
+static PS_(value) S_(sequence_pop)(struct S_(sequence) *const s) {
+	PS_(node) *const n = S_(sequence_peek)(s);
+	PS_(value) v;
+	if(!n) return 0;
+	v = PSH_(get_value)(n);
+	if(n == s->buffer.a.data + s->buffer.cursor) {
+		if(++s->buffer.cursor == s->buffer.a.size && s->runs.size)
+			PS_(refill)(s);
+	} else {
+		S_(sequence_heap_pop)(&s->insert);
+	}
+	s->size--;
+	return v;
+}
+
+#ifdef SEQUENCE_TEST /* <!-- test */
+#include "../test/test_sequence.h" /** \include */
+#endif /* test --> */
+
+static void PS_(unused_base_coda)(void);
+static void PS_(unused_base)(void) {
+	S_(sequence)(0); S_(sequence_)(0); S_(sequence_size)(0);
+	S_(sequence_peek_value)(0); S_(sequence_pop)(0);
+	PS_(unused_base_coda)();
+}
+static void PS_(unused_base_coda)(void) { PS_(unused_base)(); }
+
+#ifndef SEQUENCE_SUBTYPE /* <!-- !sub-type */
+#undef CAT
+#undef CAT_
+#else /* !sub-type --><!-- sub-type */
+#undef SEQUENCE_SUBTYPE
+#endif /* sub-type --> */
+#undef S_
+#undef PS_
+#undef PSH_
+#undef SEQUENCE_NAME
+#undef SEQUENCE_TYPE
+#undef SEQUENCE_COMPARE
+#ifdef SEQUENCE_VALUE
+#undef SEQUENCE_VALUE
+#endif
+#undef SEQUENCE_INSERT
+#undef SEQUENCE_ARITY
+#undef SEQUENCE_BUFFER
+#ifdef SEQUENCE_TEST
+#undef SEQUENCE_TEST
+#endif
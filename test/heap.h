@@ -27,6 +27,14 @@
  Optional payload <typedef:<PH>adjunct>, that is stored as a reference in
  <tag:<H>heap_node> as <typedef:<PH>value>; declaring it is sufficient.
 
+ @param[HEAP_ALLOC, HEAP_REALLOC, HEAP_FREE, HEAP_ALLOC_CONTEXT]
+ Optional allocator of the node array; passed to `ARRAY_ALLOC`,
+ `ARRAY_REALLOC`, `ARRAY_FREE`, and `ARRAY_ALLOC_CONTEXT` in <array.h>.
+
+ @param[HEAP_INLINE_CAPACITY]
+ Optional number of nodes stored inside <tag:<H>heap> before it allocates;
+ passed to `ARRAY_INLINE_CAPACITY` in <array.h>. The heap may be moved.
+
  @param[HEAP_TEST]
  To string trait contained in <../test/heap_test.h>; optional unit testing
  framework using `assert`. Must be defined equal to a random filler function,
@@ -126,11 +134,26 @@ typedef PH_(priority) PH_(node);
 #define ARRAY_NAME PH_(node)
 #define ARRAY_TYPE PH_(node)
 #define ARRAY_SUBTYPE
+#ifdef HEAP_ALLOC /* <!-- alloc */
+#define ARRAY_ALLOC HEAP_ALLOC
+#endif /* alloc --> */
+#ifdef HEAP_REALLOC /* <!-- realloc */
+#define ARRAY_REALLOC HEAP_REALLOC
+#endif /* realloc --> */
+#ifdef HEAP_FREE /* <!-- free */
+#define ARRAY_FREE HEAP_FREE
+#endif /* free --> */
+#ifdef HEAP_ALLOC_CONTEXT /* <!-- context */
+#define ARRAY_ALLOC_CONTEXT HEAP_ALLOC_CONTEXT
+#endif /* context --> */
+#ifdef HEAP_INLINE_CAPACITY /* <!-- inline */
+#define ARRAY_INLINE_CAPACITY HEAP_INLINE_CAPACITY
+#endif /* inline --> */
 #include "array.h"
 
 /** Stores the heap as an implicit binary tree in an array called `a`. To
- initialize it to an idle state, see <fn:<H>heap>, `HEAP_IDLE`, `{0}` (`C99`),
- or being `static`.
+ initialize it to an idle state, see <fn:<H>heap>, `<H>heap_idle`, `HEAP_IDLE`,
+ `{0}` (`C99`), or being `static`.
 
  ![States.](../web/states.png) */
 struct H_(heap);
@@ -138,6 +161,8 @@ struct H_(heap) { struct PH_(node_array) a; };
 #ifndef HEAP_IDLE /* <!-- !zero */
 #define HEAP_IDLE { ARRAY_IDLE }
 #endif /* !zero --> */
+/** An idle heap of this type; unlike `HEAP_IDLE`, it has every member. */
+static const struct H_(heap) H_(heap_idle);
 
 /** Extracts the <typedef:<PH>priority> of `node`, which must not be null. */
 static PH_(priority) PH_(get_priority)(const PH_(node) *const node) {
@@ -176,7 +201,7 @@ static void PH_(copy)(const PH_(node) *const src, PH_(node) *const dest) {
  @param[heap] At least one entry; the last entry will be replaced by `node`.
  @order \O(log `size`) */
 static void PH_(sift_up)(struct H_(heap) *const heap, PH_(node) *const node) {
-	PH_(node) *const n0 = heap->a.data;
+	PH_(node) *const n0 = PH_(node_array_data)(&heap->a);
 	PH_(priority) p = PH_(get_priority)(node);
 	size_t i = heap->a.size - 1;
 	assert(heap && heap->a.size && node);
@@ -198,7 +223,7 @@ static void PH_(sift_down)(struct H_(heap) *const heap) {
 	const size_t size = (assert(heap && heap->a.size), --heap->a.size),
 		half = size >> 1;
 	size_t i = 0, c;
-	PH_(node) *const n0 = heap->a.data,
+	PH_(node) *const n0 = PH_(node_array_data)(&heap->a),
 		*const down = n0 + size /* Put it at the top. */, *child;
 	const PH_(priority) down_p = PH_(get_priority)(down);
 	while(i < half) {
@@ -221,7 +246,7 @@ static void PH_(sift_down_i)(struct H_(heap) *const heap, size_t i) {
 	const size_t size = (assert(heap && i < heap->a.size), heap->a.size),
 		half = size >> 1;
 	size_t c;
-	PH_(node) *const n0 = heap->a.data, *child, temp;
+	PH_(node) *const n0 = PH_(node_array_data)(&heap->a), *child, temp;
 	int temp_valid = 0;
 	while(i < half) {
 		c = (i << 1) + 1;
@@ -254,7 +279,7 @@ static void PH_(heapify)(struct H_(heap) *const heap) {
 
 /** Removes from `heap`. Must have a non-zero size. */
 static PH_(node) PH_(remove)(struct H_(heap) *const heap) {
-	const PH_(node) result = *heap->a.data;
+	const PH_(node) result = *PH_(node_array_data)(&heap->a);
 	assert(heap);
 	if(heap->a.size > 1) {
 		PH_(sift_down)(heap);
@@ -291,7 +316,7 @@ static int H_(heap_add)(struct H_(heap) *const heap, PH_(node) node) {
  empty. This pointer is valid only until one makes structural changes to the
  heap. @order \O(1) @allow */
 static PH_(node) *H_(heap_peek)(const struct H_(heap) *const heap)
-	{ return assert(heap), heap->a.size ? heap->a.data : 0; }
+	{ return assert(heap), heap->a.size ? PH_(node_array_data)(&heap->a) : 0; }
 
 /** This returns the <typedef:<PH>value> of the <typedef:<PH>node> returned by
  <fn:<H>heap_peek>, for convenience with some applications. If `HEAP_VALUE`,
@@ -373,7 +398,8 @@ static void PH_(unused_base_coda)(void);
 static void PH_(unused_base)(void) {
 	H_(heap)(0); H_(heap_)(0); H_(heap_clear)(0); H_(heap_peek_value)(0);
 	H_(heap_pop)(0); H_(heap_buffer)(0, 0); H_(heap_append)(0, 0);
-	PH_(begin)(0, 0); PH_(next)(0); PH_(unused_base_coda)();
+	PH_(begin)(0, 0); PH_(next)(0); (void)H_(heap_idle);
+	PH_(unused_base_coda)();
 }
 static void PH_(unused_base_coda)(void) { PH_(unused_base)(); }
 
@@ -435,6 +461,21 @@ static void PH_(unused_to_string_coda)(void) { PH_(unused_to_string)(); }
 #ifdef HEAP_TEST_BASE
 #undef HEAP_TEST_BASE
 #endif
+#ifdef HEAP_ALLOC
+#undef HEAP_ALLOC
+#endif
+#ifdef HEAP_REALLOC
+#undef HEAP_REALLOC
+#endif
+#ifdef HEAP_FREE
+#undef HEAP_FREE
+#endif
+#ifdef HEAP_ALLOC_CONTEXT
+#undef HEAP_ALLOC_CONTEXT
+#endif
+#ifdef HEAP_INLINE_CAPACITY
+#undef HEAP_INLINE_CAPACITY
+#endif
 #undef BOX_
 #undef BOX_CONTAINER
 #undef BOX_CONTENTS
@@ -0,0 +1,251 @@
+/** @license 2021 Neil Edelman, distributed under the terms of the
+ [MIT License](https://opensource.org/licenses/MIT).
+
+ @subtitle Thread-Caching Pool
+
+ <tag:<M>magazine> is a thread-safe front-end to a <pool.h> of
+ <typedef:<PM>type>. Each thread acquires a <tag:<M>magazine_cache> that keeps
+ a magazine of up to `MAGAZINE_CAPACITY` free items. <fn:<M>magazine_new> and
+ <fn:<M>magazine_remove> work in the magazine without locking; only when it is
+ empty or full does it take the shared lock and move half a magazine to or
+ from the pool at once.
+
+ Every item remembers the cache that it came from. Removing an item that some
+ other thread allocated pushes it onto the remote list of the owner, under a
+ lock that only belongs to that cache; the owner takes them back the next time
+ its magazine runs dry.
+
+ @param[MAGAZINE_NAME, MAGAZINE_TYPE]
+ `<M>` that satisfies `C` naming conventions when mangled and a valid tag type,
+ <typedef:<PM>type>, associated therewith; required. `<PM>` is private, whose
+ names are prefixed in a manner to avoid collisions.
+
+ @param[MAGAZINE_CAPACITY]
+ Optional number of free items each cache holds, at least two; default 32.
+
+ @depend [pool](https://github.com/neil-edelman/pool)
+ @std C89; POSIX threads */
+
+#include <stdlib.h>  /* malloc free */
+#include <stddef.h>  /* offsetof */
+#include <assert.h>  /* assert */
+#include <errno.h>   /* errno */
+#include <pthread.h> /* pthread_mutex_* */
+
+#if !defined(MAGAZINE_NAME) || !defined(MAGAZINE_TYPE)
+#error Name MAGAZINE_NAME undefined or tag type MAGAZINE_TYPE undefined.
+#endif
+#ifndef MAGAZINE_CAPACITY
+#define MAGAZINE_CAPACITY 32
+#endif
+#if MAGAZINE_CAPACITY < 2
+#error MAGAZINE_CAPACITY must be at least two.
+#endif
+
+/* <Kernighan and Ritchie, 1988, p. 231>. */
+#if defined(M_) || defined(PM_) || defined(CAT) || defined(CAT_)
+#error Unexpected M_, PM_, or CAT_?.
+#endif
+#define CAT_(x, y) x ## _ ## y
+#define CAT(x, y) CAT_(x, y)
+#define M_(thing) CAT(MAGAZINE_NAME, thing)
+#define PM_(thing) CAT(magazine, M_(thing))
+
+/** A valid tag type set by `MAGAZINE_TYPE`. */
+typedef MAGAZINE_TYPE PM_(type);
+
+struct M_(magazine_cache);
+
+/** What the pool stores: the user's data, or, while it is on a remote list,
+ the next item, and the cache that allocated it. */
+struct PM_(item) {
+	struct M_(magazine_cache) *owner;
+	union { PM_(type) data; struct PM_(item) *next; } u;
+};
+
+#define POOL_NAME PM_(item)
+#define POOL_TYPE struct PM_(item)
+#define POOL_SUBTYPE
+#include "pool.h"
+
+/** Shared by all threads. To instantiate to an idle state, see
+ <fn:<M>magazine>, `MAGAZINE_IDLE`, or being `static`. */
+struct M_(magazine);
+struct M_(magazine) {
+	pthread_mutex_t lock; /* Guards everything here. */
+	struct PM_(item_pool) pool;
+	struct M_(magazine_cache) *caches; /* Stack of all caches ever. */
+};
+#ifndef MAGAZINE_IDLE /* <!-- !zero */
+#define MAGAZINE_IDLE { PTHREAD_MUTEX_INITIALIZER, POOL_IDLE, 0 }
+#endif /* !zero --> */
+
+/** One per thread, from <fn:<M>magazine_acquire>. */
+struct M_(magazine_cache);
+struct M_(magazine_cache) {
+	struct M_(magazine) *magazine;
+	struct M_(magazine_cache) *next;
+	int is_active;
+	size_t size;
+	struct PM_(item) *slot[MAGAZINE_CAPACITY];
+	pthread_mutex_t lock; /* Guards `remote`. */
+	struct PM_(item) *remote; /* Freed by other threads. */
+};
+
+/** @return The item that `datum` is in. */
+static struct PM_(item) *PM_(item)(PM_(type) *const datum) {
+	return (struct PM_(item) *)(void *)((char *)(void *)datum
+		- offsetof(struct PM_(item), u));
+}
+
+/** Returns the newest free items in `cache` to the pool until there are `keep`
+ left. @return Success. @throws[realloc] */
+static int PM_(flush)(struct M_(magazine_cache) *const cache,
+	const size_t keep) {
+	struct M_(magazine) *const m = cache->magazine;
+	int is_ok = 1;
+	pthread_mutex_lock(&m->lock);
+	while(cache->size > keep) {
+		if(!PM_(item_pool_remove)(&m->pool, cache->slot[cache->size - 1]))
+			{ is_ok = 0; break; }
+		cache->size--;
+	}
+	pthread_mutex_unlock(&m->lock);
+	return is_ok;
+}
+
+/** Fills the empty `cache` from its remote list or, failing that, half-way
+ from the pool. @return Success. @throws[ERANGE, malloc] */
+static int PM_(refill)(struct M_(magazine_cache) *const cache) {
+	struct M_(magazine) *const m = cache->magazine;
+	struct PM_(item) *item;
+	assert(!cache->size);
+	pthread_mutex_lock(&cache->lock);
+	while(cache->remote && cache->size < MAGAZINE_CAPACITY)
+		item = cache->remote, cache->remote = item->u.next,
+		cache->slot[cache->size++] = item;
+	pthread_mutex_unlock(&cache->lock);
+	if(cache->size) return 1;
+	pthread_mutex_lock(&m->lock);
+	while(cache->size < MAGAZINE_CAPACITY / 2
+		&& (item = PM_(item_pool_new)(&m->pool)))
+		item->owner = cache, cache->slot[cache->size++] = item;
+	pthread_mutex_unlock(&m->lock);
+	return !!cache->size;
+}
+
+/** Initializes `m` to idle. @return Success. @throws[pthread_mutex_init]
+ @order \Theta(1) @allow */
+static int M_(magazine)(struct M_(magazine) *const m) {
+	int e;
+	assert(m);
+	if(e = pthread_mutex_init(&m->lock, 0)) return errno = e, 0;
+	PM_(item_pool)(&m->pool);
+	m->caches = 0;
+	return 1;
+}
+
+/** Destroys `m`, all its caches, and all the items; no thread may be using
+ it. @allow */
+static void M_(magazine_)(struct M_(magazine) *const m) {
+	struct M_(magazine_cache) *cache;
+	if(!m) return;
+	while(cache = m->caches)
+		m->caches = cache->next, pthread_mutex_destroy(&cache->lock), free(cache);
+	PM_(item_pool_)(&m->pool);
+	pthread_mutex_destroy(&m->lock);
+}
+
+/** A thread calls this to get a cache of `m`, which is its own until
+ <fn:<M>magazine_release>; released caches are re-used.
+ @return The cache or null. @throws[malloc, pthread_mutex_init] @allow */
+static struct M_(magazine_cache) *M_(magazine_acquire)(
+	struct M_(magazine) *const m) {
+	struct M_(magazine_cache) *cache;
+	int e;
+	assert(m);
+	pthread_mutex_lock(&m->lock);
+	for(cache = m->caches; cache && cache->is_active; cache = cache->next);
+	if(!cache) {
+		if(!(cache = malloc(sizeof *cache)))
+			{ if(!errno) errno = ERANGE; goto finally; }
+		if(e = pthread_mutex_init(&cache->lock, 0))
+			{ free(cache), cache = 0, errno = e; goto finally; }
+		cache->magazine = m, cache->size = 0, cache->remote = 0;
+		cache->next = m->caches, m->caches = cache;
+	}
+	cache->is_active = 1;
+finally:
+	pthread_mutex_unlock(&m->lock);
+	return cache;
+}
+
+/** Returns everything free in `cache` to the pool and gives up the cache.
+ Items allocated from it may still be removed by any thread.
+ @return Success; on failure, the cache is released anyway, and holds the
+ rest. @throws[realloc] @allow */
+static int M_(magazine_release)(struct M_(magazine_cache) *const cache) {
+	struct M_(magazine) *m;
+	struct PM_(item) *item;
+	int is_ok = 1;
+	if(!cache) return 1;
+	m = cache->magazine;
+	is_ok = PM_(flush)(cache, 0);
+	pthread_mutex_lock(&m->lock);
+	pthread_mutex_lock(&cache->lock);
+	while(item = cache->remote) {
+		struct PM_(item) *const next = item->u.next; /* Chunk may go. */
+		if(!PM_(item_pool_remove)(&m->pool, item)) { is_ok = 0; break; }
+		cache->remote = next;
+	}
+	pthread_mutex_unlock(&cache->lock);
+	cache->is_active = 0;
+	pthread_mutex_unlock(&m->lock);
+	return is_ok;
+}
+
+/** Only the thread that owns `cache` may call this. This pointer is constant
+ until it gets removed. @return A pointer to a new uninitialized element.
+ @throws[ERANGE, malloc] @order amortised \O(1) @allow */
+static PM_(type) *M_(magazine_new)(struct M_(magazine_cache) *const cache) {
+	assert(cache && cache->is_active);
+	if(!cache->size && !PM_(refill)(cache)) return 0;
+	return &cache->slot[--cache->size]->u.data;
+}
+
+/** Deletes `datum` from any `cache` of the same magazine; only the thread that
+ owns `cache` may call this. @return Success. @throws[realloc]
+ @order amortised \O(1) @allow */
+static int M_(magazine_remove)(struct M_(magazine_cache) *const cache,
+	PM_(type) *const datum) {
+	struct PM_(item) *const item = PM_(item)(datum);
+	struct M_(magazine_cache) *const owner = item->owner;
+	assert(cache && cache->is_active && datum && owner
+		&& owner->magazine == cache->magazine);
+	if(owner != cache) {
+		pthread_mutex_lock(&owner->lock);
+		item->u.next = owner->remote, owner->remote = item;
+		pthread_mutex_unlock(&owner->lock);
+		return 1;
+	}
+	if(cache->size >= MAGAZINE_CAPACITY
+		&& !PM_(flush)(cache, MAGAZINE_CAPACITY / 2)) return 0;
+	cache->slot[cache->size++] = item;
+	return 1;
+}
+
+static void PM_(unused_base_coda)(void);
+static void PM_(unused_base)(void) {
+	M_(magazine)(0); M_(magazine_)(0); M_(magazine_acquire)(0);
+	M_(magazine_release)(0); M_(magazine_new)(0); M_(magazine_remove)(0, 0);
+	PM_(unused_base_coda)();
+}
+static void PM_(unused_base_coda)(void) { PM_(unused_base)(); }
+
+#undef CAT
+#undef CAT_
+#undef M_
+#undef PM_
+#undef MAGAZINE_NAME
+#undef MAGAZINE_TYPE
+#undef MAGAZINE_CAPACITY
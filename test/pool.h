@@ -9,13 +9,47 @@
  valid items in the pool are stable, but not generally in any order or
  contiguous. It uses geometrically increasing size-blocks, so, if data reaches
  a steady-state size, when the removal is uniformly sampled, it will settle in
- one allocated region.
+ one allocated region. Each chunk has a bitmap of which items are live, so
+ <fn:<P>pool_next> can visit all of them, skipping free ones a word at a time.
 
  @param[POOL_NAME, POOL_TYPE]
  `<P>` that satisfies `C` naming conventions when mangled and a valid tag type,
  <typedef:<PP>type>, associated therewith; required. `<PP>` is private, whose
  names are prefixed in a manner to avoid collisions.
 
+ @param[POOL_ALLOC, POOL_REALLOC, POOL_FREE, POOL_ALLOC_CONTEXT]
+ Optional allocator of the chunks, which are most of the memory; the same
+ contract as `ARRAY_ALLOC`, `ARRAY_REALLOC`, `ARRAY_FREE`, and
+ `ARRAY_ALLOC_CONTEXT` in <array.h>. The bookkeeping is shared between all
+ pools and uses the standard library.
+
+ @param[POOL_CHUNK_ALIGN]
+ Optional power-of-two integer constant bytes; every chunk is exactly this
+ size and starts on a multiple of it, so <fn:<P>pool_remove> finds the chunk
+ of a pointer with a mask in \O(1), instead of searching. `POOL_ALLOC` must
+ return blocks aligned to it, for example, `alloc_huge` in <../src/alloc.h>
+ with `ALLOC_HUGE_PAGE`. Without `POOL_ALLOC`, it is `posix_memalign` where
+ POSIX.1-2001 is exposed, otherwise `alloc_aligned` in <../src/alloc.h>, which
+ over-allocates by the alignment.
+
+ @param[POOL_FREE_LIST]
+ Optional; free items in chunk-zero are threaded into an intrusive singly-linked
+ list instead of a free-heap, so <fn:<P>pool_new> and <fn:<P>pool_remove> are
+ \O(1). Requires <typedef:<PP>type> to be at least the size of `size_t`. The
+ trade-off is that the free items no longer go to the lowest index first, and
+ <fn:<P>pool_buffer> does not count them.
+
+ @param[POOL_HANDLE, POOL_HANDLE_BITS]
+ Optional; every item also has a non-zero 32-bit <typedef:pool_handle> from
+ <fn:<P>pool_handle>, that <fn:<P>pool_get> turns back into the pointer in
+ \Theta(1), for example, as `HEAP_HANDLE` in <../src/heap.h>. The low
+ `POOL_HANDLE_BITS`, default 20, are the index in the chunk, so chunks hold at
+ most `2^POOL_HANDLE_BITS`, and the rest are the chunk.
+
+ @param[POOL_PAGE]
+ Optional page size that <fn:<P>pool_compact> gives back to the system,
+ (with `MADV_DONTNEED`, where it is available,) in multiples of; default 4096.
+
  @param[POOL_TEST]
  To string trait contained in <../test/pool_test.h>; optional unit testing
  framework using `assert`. Must be defined equal to a (random) filler function,
@@ -35,21 +69,64 @@
  @std C89 */
 
 #include <stdlib.h>	/* malloc free */
+#include <string.h>	/* memcpy memset */
+#include <limits.h>	/* CHAR_BIT */
 #include <assert.h>	/* assert */
 #include <errno.h>	/* errno */
+#if defined(__unix__) || defined(__unix) \
+	|| (defined(__APPLE__) && defined(__MACH__))
+#include <sys/mman.h>	/* madvise */
+#endif
 
 #ifndef POOL_H /* <!-- idempotent */
 #define POOL_H
+#if defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200112L /* <!-- memalign */
+#define POOL_MEMALIGN /* `posix_memalign` in <stdlib.h>. */
+#else /* memalign --><!-- !memalign */
+#include "../src/alloc.h" /* alloc_aligned */
+#endif /* !memalign --> */
 /* `[2, (SIZE_MAX - sizeof pool_chunk) / sizeof <PP>type]` */
 #define POOL_CHUNK_MIN_CAPACITY 8
-/** Stable chunk followed by data; explicit naming to avoid confusion. */
-struct pool_chunk { size_t size; };
+#ifndef POOL_PAGE /* <!-- !page: it only has to be a multiple of the real. */
+#define POOL_PAGE 4096
+#endif /* !page --> */
+/** Stable chunk followed by data and then a bitmap of which are occupied;
+ explicit naming to avoid confusion. */
+struct pool_chunk { size_t size, capacity; };
+/** A compact reference to an item in a pool with `POOL_HANDLE`, at least 32
+ bits; zero is null. */
+#if UINT_MAX >= 0xffffffff /* <!-- int */
+typedef unsigned pool_handle;
+#else /* int --><!-- long */
+typedef unsigned long pool_handle;
+#endif /* long --> */
+/** The occupancy bitmap is in words of this. */
+typedef unsigned long pool_word;
+#define POOL_WORD_BITS (sizeof(pool_word) * CHAR_BIT)
+/** @return The number of words that hold `n` bits. */
+static size_t pool_words(const size_t n)
+	{ return (n + POOL_WORD_BITS - 1) / POOL_WORD_BITS; }
+/** @return The index of the lowest set bit of non-zero `w`. */
+static unsigned pool_lowest(pool_word w) {
+#ifdef __GNUC__ /* <!-- gnu */
+	return assert(w), (unsigned)__builtin_ctzl(w);
+#else /* gnu --><!-- !gnu */
+	unsigned i = 0;
+	assert(w);
+	while(!(w & 1)) w >>= 1, i++;
+	return i;
+#endif /* !gnu --> */
+}
 /** A slot is a pointer to a stable chunk. It makes the source much more
  readable to have this instead of a `**chunk`. */
 typedef struct pool_chunk *pool_slot;
 /* <array.h> and <heap.h> must be in the same directory. */
 #define ARRAY_NAME pool_slot
 #define ARRAY_TYPE pool_slot
+#ifdef POOL_SUBTYPE /* <!-- sub: `CAT` is already defined. */
+#define ARRAY_SUBTYPE
+#define HEAP_SUBTYPE
+#endif /* sub --> */
 #include "array.h"
 /** @return An order on `a`, `b` which specifies a max-heap. */
 static int pool_index_compare(const size_t a, const size_t b) { return a < b; }
@@ -78,6 +155,26 @@ static int pool_index_compare(const size_t a, const size_t b) { return a < b; }
 #if defined(POOL_TO_STRING_NAME) && !defined(POOL_TO_STRING)
 #error POOL_TO_STRING_NAME requires POOL_TO_STRING.
 #endif
+#if (defined(POOL_ALLOC) || defined(POOL_REALLOC) || defined(POOL_FREE)) \
+	&& (!defined(POOL_ALLOC) || !defined(POOL_REALLOC) || !defined(POOL_FREE))
+#error POOL_ALLOC, POOL_REALLOC, and POOL_FREE go together.
+#endif
+#if defined(POOL_ALLOC_CONTEXT) && !defined(POOL_ALLOC)
+#error POOL_ALLOC_CONTEXT requires POOL_ALLOC.
+#endif
+#if defined(POOL_CHUNK_ALIGN) && POOL_CHUNK_ALIGN & (POOL_CHUNK_ALIGN - 1)
+#error POOL_CHUNK_ALIGN must be a power of two.
+#endif
+#ifdef POOL_HANDLE /* <!-- handle */
+#ifndef POOL_HANDLE_BITS
+#define POOL_HANDLE_BITS 20
+#endif
+#if POOL_HANDLE_BITS < 4 || POOL_HANDLE_BITS > 28
+#error POOL_HANDLE_BITS must leave room for the chunk in 32 bits.
+#endif
+#elif defined(POOL_HANDLE_BITS) /* handle --><!-- !handle */
+#error POOL_HANDLE_BITS requires POOL_HANDLE.
+#endif /* !handle --> */
 
 
 #if POOL_TRAITS == 0 /* <!-- base code */
@@ -108,16 +205,240 @@ struct P_(pool) {
 	struct pool_slot_array slots; /* Pointers to stable chunks. */
 	struct pool_free_heap free0; /* Free-list in chunk-zero. */
 	size_t capacity0; /* Capacity of chunk-zero. */
+	size_t free_list; /* `POOL_FREE_LIST` head in chunk-zero plus one. */
+	struct pool_slot_array handles; /* `POOL_HANDLE` chunks by id, or null. */
 };
+
+/** Visits every live item in a <tag:<P>pool>; see <fn:<P>pool_begin>. */
+struct P_(pool_iterator);
+struct P_(pool_iterator) {
+	const struct P_(pool) *pool;
+	size_t slot, slots, word;
+	pool_word bits; /* The rest of `word` that is live and not visited. */
+};
+
+/** <fn:<P>pool_compact> moved `from` to `to` in a pool; any pointers to `from`
+ must be changed to `to`. `context` is passed through. */
+typedef void (*PP_(relocate_fn))(void *context, PP_(type) *from,
+	PP_(type) *to);
 /* `{0}` is `C99`. */
 #ifndef POOL_IDLE /* <!-- !zero */
-#define POOL_IDLE { ARRAY_IDLE, HEAP_IDLE, (size_t)0 }
+#define POOL_IDLE { ARRAY_IDLE, HEAP_IDLE, (size_t)0, (size_t)0, ARRAY_IDLE }
 #endif /* !zero --> */
 
+#ifdef POOL_ALLOC /* <!-- alloc */
+#ifndef POOL_ALLOC_CONTEXT
+#define POOL_ALLOC_CONTEXT 0
+#endif
+/** Allocates `size` bytes with `context`, like `malloc`. */
+typedef void *(*PP_(alloc_fn))(void *context, size_t size);
+/** Resizes `data` of `old_size` to `size` bytes with `context`, like
+ `realloc`, but never called with null `data`. */
+typedef void *(*PP_(realloc_fn))(void *context, void *data, size_t old_size,
+	size_t size);
+/** Frees `data` of `size` bytes with `context`; never called with null. */
+typedef void (*PP_(free_fn))(void *context, void *data, size_t size);
+static const PP_(alloc_fn) PP_(alloc) = (POOL_ALLOC);
+static const PP_(realloc_fn) PP_(realloc) = (POOL_REALLOC);
+static const PP_(free_fn) PP_(free) = (POOL_FREE);
+#endif /* alloc --> */
+
+/** @return The offset of the bitmap in a chunk of `capacity`. */
+static size_t PP_(bitmap_offset)(const size_t capacity) {
+	return (sizeof(struct pool_chunk) + capacity * sizeof(PP_(type))
+		+ sizeof(pool_word) - 1) / sizeof(pool_word) * sizeof(pool_word);
+}
+
+/** @return The bytes in a chunk of `capacity`; with `POOL_HANDLE`, the id of
+ the chunk is after the bitmap. */
+static size_t PP_(chunk_bytes)(const size_t capacity) {
+	return PP_(bitmap_offset)(capacity) + pool_words(capacity)
+		* sizeof(pool_word)
+#ifdef POOL_HANDLE /* <!-- handle */
+		+ sizeof(size_t)
+#endif /* handle --> */
+		;
+}
+
+#ifdef POOL_CHUNK_ALIGN /* <!-- align */
+
+/** @return The capacity of every chunk: each item is its size and a bit,
+ leaving a word each for rounding the data and the bitmap. */
+static size_t PP_(chunk_capacity)(void) {
+	const size_t c = (POOL_CHUNK_ALIGN - PP_(chunk_bytes)(0)
+		- 2 * sizeof(pool_word)) * CHAR_BIT / (sizeof(PP_(type)) * CHAR_BIT + 1);
+	return assert(POOL_CHUNK_ALIGN > PP_(chunk_bytes)(0)
+		+ 2 * sizeof(pool_word) && c >= POOL_CHUNK_MIN_CAPACITY
+		&& PP_(chunk_bytes)(c) <= POOL_CHUNK_ALIGN), c;
+}
+
+/** @return The chunk that `datum` is in. @order \Theta(1) */
+static struct pool_chunk *PP_(chunk)(const PP_(type) *const datum) {
+	const char *const chunk = (const char *)datum
+		- ((unsigned long)datum & (POOL_CHUNK_ALIGN - 1));
+	/* The pool owns the chunk; through an address, `const` is not lost. */
+	return (struct pool_chunk *)(size_t)chunk;
+}
+
+/** Allocates a new chunk of the alignment, which must be `capacity`.
+ @return The new chunk or null. @throws[malloc, ERANGE] */
+static struct pool_chunk *PP_(chunk_resize)(struct pool_chunk *const chunk,
+	const size_t capacity) {
+	struct pool_chunk *c;
+	assert(!chunk && capacity == PP_(chunk_capacity)());
+	(void)chunk;
+#ifdef POOL_ALLOC /* <!-- alloc */
+	if(!(c = PP_(alloc)((void *)(POOL_ALLOC_CONTEXT), POOL_CHUNK_ALIGN)))
+		{ if(!errno) errno = ERANGE; return 0; }
+	if((unsigned long)c & (POOL_CHUNK_ALIGN - 1)) { /* Not what we asked. */
+		PP_(free)((void *)(POOL_ALLOC_CONTEXT), c, POOL_CHUNK_ALIGN);
+		errno = ERANGE;
+		return 0;
+	}
+#else /* alloc --><!-- !alloc */
+#ifdef POOL_MEMALIGN /* <!-- memalign */
+	{
+		void *raw;
+		const int e = posix_memalign(&raw, POOL_CHUNK_ALIGN, POOL_CHUNK_ALIGN);
+		if(e) { errno = e; return 0; }
+		c = raw;
+	}
+#else /* memalign --><!-- !memalign */
+	{
+		size_t align = POOL_CHUNK_ALIGN;
+		if(!(c = alloc_aligned(&align, POOL_CHUNK_ALIGN))) return 0;
+	}
+#endif /* !memalign --> */
+#endif /* !alloc --> */
+	c->capacity = capacity;
+	return c;
+}
+
+/** Frees `chunk`. */
+static void PP_(chunk_free)(struct pool_chunk *const chunk) {
+	assert(chunk);
+#ifdef POOL_ALLOC /* <!-- alloc */
+	PP_(free)((void *)(POOL_ALLOC_CONTEXT), chunk, POOL_CHUNK_ALIGN);
+#elif defined(POOL_MEMALIGN) /* alloc --><!-- memalign */
+	free(chunk);
+#else /* memalign --><!-- !memalign */
+	alloc_aligned_free(0, chunk, POOL_CHUNK_ALIGN);
+#endif /* !memalign --> */
+}
+
+#else /* align --><!-- !align */
+
+/** Resizes `chunk`, which may be null, to hold `capacity`.
+ @return The new chunk or null. @throws[malloc] */
+static struct pool_chunk *PP_(chunk_resize)(struct pool_chunk *const chunk,
+	const size_t capacity) {
+	struct pool_chunk *c;
+#ifdef POOL_ALLOC /* <!-- alloc */
+	c = chunk ? PP_(realloc)((void *)(POOL_ALLOC_CONTEXT), chunk,
+		PP_(chunk_bytes)(chunk->capacity), PP_(chunk_bytes)(capacity))
+		: PP_(alloc)((void *)(POOL_ALLOC_CONTEXT), PP_(chunk_bytes)(capacity));
+#else /* alloc --><!-- !alloc */
+	c = realloc(chunk, PP_(chunk_bytes)(capacity));
+#endif /* !alloc --> */
+	if(!c) { if(!errno) errno = ERANGE; return 0; }
+	c->capacity = capacity;
+	return c;
+}
+
+/** Frees `chunk`. */
+static void PP_(chunk_free)(struct pool_chunk *const chunk) {
+	assert(chunk);
+#ifdef POOL_ALLOC /* <!-- alloc */
+	PP_(free)((void *)(POOL_ALLOC_CONTEXT), chunk,
+		PP_(chunk_bytes)(chunk->capacity));
+#else /* alloc --><!-- !alloc */
+	free(chunk);
+#endif /* !alloc --> */
+}
+
+#endif /* !align --> */
+
 /** @return Given a pointer to `chunk`, return the chunk data. */
 static PP_(type) *PP_(data)(struct pool_chunk *const chunk)
 	{ return (PP_(type) *)(chunk + 1); }
 
+/** @return Given a pointer to `chunk`, return the occupancy bitmap. */
+static pool_word *PP_(bitmap)(struct pool_chunk *const chunk) {
+	return (pool_word *)(void *)((char *)(void *)chunk
+		+ PP_(bitmap_offset)(chunk->capacity));
+}
+
+/** Marks `idx` in `chunk` as live. */
+static void PP_(occupy)(struct pool_chunk *const chunk, const size_t idx) {
+	assert(idx < chunk->capacity);
+	PP_(bitmap)(chunk)[idx / POOL_WORD_BITS]
+		|= (pool_word)1 << idx % POOL_WORD_BITS;
+}
+
+/** Marks `idx` in `chunk` as free. */
+static void PP_(vacate)(struct pool_chunk *const chunk, const size_t idx) {
+	assert(idx < chunk->capacity);
+	PP_(bitmap)(chunk)[idx / POOL_WORD_BITS]
+		&= ~((pool_word)1 << idx % POOL_WORD_BITS);
+}
+
+/** Marks `n` from `idx` in `chunk` as live, a word at a time. */
+static void PP_(occupy_n)(struct pool_chunk *const chunk, size_t idx,
+	size_t n) {
+	pool_word *const bitmap = PP_(bitmap)(chunk);
+	assert(idx + n <= chunk->capacity);
+	for( ; n && idx % POOL_WORD_BITS; idx++, n--)
+		bitmap[idx / POOL_WORD_BITS] |= (pool_word)1 << idx % POOL_WORD_BITS;
+	for( ; n >= POOL_WORD_BITS; idx += POOL_WORD_BITS, n -= POOL_WORD_BITS)
+		bitmap[idx / POOL_WORD_BITS] = ~(pool_word)0;
+	for( ; n; idx++, n--)
+		bitmap[idx / POOL_WORD_BITS] |= (pool_word)1 << idx % POOL_WORD_BITS;
+}
+
+/** @return Whether `idx` in `chunk` is live. */
+static int PP_(is_live)(struct pool_chunk *const chunk, const size_t idx) {
+	assert(idx < chunk->capacity);
+	return !!(PP_(bitmap)(chunk)[idx / POOL_WORD_BITS]
+		& (pool_word)1 << idx % POOL_WORD_BITS);
+}
+
+#if defined(POOL_CHUNK_ALIGN) || defined(POOL_HANDLE) /* <!-- max */
+/** @return The most items that can be in a chunk. */
+static size_t PP_(chunk_max)(void) {
+#ifdef POOL_CHUNK_ALIGN /* <!-- align */
+#ifdef POOL_HANDLE /* <!-- handle */
+	assert(PP_(chunk_capacity)() <= (size_t)1 << POOL_HANDLE_BITS);
+#endif /* handle --> */
+	return PP_(chunk_capacity)();
+#else /* align --><!-- !align */
+	return (size_t)1 << POOL_HANDLE_BITS;
+#endif /* !align --> */
+}
+#endif /* max --> */
+
+#ifdef POOL_HANDLE /* <!-- handle */
+/** @return The id of `chunk` in the handles. */
+static size_t *PP_(id)(struct pool_chunk *const chunk) {
+	return (size_t *)(void *)((char *)(void *)PP_(bitmap)(chunk)
+		+ pool_words(chunk->capacity) * sizeof(pool_word));
+}
+#endif /* handle --> */
+
+/** Frees `chunk`, which is not in the slots of `pool`. */
+static void PP_(retire)(struct P_(pool) *const pool,
+	struct pool_chunk *const chunk) {
+#ifdef POOL_HANDLE /* <!-- handle */
+	struct pool_slot_array *const handles = &pool->handles;
+	assert(*PP_(id)(chunk) < handles->size
+		&& handles->data[*PP_(id)(chunk)] == chunk);
+	handles->data[*PP_(id)(chunk)] = 0;
+	while(handles->size && !handles->data[handles->size - 1]) handles->size--;
+#else /* handle --><!-- !handle */
+	(void)pool;
+#endif /* !handle --> */
+	PP_(chunk_free)(chunk);
+}
+
 /** @return Index of sorted slot[1..n] that is higher than `x` in `slots`.
  The `[0]` slot is unsorted. @order \O(\log `slots`) */
 static size_t PP_(upper)(const struct pool_slot_array *const slots,
@@ -154,14 +475,42 @@ static size_t PP_(slot)(const struct P_(pool) *const pool,
 	return assert(up), up - 1;
 }
 
+/** @return The number of live items in chunk-zero of `pool`, which has one.
+ @order \O(`free items`) with `POOL_FREE_LIST`, otherwise \Theta(1) */
+static size_t PP_(live0)(const struct P_(pool) *const pool) {
+	struct pool_chunk *const chunk0 = pool->slots.data[0];
+	size_t live = chunk0->size - pool->free0.a.size;
+#ifdef POOL_FREE_LIST /* <!-- list */
+	size_t next = pool->free_list;
+	while(next) {
+		assert(live && next <= chunk0->size);
+		memcpy(&next, PP_(data)(chunk0) + next - 1, sizeof next);
+		live--;
+	}
+#endif /* list --> */
+	return live;
+}
+
+/** Chunk-zero of `pool` has `live` items and is retiring or being re-used;
+ stops keeping track of its free items. */
+static void PP_(forget0)(struct P_(pool) *const pool, const size_t live) {
+	pool->slots.data[0]->size = live;
+	pool_free_heap_clear(&pool->free0);
+	pool->free_list = 0;
+}
+
 /** Makes sure there are space for `n` further items in `pool`.
- @return Success. */
+ @return Success. @throws[ERANGE, malloc] */
 static int PP_(buffer)(struct P_(pool) *const pool, const size_t n) {
 	pool_slot *slot;
 	struct pool_chunk *chunk;
 	const size_t min_size = POOL_CHUNK_MIN_CAPACITY,
-		max_size = ((size_t)-1 - sizeof(struct pool_chunk)) / sizeof(PP_(type));
-	size_t c, alloc, insert;
+		max_size = ((size_t)-1 - PP_(chunk_bytes)(0)
+		- 2 * sizeof(pool_word)) / (sizeof(PP_(type)) + 1);
+	size_t c, insert, live0 = 0;
+#ifdef POOL_HANDLE /* <!-- handle */
+	size_t id;
+#endif /* handle --> */
 	int is_recycled = 0;
 	assert(pool && min_size <= max_size && pool->capacity0 <= max_size &&
 		!pool->slots.size && !pool->free0.a.size /* !chunks[0] -> !free0 */
@@ -175,26 +524,55 @@ static int PP_(buffer)(struct P_(pool) *const pool, const size_t n) {
 	if(!n || pool->slots.size && n <= pool->capacity0
 		- pool->slots.data[0]->size + pool->free0.a.size) return 1;
 	/* The request is unsatisfiable. */
-	if(max_size < n) return errno = ERANGE, 1;
+	if(max_size < n) return errno = ERANGE, 0;
+	/* Chunk-zero with only free items can be re-used. */
+	if(pool->slots.size && !(live0 = PP_(live0)(pool))
+		&& n <= pool->capacity0) return PP_(forget0)(pool, 0), 1;
 	/* We will make a new slot. */
 	if(!pool_slot_array_buffer(&pool->slots, 1)) return 0;
+#ifdef POOL_HANDLE /* <!-- handle: and maybe a new id. */
+	if(!pool_slot_array_buffer(&pool->handles, 1)) return 0;
+#endif /* handle --> */
 
 	/* Figure out the size of the next chunk and allocate it. */
+#ifdef POOL_CHUNK_ALIGN /* <!-- align: all the same size. */
+	if((c = PP_(chunk_capacity)()) < n) return errno = ERANGE, 0;
+	assert(!pool->slots.size || live0);
+#else /* align --><!-- !align */
 	c = pool->capacity0;
-	if(pool->slots.size && pool->slots.data[0]->size) { /* ~Golden ratio. */
+	if(pool->slots.size && live0) { /* ~Golden ratio. */
 		size_t c1 = c + (c >> 1) + (c >> 3);
 		c = (c1 < c || c1 > max_size) ? max_size : c1;
 	}
 	if(c < min_size) c = min_size;
 	if(c < n) c = n;
-	alloc = sizeof chunk + c * sizeof(PP_(type));
-	if(pool->slots.size && !pool->slots.data[0]->size)
-		is_recycled = 1, chunk = realloc(pool->slots.data[0], alloc);
-	else chunk = malloc(alloc);
+#ifdef POOL_HANDLE /* <!-- handle */
+	if(c > PP_(chunk_max)()) {
+		if(n > PP_(chunk_max)()) return errno = ERANGE, 0;
+		c = PP_(chunk_max)();
+	}
+#endif /* handle --> */
+#endif /* !align --> */
+#ifdef POOL_HANDLE /* <!-- handle: re-use the id, or the first free. */
+	if(pool->slots.size && !live0) id = *PP_(id)(pool->slots.data[0]);
+	else for(id = 0; id < pool->handles.size && pool->handles.data[id]; id++);
+	if(id >= ((size_t)1 << (32 - POOL_HANDLE_BITS)) - 1)
+		return errno = ERANGE, 0;
+#endif /* handle --> */
+	if(pool->slots.size && !live0)
+		is_recycled = 1, chunk = PP_(chunk_resize)(pool->slots.data[0], c);
+	else chunk = PP_(chunk_resize)(0, c);
 	if(!chunk) return 0;
+	memset(PP_(bitmap)(chunk), 0, pool_words(c) * sizeof(pool_word));
 	chunk->size = 0;
 	pool->capacity0 = c;
-	if(is_recycled) return pool->slots.data[0] = chunk, 1;
+#ifdef POOL_HANDLE /* <!-- handle */
+	if(id == pool->handles.size) pool_slot_array_new(&pool->handles);
+	pool->handles.data[id] = chunk, *PP_(id)(chunk) = id;
+#endif /* handle --> */
+	if(is_recycled) return pool->slots.data[0] = chunk, PP_(forget0)(pool, 0), 1;
+	/* A secondary chunk's size is the number live, wherever they are. */
+	if(pool->slots.size) PP_(forget0)(pool, live0);
 
 	/* Add it to the slots, in order. */
 	if(!pool->slots.size) insert = 0;
@@ -210,16 +588,31 @@ static int PP_(buffer)(struct P_(pool) *const pool, const size_t n) {
  decrements the size, or it's the zero-chunk, where it gets added to the
  free-heap.
  @return Success. It may fail due to a free-heap memory allocation error.
- @order Amortized \O(\log \log `items`) @throws[realloc] */
+ @order Amortized \O(\log \log `items`); with `POOL_CHUNK_ALIGN`, only a
+ chunk becoming empty searches. @throws[realloc] */
 static int PP_(remove)(struct P_(pool) *const pool,
 	const PP_(type) *const data) {
-	size_t s = PP_(slot)(pool, data);
-	struct pool_chunk *chunk = pool->slots.data[s];
+	struct pool_chunk *chunk;
+	size_t s, idx;
 	assert(pool && pool->slots.size && data);
+#ifdef POOL_CHUNK_ALIGN /* <!-- align */
+	chunk = PP_(chunk)(data), s = chunk != pool->slots.data[0];
+#else /* align --><!-- !align */
+	s = PP_(slot)(pool, data), chunk = pool->slots.data[s];
+#endif /* !align --> */
+	idx = (size_t)(data - PP_(data)(chunk));
 	if(!s) { /* It's in the zero-slot, we need to deal with the free-heap. */
-		const size_t idx = (size_t)(data - PP_(data)(chunk));
 		assert(pool->capacity0 && chunk->size <= pool->capacity0
 			&& idx < chunk->size);
+#ifdef POOL_FREE_LIST /* <!-- list */
+		assert(sizeof *data >= sizeof pool->free_list);
+		PP_(vacate)(chunk, idx);
+		if(idx + 1 == chunk->size) { chunk->size--; return 1; }
+		memcpy(PP_(data)(chunk) + idx, &pool->free_list,
+			sizeof pool->free_list);
+		pool->free_list = idx + 1;
+		return 1;
+#endif /* list --> */
 		if(idx + 1 == chunk->size) { /* It's at the end -- size goes down. */
 			while(--chunk->size) {
 				const size_t *const free = pool_free_heap_peek(&pool->free0);
@@ -229,24 +622,33 @@ static int PP_(remove)(struct P_(pool) *const pool,
 				pool_free_heap_pop(&pool->free0);
 			}
 		} else if(!pool_free_heap_add(&pool->free0, idx)) return 0;
-	} else if(assert(chunk->size), !--chunk->size)
-		pool_slot_array_remove(&pool->slots, pool->slots.data + s), free(chunk);
+		PP_(vacate)(chunk, idx);
+	} else if(assert(chunk->size), PP_(vacate)(chunk, idx), !--chunk->size) {
+#ifdef POOL_CHUNK_ALIGN /* <!-- align */
+		s = PP_(slot)(pool, data);
+		assert(pool->slots.data[s] == chunk);
+#endif /* align --> */
+		pool_slot_array_remove(&pool->slots, pool->slots.data + s);
+		PP_(retire)(pool, chunk);
+	}
 	return 1;
 }
 
 /** Initializes `pool` to idle. @order \Theta(1) @allow */
 static void P_(pool)(struct P_(pool) *const pool) { assert(pool),
 	pool_slot_array(&pool->slots), pool_free_heap(&pool->free0),
-	pool->capacity0 = 0; }
+	pool->capacity0 = 0, pool->free_list = 0,
+	pool_slot_array(&pool->handles); }
 
 /** Destroys `pool` and returns it to idle. @order \O(\log `data`) @allow */
 static void P_(pool_)(struct P_(pool) *const pool) {
 	pool_slot *i, *i_end;
 	assert(pool);
 	for(i = pool->slots.data, i_end = i + pool->slots.size; i < i_end; i++)
-		assert(*i), free(*i);
+		assert(*i), PP_(chunk_free)(*i);
 	pool_slot_array_(&pool->slots);
 	pool_free_heap_(&pool->free0);
+	pool_slot_array_(&pool->handles);
 	P_(pool)(pool);
 }
 
@@ -256,23 +658,72 @@ static int P_(pool_buffer)(struct P_(pool) *const pool, const size_t n) {
 	return assert(pool), PP_(buffer)(pool, n);
 }
 
-/** This pointer is constant until it gets removed.
- @return A pointer to a new uninitialized element from `pool`.
- @throws[ERANGE, malloc] @order amortised O(1) @allow */
-static PP_(type) *P_(pool_new)(struct P_(pool) *const pool) {
+/** @return A new item from chunk-zero of `pool`, which must have room.
+ @order \Theta(1) */
+static PP_(type) *PP_(new0)(struct P_(pool) *const pool) {
 	size_t *free;
 	struct pool_chunk *chunk0;
-	assert(pool);
-	if(!PP_(buffer)(pool, 1)) return 0;
-	assert(pool->slots.size && (pool->free0.a.size ||
-		pool->slots.data[0]->size < pool->capacity0));
+	assert(pool && pool->slots.size);
+	chunk0 = pool->slots.data[0];
+#ifdef POOL_FREE_LIST /* <!-- list */
+	if(pool->free_list) {
+		PP_(type) *const datum = PP_(data)(chunk0) + pool->free_list - 1;
+		assert(pool->free_list <= chunk0->size);
+		PP_(occupy)(chunk0, pool->free_list - 1);
+		memcpy(&pool->free_list, datum, sizeof pool->free_list);
+		return datum;
+	}
+#endif /* list --> */
 	/* Array pop, towards minimum-ish index in the max-free-heap. */
 	if(free = heap_pool_free_node_array_pop(&pool->free0.a))
-		return assert(free), PP_(data)(pool->slots.data[0]) + *free;
+		return PP_(occupy)(chunk0, *free), PP_(data)(chunk0) + *free;
 	/* The free-heap is empty; guaranteed by <fn:<PP>buffer>. */
-	chunk0 = pool->slots.data[0];
 	assert(chunk0->size < pool->capacity0);
-	return PP_(data)(chunk0) + chunk0->size++;
+	return PP_(occupy)(chunk0, chunk0->size), PP_(data)(chunk0) + chunk0->size++;
+}
+
+/** This pointer is constant until it gets removed.
+ @return A pointer to a new uninitialized element from `pool`.
+ @throws[ERANGE, malloc] @order amortised O(1) @allow */
+static PP_(type) *P_(pool_new)(struct P_(pool) *const pool) {
+	assert(pool);
+	if(!pool->free_list && !PP_(buffer)(pool, 1)) return 0;
+	return PP_(new0)(pool);
+}
+
+/* Forward-declare for undoing. */
+static int P_(pool_remove_n)(struct P_(pool) *, PP_(type) *const *, size_t);
+
+/** Puts `n` new uninitialized elements from `pool` in `out` with one check
+ for space. Free items in chunk-zero are used first; the rest are contiguous.
+ With `POOL_CHUNK_ALIGN` or `POOL_HANDLE`, it is one check per chunk.
+ @return Success; on failure, none are allocated. @throws[ERANGE, malloc]
+ @order \O(`n`) @allow */
+static int P_(pool_new_n)(struct P_(pool) *const pool, const size_t n,
+	PP_(type) **const out) {
+	struct pool_chunk *chunk0;
+	PP_(type) *datum;
+	size_t i = 0, m;
+	assert(pool && (!n || out));
+	while(i < n) {
+		m = n - i;
+#if defined(POOL_CHUNK_ALIGN) || defined(POOL_HANDLE) /* <!-- max */
+		if(m > PP_(chunk_max)()) m = PP_(chunk_max)();
+#endif /* max --> */
+		if(!PP_(buffer)(pool, m)) {
+			if(!P_(pool_remove_n)(pool, out, i)) assert(0);
+			return 0;
+		}
+		for(m += i; i < m && (pool->free_list || pool->free0.a.size); i++)
+			out[i] = PP_(new0)(pool);
+		chunk0 = pool->slots.data[0];
+		assert(chunk0->size + m - i <= pool->capacity0);
+		PP_(occupy_n)(chunk0, chunk0->size, m - i);
+		for(datum = PP_(data)(chunk0) + chunk0->size; i < m; i++)
+			out[i] = datum++;
+		chunk0->size = (size_t)(datum - PP_(data)(chunk0));
+	}
+	return 1;
 }
 
 /** Deletes `datum` from `pool`. Do not remove data that is not in `pool`.
@@ -280,6 +731,175 @@ static PP_(type) *P_(pool_new)(struct P_(pool) *const pool) {
 static int P_(pool_remove)(struct P_(pool) *const pool,
 	PP_(type) *const datum) { return PP_(remove)(pool, datum); }
 
+/** Recomputes the size and the free items of chunk-zero of `pool` from the
+ bitmap. Without `POOL_FREE_LIST`, the free-heap must have room for the size.
+ @order \O(`chunk-zero size`) */
+static void PP_(rebuild0)(struct P_(pool) *const pool) {
+	struct pool_chunk *const chunk0 = pool->slots.data[0];
+	size_t i;
+	while(chunk0->size && !PP_(is_live)(chunk0, chunk0->size - 1))
+		chunk0->size--;
+	PP_(forget0)(pool, chunk0->size);
+#ifdef POOL_FREE_LIST /* <!-- list: lowest at the head. */
+	for(i = chunk0->size; i; i--) if(!PP_(is_live)(chunk0, i - 1)) {
+		memcpy(PP_(data)(chunk0) + i - 1, &pool->free_list,
+			sizeof pool->free_list);
+		pool->free_list = i;
+	}
+#else /* list --><!-- heap */
+	{
+		size_t *const free = pool->free0.a.data, n = 0;
+		assert(!chunk0->size || pool->free0.a.capacity >= chunk0->size);
+		for(i = 0; i < chunk0->size; i++)
+			if(!PP_(is_live)(chunk0, i)) free[n++] = i;
+		if(n && !pool_free_heap_append(&pool->free0, n)) assert(0);
+	}
+#endif /* heap --> */
+}
+
+/** Deletes the `n` items in `data` from `pool`. Each secondary chunk has its
+ size decremented and is freed, if empty, in one pass at the end. If it is a
+ large fraction of chunk-zero, that is rebuilt once from the bitmap instead
+ of updating the free items one at a time.
+ @return Success; on failure, `pool` is unchanged. @throws[realloc]
+ @order \O(`n` \log \log `items` + `chunks`) @allow */
+static int P_(pool_remove_n)(struct P_(pool) *const pool,
+	PP_(type) *const *const data, const size_t n) {
+	struct pool_chunk *chunk0, *chunk;
+	pool_slot *s, *t, *s_end;
+	const PP_(type) *lo, *hi;
+	size_t i, n0 = 0;
+	int is_rebuild;
+	assert(pool && (!n || data && pool->slots.size));
+	if(!n) return 1;
+	chunk0 = pool->slots.data[0];
+	lo = PP_(data)(chunk0), hi = lo + pool->capacity0;
+	for(i = 0; i < n; i++) if(data[i] >= lo && data[i] < hi) n0++;
+	is_rebuild = n0 && n0 >= chunk0->size / 8;
+#ifndef POOL_FREE_LIST /* <!-- heap: reserve so it can't fail halfway. */
+	if(n0 && !pool_free_heap_buffer(&pool->free0, is_rebuild
+		? chunk0->size : n0)) return 0;
+#endif /* heap --> */
+	for(i = 0; i < n; i++) {
+		if(data[i] >= lo && data[i] < hi) {
+			if(is_rebuild) PP_(vacate)(chunk0, (size_t)(data[i] - lo));
+			else if(!PP_(remove)(pool, data[i])) assert(0);
+			continue;
+		}
+#ifdef POOL_CHUNK_ALIGN /* <!-- align */
+		chunk = PP_(chunk)(data[i]);
+#else /* align --><!-- !align */
+		chunk = pool->slots.data[PP_(slot)(pool, data[i])];
+#endif /* !align --> */
+		assert(chunk->size);
+		PP_(vacate)(chunk, (size_t)(data[i] - PP_(data)(chunk)));
+		chunk->size--;
+	}
+	for(s = t = pool->slots.data + 1, s_end = pool->slots.data
+		+ pool->slots.size; s < s_end; s++)
+		if((*s)->size) *t++ = *s; else PP_(retire)(pool, *s);
+	pool->slots.size = (size_t)(t - pool->slots.data);
+	if(is_rebuild) PP_(rebuild0)(pool);
+	return 1;
+}
+
+#ifdef POOL_HANDLE /* <!-- handle */
+
+/** @return The handle of `datum` in `pool`; it is constant until `datum` is
+ removed or moved by <fn:<P>pool_compact>.
+ @order \O(\log \log `items`); with `POOL_CHUNK_ALIGN`, \Theta(1) @allow */
+static pool_handle P_(pool_handle)(const struct P_(pool) *const pool,
+	const PP_(type) *const datum) {
+	struct pool_chunk *chunk;
+	assert(pool && pool->slots.size && datum);
+#ifdef POOL_CHUNK_ALIGN /* <!-- align */
+	chunk = PP_(chunk)(datum);
+#else /* align --><!-- !align */
+	chunk = pool->slots.data[PP_(slot)(pool, datum)];
+#endif /* !align --> */
+	assert(PP_(is_live)(chunk, (size_t)(datum - PP_(data)(chunk))));
+	return (pool_handle)((*PP_(id)(chunk) + 1) << POOL_HANDLE_BITS
+		| (size_t)(datum - PP_(data)(chunk)));
+}
+
+/** @return The item in `pool` of a `handle` from <fn:<P>pool_handle>, or null
+ if `handle` is zero. @order \Theta(1) @allow */
+static PP_(type) *P_(pool_get)(const struct P_(pool) *const pool,
+	const pool_handle handle) {
+	struct pool_chunk *chunk;
+	size_t id, idx;
+	assert(pool);
+	if(!handle) return 0;
+	id = (size_t)(handle >> POOL_HANDLE_BITS) - 1;
+	idx = (size_t)handle & (((size_t)1 << POOL_HANDLE_BITS) - 1);
+	assert(id < pool->handles.size && pool->handles.data[id]);
+	chunk = pool->handles.data[id];
+	assert(PP_(is_live)(chunk, idx));
+	return PP_(data)(chunk) + idx;
+}
+
+#endif /* handle --> */
+
+/** Moves live items in `pool` so that it takes less memory, calling
+ `relocate` with `context` for each move, if it is not null. Secondary chunks
+ that fit in the free space of chunk-zero are emptied into it, sparsest first,
+ and freed; then chunk-zero is packed down, and the pages of its unused tail
+ are given back to the system. Pointers to moved items are invalid.
+ @return The number of items moved. @order \O(`items` + `chunks`^2) @allow */
+static size_t P_(pool_compact)(struct P_(pool) *const pool,
+	const PP_(relocate_fn) relocate, void *const context) {
+	struct pool_chunk *chunk0, *chunk;
+	size_t room, moved = 0, s, best, lo, hi;
+	PP_(type) *from, *to;
+	assert(pool);
+	if(!pool->slots.size) return 0;
+	chunk0 = pool->slots.data[0];
+	room = pool->capacity0 - PP_(live0)(pool);
+	for( ; ; ) { /* Empty the sparsest secondary chunk that fits. */
+		for(best = 0, s = 1; s < pool->slots.size; s++)
+			if(pool->slots.data[s]->size <= room && (!best
+				|| pool->slots.data[s]->size < pool->slots.data[best]->size))
+				best = s;
+		if(!best) break;
+		chunk = pool->slots.data[best];
+		room -= chunk->size, moved += chunk->size;
+		for(lo = 0; chunk->size; lo++) {
+			if(!PP_(is_live)(chunk, lo)) continue;
+			from = PP_(data)(chunk) + lo, to = PP_(new0)(pool);
+			memcpy(to, from, sizeof *to);
+			if(relocate) relocate(context, from, to);
+			chunk->size--;
+		}
+		pool_slot_array_remove(&pool->slots, pool->slots.data + best);
+		PP_(retire)(pool, chunk);
+	}
+	/* Move the highest live in chunk-zero to the lowest free. */
+	for(lo = 0, hi = chunk0->size; ; lo++, hi--) {
+		while(lo < hi && PP_(is_live)(chunk0, lo)) lo++;
+		while(lo < hi && !PP_(is_live)(chunk0, hi - 1)) hi--;
+		if(lo >= hi) break;
+		from = PP_(data)(chunk0) + hi - 1, to = PP_(data)(chunk0) + lo;
+		memcpy(to, from, sizeof *to);
+		PP_(occupy)(chunk0, lo), PP_(vacate)(chunk0, hi - 1);
+		if(relocate) relocate(context, from, to);
+		moved++;
+	}
+	PP_(forget0)(pool, lo);
+#ifdef MADV_DONTNEED /* <!-- advise: it's only advice; ignore errors. */
+	{
+		const size_t page = POOL_PAGE;
+		char *const begin = (char *)(void *)(PP_(data)(chunk0) + lo),
+			*const end = (char *)(void *)PP_(bitmap)(chunk0),
+			*const a = begin + ((page - (size_t)((unsigned long)begin
+			& (page - 1))) & (page - 1)),
+			*const b = end - (size_t)((unsigned long)end & (page - 1));
+		if(a < b) { const int e = errno; madvise(a, (size_t)(b - a),
+			MADV_DONTNEED), errno = e; }
+	}
+#endif /* advise --> */
+	return moved;
+}
+
 /** Removes all from `pool`, but keeps it's active state, only freeing the
  smaller blocks. @order \O(\log `items`) @allow */
 static void P_(pool_clear)(struct P_(pool) *const pool) {
@@ -287,35 +907,62 @@ static void P_(pool_clear)(struct P_(pool) *const pool) {
 	assert(pool);
 	if(!pool->slots.size) { assert(!pool->free0.a.size); return; }
 	for(i = pool->slots.data + 1, i_end = i - 1 + pool->slots.size;
-		i < i_end; i++) assert(*i), free(*i);
-	pool->slots.data[0]->size = 0;
+		i < i_end; i++) assert(*i), PP_(retire)(pool, *i);
 	pool->slots.size = 1;
-	pool_free_heap_clear(&pool->free0);
+	memset(PP_(bitmap)(pool->slots.data[0]), 0,
+		pool_words(pool->capacity0) * sizeof(pool_word));
+	PP_(forget0)(pool, 0);
 }
 
-/* <!-- iterate interface: it's not actually possible to iterate though given
- the information that we have, but placing it here for testing purposes.
- Iterates through the zero-slot, ignoring the free list. Do not call. */
+/** Loads `pool` into `it`, before the first live item. @order \Theta(1)
+ @allow */
+static void P_(pool_begin)(struct P_(pool_iterator) *const it,
+	const struct P_(pool) *const pool) {
+	assert(it && pool);
+	it->pool = pool, it->slot = 0, it->word = 0;
+	it->slots = pool->slots.size;
+	it->bits = pool->slots.size ? PP_(bitmap)(pool->slots.data[0])[0] : 0;
+}
+
+/** Advances `it` to the next live item, skipping free ones a word of the
+ occupancy bitmap at a time. It goes through chunk-zero, then the rest in
+ address order. The item most recently returned may be removed, but the pool
+ must not be otherwise modified while iterating.
+ @return The next item or null when there are no more.
+ @order \O(`capacity` / `POOL_WORD_BITS`) over all the items @allow */
+static PP_(type) *P_(pool_next)(struct P_(pool_iterator) *const it) {
+	const struct P_(pool) *pool;
+	size_t bit;
+	assert(it && it->pool);
+	pool = it->pool;
+	while(!it->bits) {
+		/* The chunk emptied and was freed; the next moved into its slot. */
+		if(pool->slots.size < it->slots)
+			it->slots = pool->slots.size, it->word = 0;
+		else if(it->slot >= pool->slots.size) return 0;
+		else if(++it->word >= pool_words(pool->slots.data[it->slot]->capacity))
+			it->slot++, it->word = 0;
+		if(it->slot >= pool->slots.size) return 0;
+		it->bits = PP_(bitmap)(pool->slots.data[it->slot])[it->word];
+	}
+	bit = pool_lowest(it->bits), it->bits &= it->bits - 1;
+	return PP_(data)(pool->slots.data[it->slot])
+		+ it->word * POOL_WORD_BITS + bit;
+}
+
+/* <!-- iterate interface */
 #define BOX_ITERATE
 
 struct PP_(iterator);
-struct PP_(iterator) { struct pool_chunk *chunk0; size_t i; };
+struct PP_(iterator) { struct P_(pool_iterator) p; };
 
 /** Loads `pool` into `it`. @implements begin */
 static void PP_(begin)(struct PP_(iterator) *const it,
-	const struct P_(pool) *const pool) {
-	assert(it && pool);
-	if(pool->slots.size) it->chunk0 = pool->slots.data[0];
-	else it->chunk0 = 0;
-	it->i = 0;
-}
+	const struct P_(pool) *const pool) { P_(pool_begin)(&it->p, pool); }
 
 /** Advances `it`. @implements next */
-static const PP_(type) *PP_(next)(struct PP_(iterator) *const it) {
-	assert(it);
-	return it->chunk0 && it->i < it->chunk0->size
-		? PP_(data)(it->chunk0) + it->i++ : 0;
-}
+static const PP_(type) *PP_(next)(struct PP_(iterator) *const it)
+	{ return P_(pool_next)(&it->p); }
 
 /* iterate --> */
 
@@ -334,8 +981,12 @@ static const char *(*PP_(pool_to_string))(const struct P_(pool) *);
 static void PP_(unused_base_coda)(void);
 static void PP_(unused_base)(void) {
 	P_(pool)(0); P_(pool_)(0); P_(pool_buffer)(0, 0); P_(pool_new)(0);
-	P_(pool_remove)(0, 0); P_(pool_clear)(0); PP_(begin)(0, 0);
-	PP_(next)(0); PP_(unused_base_coda)();
+	P_(pool_new_n)(0, 0, 0); P_(pool_remove)(0, 0); P_(pool_remove_n)(0, 0, 0);
+	P_(pool_compact)(0, 0, 0); P_(pool_clear)(0); P_(pool_begin)(0, 0);
+#ifdef POOL_HANDLE /* <!-- handle */
+	P_(pool_handle)(0, 0); P_(pool_get)(0, 0);
+#endif /* handle --> */
+	P_(pool_next)(0); PP_(begin)(0, 0); PP_(next)(0); PP_(unused_base_coda)();
 }
 static void PP_(unused_base_coda)(void) { PP_(unused_base)(); }
 
@@ -386,6 +1037,22 @@ static const char *(*PP_(pool_to_string))(const struct P_(pool) *)
 #ifdef POOL_TEST
 #undef POOL_TEST
 #endif
+#ifdef POOL_ALLOC
+#undef POOL_ALLOC
+#undef POOL_REALLOC
+#undef POOL_FREE
+#undef POOL_ALLOC_CONTEXT
+#endif
+#ifdef POOL_CHUNK_ALIGN
+#undef POOL_CHUNK_ALIGN
+#endif
+#ifdef POOL_FREE_LIST
+#undef POOL_FREE_LIST
+#endif
+#ifdef POOL_HANDLE
+#undef POOL_HANDLE
+#undef POOL_HANDLE_BITS
+#endif
 #undef BOX_
 #undef BOX_CONTAINER
 #undef BOX_CONTENTS
@@ -0,0 +1,128 @@
+#if defined(QUOTE) || defined(QUOTE_)
+#error QUOTE_? cannot be defined.
+#endif
+#define QUOTE_(name) #name
+#define QUOTE(name) QUOTE_(name)
+
+/* `EXTERNAL_TEST` must be a function that implements <typedef:<PA>biaction>. */
+static void (*PX_(filler))(PX_(node) *, void *) = (EXTERNAL_TEST);
+
+/** @return Whether `a` and `b` are of equal priority. */
+static int PX_(equal)(const PX_(node) *const a, const PX_(node) *const b) {
+	const PX_(priority) pa = PXH_(get_priority)(a), pb = PXH_(get_priority)(b);
+	return PX_(compare)(pa, pb) <= 0 && PX_(compare)(pb, pa) <= 0;
+}
+
+/** Makes sure `x` is in a valid state. */
+static void PX_(valid)(const struct X_(external) *const x) {
+	const struct PX_(run) *r, *r_end;
+	size_t size;
+	if(!x) return;
+	assert(x->insert.a.size <= PX_(capacity)(x)
+		&& x->merge.a.size == x->runs.size);
+	size = x->insert.a.size;
+	for(r = x->runs.data, r_end = r + x->runs.size; r < r_end; r++) {
+		assert(r->fp && r->cursor < r->size && r->size <= PX_(block)(x)
+			&& (r + 1 == r_end || r->level >= r[1].level));
+		size += r->size - r->cursor + r->unread;
+	}
+	assert(size == x->size);
+}
+
+/** Checks `x`, with a budget of `budget` bytes in `dir`, against an ordinary
+ heap, adding and popping at random with `param` to the filler. */
+static void PX_(test_reference)(const size_t budget, const char *const dir,
+	void *const param) {
+	struct X_(external) x = EXTERNAL_IDLE;
+	struct X_(external_heap) ref = HEAP_IDLE;
+	const size_t test_size = 40000;
+	PX_(node) add, *a, *b;
+	size_t i, most = 0, levels = 0;
+	X_(external_tune)(&x, budget, budget / 16, dir);
+	errno = 0;
+	for(i = 0; i < test_size; i++) {
+		if(!(i % 97)) PX_(valid)(&x);
+		if(x.runs.size && x.runs.data[0].level > levels)
+			levels = x.runs.data[0].level;
+		if(x.size > most) most = x.size;
+		if(rand() % 4) {
+			PX_(filler)(&add, param);
+			if(!X_(external_add)(&x, add) || !X_(external_heap_add)(&ref, add))
+				{ perror("external"); assert(0); break; }
+		} else {
+			a = X_(external_peek)(&x), b = X_(external_heap_peek)(&ref);
+			assert(!a == !b);
+			if(!a) continue;
+			assert(PX_(equal)(a, b));
+			X_(external_pop)(&x), X_(external_heap_pop)(&ref);
+		}
+		assert(X_(external_size)(&x) == ref.a.size);
+	}
+	printf("External in %s, budget %lu bytes, held at most %lu bytes; %lu runs"
+		" in %lu levels.\n", dir ? dir : "tmpfile", (unsigned long)budget,
+		(unsigned long)(most * sizeof(PX_(node))), (unsigned long)x.runs.size,
+		(unsigned long)levels + 1);
+	assert(most * sizeof(PX_(node)) > 40 * budget && levels);
+	PX_(valid)(&x);
+	while((a = X_(external_peek)(&x))) {
+		b = X_(external_heap_peek)(&ref);
+		assert(b && PX_(equal)(a, b));
+		assert(X_(external_peek_value)(&x) == PXH_(get_value)(a));
+		X_(external_pop)(&x), X_(external_heap_pop)(&ref);
+	}
+	assert(!ref.a.size && !X_(external_size)(&x) && !x.runs.size
+		&& !X_(external_pop)(&x) && !errno);
+	X_(external_)(&x);
+	X_(external_heap_)(&ref);
+}
+
+/** A merge that fails on a run that can not be rewound loses it; the next
+ <fn:<X>external_pop> reports it. */
+static void PX_(test_lost)(void *const param) {
+	struct X_(external) x = EXTERNAL_IDLE;
+	const size_t budget = sizeof(PX_(node)) * 64;
+	PX_(node) add;
+	FILE *fp;
+	size_t i;
+	X_(external_tune)(&x, budget, budget / 16, 0);
+	for(i = 0; x.runs.size < 2; i++) {
+		PX_(filler)(&add, param);
+		if(!X_(external_add)(&x, add)) { assert(0); goto finally; }
+	}
+	assert(x.runs.size == 2 && x.runs.data[1].unread);
+	/* The rest of the second run is gone from under it. */
+	if(!(fp = tmpfile())) { assert(0); goto finally; }
+	fseek(fp, ftell(x.runs.data[1].fp), SEEK_SET);
+	fclose(x.runs.data[1].fp), x.runs.data[1].fp = fp;
+	errno = 0;
+	assert(!PX_(merge_runs)(&x, 0) && x.runs.size == 1 && x.error);
+	PX_(remerge)(&x, 0);
+	PX_(valid)(&x);
+	errno = 0;
+	X_(external_pop)(&x);
+	assert(errno && !x.error);
+	errno = 0;
+	X_(external_pop)(&x);
+	assert(!errno);
+finally:
+	X_(external_)(&x);
+}
+
+/** Will be tested on stdout. Requires `EXTERNAL_TEST` and not `NDEBUG`.
+ @param[dir] A directory for temporary files, or null for `tmpfile`.
+ @param[param] The `void *` parameter in `EXTERNAL_TEST`. Can be null. @allow */
+static void X_(external_test)(const char *const dir, void *const param) {
+	printf("<" QUOTE(EXTERNAL_NAME) ">external"
+		" of priority type <" QUOTE(EXTERNAL_TYPE) ">"
+		" was created using:"
+		" EXTERNAL_COMPARE<" QUOTE(EXTERNAL_COMPARE) ">;"
+		" EXTERNAL_TEST <" QUOTE(EXTERNAL_TEST) ">;"
+		" testing:\n");
+	PX_(test_reference)(sizeof(PX_(node)) * 64, dir, param);
+	PX_(test_reference)(sizeof(PX_(node)) * 200, 0, param);
+	PX_(test_lost)(param);
+	fprintf(stderr, "Done tests of <" QUOTE(EXTERNAL_NAME) ">external.\n\n");
+}
+
+#undef QUOTE
+#undef QUOTE_
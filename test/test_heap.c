@@ -5,8 +5,10 @@
 
  @std C89/90 */
 
+#define _GNU_SOURCE /* `mmap` `mremap` in <../src/alloc.h>; else `malloc`. */
 #include <stdlib.h> /* EXIT malloc free rand */
 #include <stdio.h>  /* *printf */
+#include <string.h> /* memmove */
 #include "orcish.h"
 
 
@@ -43,10 +45,315 @@ static void orc_to_string(const struct orc_heap_node *const node,
 	sprintf(*a, "%u%.9s", node->priority, node->value->name);
 }
 
+#include "../src/alloc.h"
+
+/** Counts the blocks that are live from `test_alloc` with this context. */
+struct test_count { size_t live; };
+static struct test_count test_count;
+/** @return Whether `data` is aligned for <fn:alloc_aligned>. */
+static int test_is_aligned(const void *const data)
+	{ return !((unsigned long)data & (ALLOC_ALIGN - 1)); }
+static void *test_alloc(void *const context, const size_t size) {
+	struct test_count *const count = context;
+	void *const data = alloc_aligned(0, size);
+	assert(count && test_is_aligned(data));
+	if(data) count->live++;
+	return data;
+}
+static void *test_realloc(void *const context, void *const data,
+	const size_t old_size, const size_t size) {
+	void *const next = alloc_aligned_realloc(0, data, old_size, size);
+	assert(context && data && test_is_aligned(next));
+	return next;
+}
+static void test_free(void *const context, void *const data,
+	const size_t size) {
+	struct test_count *const count = context;
+	assert(count && count->live && data);
+	count->live--;
+	alloc_aligned_free(0, data, size);
+}
+
 #define POOL_NAME orc
 #define POOL_TYPE struct orc
+#define POOL_ALLOC &test_alloc
+#define POOL_REALLOC &test_realloc
+#define POOL_FREE &test_free
+#define POOL_ALLOC_CONTEXT &test_count
+#include "pool.h"
+
+#define POOL_NAME plain
+#define POOL_TYPE struct orc
 #include "pool.h"
 
+#define POOL_NAME block
+#define POOL_TYPE struct orc
+#define POOL_CHUNK_ALIGN 4096
+#include "pool.h"
+
+#define POOL_NAME list
+#define POOL_TYPE struct orc
+#define POOL_FREE_LIST
+#include "pool.h"
+
+#define POOL_NAME blocklist
+#define POOL_TYPE struct orc
+#define POOL_CHUNK_ALIGN 4096
+#define POOL_FREE_LIST
+#include "pool.h"
+
+/** Type-erased pool for <fn:test_churn>. */
+struct test_pool {
+	const char *name;
+	struct orc *(*new)(void *);
+	int (*remove)(void *, struct orc *);
+	size_t (*sweep)(void *, unsigned *, int);
+	void *pool;
+	const struct pool_slot_array *slots;
+};
+
+/** Random churn in `p`; live items must be untouched, and iteration must see
+ exactly them. */
+static void test_churn(const struct test_pool *const p) {
+	struct orc *live[3000];
+	unsigned tag[3000], x, y;
+	size_t i, j, size = 0, chunks = 0;
+	for(i = 0; i < 20000; i++) {
+		if(!(i % 997)) {
+			for(x = 0, j = 0; j < size; j++) x ^= tag[j];
+			assert(p->sweep(p->pool, &y, 0) == size && x == y);
+		}
+		if(size < sizeof live / sizeof *live && (!size || rand() % 3)) {
+			if(!(live[size] = p->new(p->pool))) { assert(0); break; }
+			live[size]->health = tag[size] = (unsigned)i, size++;
+		} else {
+			const size_t r = (size_t)rand() % size;
+			struct orc *const dead = live[r];
+			assert(dead->health == tag[r]);
+			live[r] = live[--size], tag[r] = tag[size];
+			if(!p->remove(p->pool, dead)) { assert(0); break; }
+		}
+		if(p->slots->size > chunks) chunks = p->slots->size;
+	}
+	assert(chunks > 2);
+	/* Expire the odd ones while iterating. */
+	for(j = 0; j < size; ) if(tag[j] & 1) live[j] = live[--size],
+		tag[j] = tag[size]; else j++;
+	for(x = 0, j = 0; j < size; j++) x ^= tag[j];
+	p->sweep(p->pool, &y, 1);
+	assert(p->sweep(p->pool, &y, 0) == size && x == y);
+	while(size) {
+		assert(live[size - 1]->health == tag[size - 1]);
+		if(!p->remove(p->pool, live[--size])) { assert(0); break; }
+	}
+	assert(p->slots->size == 1);
+	fprintf(stderr, "Done tests of <%s>pool with %lu chunks.\n\n", p->name,
+		(unsigned long)chunks);
+}
+
+/** Iterates over `pool`, a <tag:<P>pool> of orcs, <fn:<P>pool_begin> and
+ <fn:<P>pool_next>, removing the odd orcs if `is_expire`, otherwise, putting
+ the exclusive-or of the health in `x`. @return The number visited. */
+#define TEST_SWEEP(P) \
+static size_t test_##P##_sweep(void *const pool, unsigned *const x, \
+	const int is_expire) { \
+	struct P##_pool_iterator it; \
+	struct orc *orc; \
+	size_t n = 0; \
+	*x = 0; \
+	for(P##_pool_begin(&it, pool); orc = P##_pool_next(&it); n++) { \
+		*x ^= orc->health; \
+		if(is_expire && orc->health & 1 && !P##_pool_remove(pool, orc)) \
+			assert(0); \
+	} \
+	return n; \
+}
+TEST_SWEEP(block)
+TEST_SWEEP(list)
+TEST_SWEEP(blocklist)
+TEST_SWEEP(plain)
+#undef TEST_SWEEP
+
+/** Bulk allocates from and frees to a new <tag:<P>pool> of orcs, in random
+ order, checking with <fn:test_<P>_sweep>. */
+#define TEST_BULK(P) \
+static void test_##P##_bulk(void) { \
+	struct P##_pool pool = POOL_IDLE; \
+	static struct orc *orc[6000]; \
+	struct orc *temp; \
+	unsigned x, y; \
+	size_t i, r; \
+	if(!P##_pool_new_n(&pool, 5000, orc)) { assert(0); return; } \
+	for(i = 0; i < 5000; i++) orc[i]->health = (unsigned)i; \
+	for(i = 0; i < 5000; i++) r = (size_t)rand() % 5000, \
+		temp = orc[i], orc[i] = orc[r], orc[r] = temp; \
+	if(!P##_pool_remove_n(&pool, orc, 100) \
+		|| !P##_pool_remove_n(&pool, orc + 100, 2400)) assert(0); \
+	for(x = 0, i = 2500; i < 5000; i++) x ^= orc[i]->health; \
+	assert(test_##P##_sweep(&pool, &y, 0) == 2500 && x == y); \
+	memmove(orc + 3500, orc + 2500, sizeof *orc * 2500); \
+	if(!P##_pool_new_n(&pool, 3500, orc)) { assert(0); return; } \
+	for(i = 0; i < 3500; i++) orc[i]->health = (unsigned)i + 5000, \
+		x ^= orc[i]->health; \
+	assert(test_##P##_sweep(&pool, &y, 0) == 6000 && x == y); \
+	if(!P##_pool_remove_n(&pool, orc, 6000)) assert(0); \
+	assert(pool.slots.size == 1 && !test_##P##_sweep(&pool, &y, 0)); \
+	P##_pool_(&pool); \
+}
+TEST_BULK(plain)
+TEST_BULK(block)
+TEST_BULK(list)
+#undef TEST_BULK
+
+static struct orc *test_plain_new(void *const pool)
+	{ return plain_pool_new(pool); }
+static int test_plain_remove(void *const pool, struct orc *const orc)
+	{ return plain_pool_remove(pool, orc); }
+static struct orc *test_block_new(void *const pool)
+	{ return block_pool_new(pool); }
+static int test_block_remove(void *const pool, struct orc *const orc)
+	{ return block_pool_remove(pool, orc); }
+static struct orc *test_list_new(void *const pool)
+	{ return list_pool_new(pool); }
+static int test_list_remove(void *const pool, struct orc *const orc)
+	{ return list_pool_remove(pool, orc); }
+static struct orc *test_blocklist_new(void *const pool)
+	{ return blocklist_pool_new(pool); }
+static int test_blocklist_remove(void *const pool, struct orc *const orc)
+	{ return blocklist_pool_remove(pool, orc); }
+
+/** Churns the pools that have options. */
+static void test_pools(void) {
+	struct plain_pool plain = POOL_IDLE;
+	struct block_pool block = POOL_IDLE;
+	struct list_pool list = POOL_IDLE;
+	struct blocklist_pool blocklist = POOL_IDLE;
+	struct test_pool p;
+	p.name = "plain", p.new = &test_plain_new, p.remove = &test_plain_remove,
+		p.sweep = &test_plain_sweep, p.pool = &plain, p.slots = &plain.slots,
+		test_churn(&p);
+	{ /* Buffering retires chunk-zero with holes in it. */
+		struct orc *orc[20];
+		unsigned x;
+		size_t i;
+		for(i = 0; i < 20; i++) orc[i] = plain_pool_new(&plain),
+			assert(orc[i]), orc[i]->health = (unsigned)i;
+		for(i = 1; i < 19; i += 2) if(!plain_pool_remove(&plain, orc[i]))
+			assert(0);
+		if(!plain_pool_buffer(&plain, plain.capacity0 + 1)) assert(0);
+		assert(test_plain_sweep(&plain, &x, 0) == 11 && !plain.free0.a.size);
+		for(i = 0; i < 20; i += 2) if(!plain_pool_remove(&plain, orc[i]))
+			assert(0);
+		if(!plain_pool_remove(&plain, orc[19])) assert(0);
+		assert(plain.slots.size == 1 && !test_plain_sweep(&plain, &x, 0));
+	}
+	plain_pool_(&plain);
+	p.name = "block", p.new = &test_block_new, p.remove = &test_block_remove,
+		p.sweep = &test_block_sweep, p.pool = &block, p.slots = &block.slots,
+		test_churn(&p);
+	assert(!block.slots.data[0]->size);
+	block_pool_(&block);
+	p.name = "list", p.new = &test_list_new, p.remove = &test_list_remove,
+		p.sweep = &test_list_sweep, p.pool = &list, p.slots = &list.slots,
+		test_churn(&p);
+	list_pool_(&list);
+	p.name = "blocklist", p.new = &test_blocklist_new,
+		p.remove = &test_blocklist_remove, p.sweep = &test_blocklist_sweep,
+		p.pool = &blocklist, p.slots = &blocklist.slots, test_churn(&p);
+	blocklist_pool_(&blocklist);
+	test_plain_bulk(), test_block_bulk(), test_list_bulk();
+	fprintf(stderr, "Done tests of bulk pools.\n\n");
+}
+
+#define MAGAZINE_NAME orc
+#define MAGAZINE_TYPE struct orc
+#define MAGAZINE_CAPACITY 4
+#include "magazine.h"
+
+/** Orcs that are passed between the threads of <fn:test_magazine>. */
+static struct {
+	pthread_mutex_t lock;
+	size_t size;
+	struct orc *orc[64];
+	unsigned tag[64];
+} test_exchange = { PTHREAD_MUTEX_INITIALIZER, 0, {0}, {0} };
+
+/** Churns a cache of the magazine `vm`, handing out and removing orcs that
+ other threads allocated. */
+static void *test_magazine_thread(void *const vm) {
+	struct orc_magazine_cache *const cache = orc_magazine_acquire(vm);
+	struct orc *live[100], *orc;
+	unsigned tag[100], seed = (unsigned)(size_t)cache, r, t;
+	size_t i, size = 0;
+	if(!cache) { assert(0); return 0; }
+	for(i = 0; i < 20000; i++) {
+		seed = seed * 1103515245u + 12345u, r = (seed >> 16) % 4;
+		if(r == 0 && size < sizeof live / sizeof *live) {
+			if(!(live[size] = orc_magazine_new(cache))) { assert(0); break; }
+			live[size]->health = tag[size] = seed, size++;
+		} else if(r == 1 && size) {
+			pthread_mutex_lock(&test_exchange.lock);
+			if(test_exchange.size < sizeof test_exchange.orc
+				/ sizeof *test_exchange.orc) size--,
+				test_exchange.orc[test_exchange.size] = live[size],
+				test_exchange.tag[test_exchange.size++] = tag[size];
+			pthread_mutex_unlock(&test_exchange.lock);
+		} else if(r == 2) {
+			orc = 0;
+			pthread_mutex_lock(&test_exchange.lock);
+			if(test_exchange.size) orc = test_exchange.orc[--test_exchange.size],
+				t = test_exchange.tag[test_exchange.size];
+			pthread_mutex_unlock(&test_exchange.lock);
+			if(!orc) continue;
+			assert(orc->health == t);
+			if(!orc_magazine_remove(cache, orc)) { assert(0); break; }
+		} else if(size) {
+			const size_t k = (seed >> 8) % size;
+			assert(live[k]->health == tag[k]);
+			orc = live[k], live[k] = live[--size], tag[k] = tag[size];
+			if(!orc_magazine_remove(cache, orc)) { assert(0); break; }
+		}
+	}
+	while(size) {
+		assert(live[size - 1]->health == tag[size - 1]);
+		if(!orc_magazine_remove(cache, live[--size])) { assert(0); break; }
+	}
+	if(!orc_magazine_release(cache)) assert(0);
+	return 0;
+}
+
+/** Threads share a magazine pool, freeing each other's orcs. */
+static void test_magazine(void) {
+	struct orc_magazine m = MAGAZINE_IDLE;
+	struct orc_magazine_cache *cache;
+	pthread_t thread[4];
+	size_t i, caches = 0;
+	for(i = 0; i < sizeof thread / sizeof *thread; i++)
+		if(pthread_create(thread + i, 0, &test_magazine_thread, &m))
+			{ assert(0); exit(EXIT_FAILURE); }
+	for(i = 0; i < sizeof thread / sizeof *thread; i++)
+		pthread_join(thread[i], 0);
+	if(!(cache = orc_magazine_acquire(&m))) { assert(0); return; }
+	while(test_exchange.size) {
+		struct orc *const orc = test_exchange.orc[--test_exchange.size];
+		assert(orc->health == test_exchange.tag[test_exchange.size]);
+		if(!orc_magazine_remove(cache, orc)) { assert(0); break; }
+	}
+	if(!orc_magazine_release(cache)) assert(0);
+	/* Frees to released caches wait on the remote list; acquire them all. */
+	for(cache = m.caches; cache; cache = cache->next)
+		assert(!cache->is_active), caches++;
+	for(i = 0; i < caches; i++) if(!orc_magazine_acquire(&m)) assert(0);
+	for(cache = m.caches; cache; cache = cache->next) {
+		if(!orc_magazine_release(cache)) assert(0);
+		assert(!cache->size && !cache->remote);
+	}
+	assert(m.pool.slots.size == 1 && !m.pool.slots.data[0]->size);
+	orc_magazine_(&m);
+	fprintf(stderr, "Done tests of <orc>magazine with %lu caches.\n\n",
+		(unsigned long)caches);
+}
+
 static void test_orc(struct orc_heap_node *node, void *const vpool) {
 	struct orc *orc = orc_pool_new(vpool);
 	if(!orc) { assert(0); exit(EXIT_FAILURE); }
@@ -57,6 +364,471 @@ static void test_orc(struct orc_heap_node *node, void *const vpool) {
 }
 
 
+/** Points the node in the heap, `vheap`, at `from` to `to`. */
+static void test_relocate(void *const vheap, struct orc *const from,
+	struct orc *const to) {
+	struct orc_heap *const heap = vheap;
+	size_t i;
+	for(i = 0; i < heap->a.size; i++)
+		if(heap->a.data[i].value == from) { heap->a.data[i].value = to; return; }
+	assert(0);
+}
+
+/** A heap of orcs spikes and most of them die; compacting the pool leaves the
+ heap pointing at the same orcs. */
+static void test_compact(void) {
+	struct orc_pool pool = POOL_IDLE;
+	struct orc_heap heap = HEAP_IDLE;
+	struct orc_heap_node node;
+	struct orc_pool_iterator it;
+	struct orc *orc;
+	size_t i, chunks, moved, count;
+	for(i = 0; i < 5000; i++) {
+		test_orc(&node, &pool);
+		if(!orc_heap_add(&heap, node)) { assert(0); return; }
+	}
+	while(heap.a.size > 300)
+		if(!orc_pool_remove(&pool, orc_heap_pop(&heap))) assert(0);
+	chunks = pool.slots.size;
+	moved = orc_pool_compact(&pool, &test_relocate, &heap);
+	assert(chunks > 1 && pool.slots.size == 1 && moved
+		&& pool.slots.data[0]->size == heap.a.size && !pool.free0.a.size);
+	for(i = 0; i < heap.a.size; i++)
+		assert(heap.a.data[i].value->health == heap.a.data[i].priority);
+	for(count = 0, orc_pool_begin(&it, &pool); orc = orc_pool_next(&it);
+		count++);
+	assert(count == heap.a.size);
+	while(orc = orc_heap_pop(&heap)) if(!orc_pool_remove(&pool, orc)) assert(0);
+	assert(!pool.slots.data[0]->size && !orc_pool_compact(&pool, 0, 0));
+	orc_heap_(&heap), orc_pool_(&pool);
+	assert(!test_count.live);
+	fprintf(stderr, "Done tests of <orc>pool compact from %lu chunks, "
+		"%lu moved.\n\n", (unsigned long)chunks, (unsigned long)moved);
+}
+
+#define POOL_NAME tag
+#define POOL_TYPE struct orc
+#define POOL_HANDLE
+#define POOL_HANDLE_BITS 8
+#include "pool.h"
+
+#define HEAP_NAME tag
+#define HEAP_HANDLE pool_handle
+#include "../src/heap.h"
+
+/** A heap of handles into a pool of orcs, with chunks small enough that there
+ are many of them. */
+static void test_handle(void) {
+	struct tag_pool pool = POOL_IDLE;
+	struct tag_heap heap = HEAP_IDLE;
+	struct tag_heap_node node;
+	struct orc *orc;
+	unsigned last = 0;
+	size_t i, chunks;
+	for(i = 0; i < 3000; i++) {
+		if(!(orc = tag_pool_new(&pool))) { assert(0); return; }
+		orc->health = (unsigned)rand() / (RAND_MAX / 99 + 1);
+		orcish(orc->name, sizeof orc->name);
+		node.priority = orc->health, node.value = tag_pool_handle(&pool, orc);
+		assert(node.value && tag_pool_get(&pool, node.value) == orc);
+		if(!tag_heap_add(&heap, node)) { assert(0); return; }
+	}
+	chunks = pool.slots.size;
+	assert(chunks > 10 && pool.handles.size == chunks && !tag_pool_get(&pool, 0));
+	while(heap.a.size) {
+		const pool_handle h = heap.a.data[0].value;
+		orc = tag_pool_get(&pool, h);
+		assert(orc->health == heap.a.data[0].priority && orc->health >= last);
+		last = orc->health;
+		if(tag_heap_pop(&heap) != h || !tag_pool_remove(&pool, orc)) assert(0);
+	}
+	assert(pool.slots.size == 1);
+	tag_heap_(&heap), tag_pool_(&pool);
+	fprintf(stderr, "Done tests of <tag>pool with %lu chunks and handles in "
+		"%lu-byte nodes.\n\n", (unsigned long)chunks,
+		(unsigned long)sizeof node);
+}
+
+#include "../src/key.h"
+
+#define HEAP_NAME key
+#define HEAP_TYPE key_u64
+#include "../src/heap.h"
+
+/** Doubles, signed deadlines, and `(score, sequence)` through <../src/key.h>
+ in a heap with the default compare. */
+static void test_key(void) {
+	static const double special[] = { -1e300, -1.0, -4.9e-324, -0.0, 0.0,
+		4.9e-324, 1.0, 1e300 };
+	const size_t special_size = sizeof special / sizeof *special;
+	struct key_heap heap = HEAP_IDLE;
+	const unsigned seq_bits = 20;
+	double x, last;
+	long l, last_l;
+	key_u64 k;
+	size_t i;
+	for(i = 0; i + 1 < special_size; i++) {
+		k = key_double(special[i]);
+		assert(k <= key_double(special[i + 1])
+			&& key_double(key_to_double(k)) == k);
+		assert(key_float((float)special[i]) <= key_float((float)special[i + 1]));
+	}
+	assert(key_double(-0.0) == key_double(0.0)
+		&& key_float(-0.0f) == key_float(0.0f));
+	/* Doubles. */
+	for(i = 0; i < 1000; i++) {
+		x = (double)(rand() - RAND_MAX / 2) * (i & 1 ? 1e-3 : 1e20);
+		k = key_float((float)x), assert(key_float(key_to_float(k)) == k);
+		if(!key_heap_add(&heap, key_double(x))) { assert(0); return; }
+	}
+	for(last = -1e300; heap.a.size; last = x, key_heap_pop(&heap))
+		x = key_to_double(*key_heap_peek(&heap)), assert(last <= x);
+	/* Signed, in reverse. */
+	for(i = 0; i < 1000; i++) {
+		l = (long)rand() - RAND_MAX / 2;
+		if(!key_heap_add(&heap, key_reverse(key_long(l))))
+			{ assert(0); return; }
+	}
+	assert(key_to_long(key_long(LONG_MIN)) == LONG_MIN
+		&& key_to_long(key_long(LONG_MAX)) == LONG_MAX);
+	for(last_l = LONG_MAX; heap.a.size; last_l = l, key_heap_pop(&heap))
+		l = key_to_long(key_reverse(*key_heap_peek(&heap))), assert(last_l >= l);
+	/* Ties in a few scores come out first-in, first-out. */
+	for(i = 0; i < 1000; i++) {
+		x = (double)(rand() % 7) - 3.0;
+		k = key_pack(key_truncate(key_double(x), seq_bits), i, seq_bits);
+		if(!key_heap_add(&heap, k)) { assert(0); return; }
+	}
+	for(k = 0; heap.a.size; k = *key_heap_peek(&heap), key_heap_pop(&heap))
+		assert(k < heap.a.data[0] && (key_high(k, seq_bits)
+		!= key_high(heap.a.data[0], seq_bits)
+		|| key_low(k, seq_bits) < key_low(heap.a.data[0], seq_bits)));
+	key_heap_(&heap);
+	fprintf(stderr, "Done tests of order-preserving keys.\n\n");
+}
+
+static size_t test_compares;
+static int test_stats_compare(const unsigned a, const unsigned b)
+	{ return test_compares++, a > b; }
+#define HEAP_NAME stats
+#define HEAP_COMPARE &test_stats_compare
+#define HEAP_STATS
+#include "../src/heap.h"
+
+/** The counters of <tag:stats_heap> against a counting compare. */
+static void test_stats(void) {
+	struct stats_heap heap = stats_heap_idle;
+	const struct stats_heap_stats *const st = stats_heap_stats(&heap);
+	unsigned *buffer;
+	size_t i;
+	assert(!st->compares && !st->copies && !st->reallocs && !st->peak);
+	test_compares = 0;
+	for(i = 0; i < 1000; i++)
+		if(!stats_heap_add(&heap, (unsigned)rand())) { assert(0); return; }
+	assert(st->compares == test_compares && st->peak == 1000
+		&& st->copies == 1000 + st->levels && st->reallocs > 5
+		&& st->reallocs < 20 && st->realloc_bytes
+		>= sizeof *heap.a.data * heap.a.capacity);
+	for(i = 0; i < 500; i++) stats_heap_pop(&heap);
+	assert(st->compares == test_compares && st->levels > 500 * 5
+		&& st->peak == 1000);
+	stats_heap_stats_reset(&heap), test_compares = 0;
+	assert(!st->compares && !st->levels && !st->reallocs && st->peak == 500);
+	if(!(buffer = stats_heap_buffer(&heap, 1000))) { assert(0); return; }
+	for(i = 0; i < 1000; i++) buffer[i] = (unsigned)rand();
+	if(!stats_heap_append(&heap, 1000)) { assert(0); return; }
+	assert(st->compares == test_compares && st->reallocs == 1
+		&& st->peak == 1500 && st->compares < 2 * 2 * 1500);
+	stats_heap_(&heap);
+	fprintf(stderr, "Done tests of heap stats.\n\n");
+}
+
+#define HEAP_NAME trace
+#define HEAP_TRACE
+#include "../src/heap.h"
+
+/** Checks the length of a trace of <tag:trace_heap>. */
+static void test_trace(void) {
+	struct trace_heap heap = trace_heap_idle;
+	FILE *const fp = tmpfile();
+	unsigned *buffer;
+	long expect;
+	if(!fp) { perror("trace"); assert(0); return; }
+	if(!trace_heap_trace(&heap, fp)) { assert(0); return; }
+	if(!trace_heap_add(&heap, 3) || !trace_heap_add(&heap, 1)
+		|| !(buffer = trace_heap_buffer(&heap, 2))) { assert(0); return; }
+	buffer[0] = 2, buffer[1] = 0;
+	if(!trace_heap_append(&heap, 2)) { assert(0); return; }
+	assert(*trace_heap_peek(&heap) == 0);
+	trace_heap_pop(&heap), trace_heap_replace(&heap, 4);
+	/* A call that fails is not logged. */
+	errno = 0;
+	assert(!trace_heap_buffer(&heap, (size_t)-1) && errno == ERANGE);
+	errno = 0;
+	trace_heap_clear(&heap), trace_heap_trace(&heap, 0);
+	trace_heap_add(&heap, 5), trace_heap_(&heap);
+	expect = 6 /* header */ + 2 * (1 + (long)sizeof(unsigned)) /* add */
+		+ 1 + (long)sizeof(size_t) /* buffer */
+		+ 1 + (long)sizeof(size_t) + 2 * (long)sizeof(unsigned) /* append */
+		+ 1 + 1 /* peek pop */ + 1 + (long)sizeof(unsigned) /* replace */
+		+ 1 /* clear */;
+	assert(ftell(fp) == expect);
+	fclose(fp);
+	fprintf(stderr, "Done tests of heap trace of %ld bytes.\n\n", expect);
+}
+
+#define HEAP_NAME save
+#define HEAP_SAVE
+#define HEAP_SAVE_ID 1
+#include "../src/heap.h"
+
+static struct orc test_orcs[100];
+static int test_save_orc(FILE *const fp, struct orc *const orc) {
+	const size_t i = (size_t)(orc - test_orcs);
+	return fwrite(&i, sizeof i, 1, fp) == 1;
+}
+static int test_load_orc(FILE *const fp, struct orc **const orc) {
+	size_t i;
+	if(fread(&i, sizeof i, 1, fp) != 1 || i >= 100) return 0;
+	*orc = test_orcs + i;
+	return 1;
+}
+#define HEAP_NAME saveorc
+#define HEAP_VALUE struct orc
+#define HEAP_SAVE
+#define HEAP_SAVE_VALUE &test_save_orc
+#define HEAP_LOAD_VALUE &test_load_orc
+#include "../src/heap.h"
+
+/** Saves and loads <tag:save_heap> and <tag:saveorc_heap>. */
+static void test_save(void) {
+	struct save_heap a = HEAP_IDLE, b = HEAP_IDLE;
+	struct saveorc_heap oa = HEAP_IDLE, ob = HEAP_IDLE;
+	struct saveorc_heap_node node;
+	FILE *const fp = tmpfile();
+	size_t i;
+	int c;
+	if(!fp) { perror("save"); assert(0); return; }
+	for(i = 0; i < 1000; i++)
+		if(!save_heap_add(&a, (unsigned)rand())) { assert(0); return; }
+	for(i = 0; i < 100; i++) {
+		node.priority = (unsigned)rand(), node.value = test_orcs + i;
+		if(!saveorc_heap_add(&oa, node)) { assert(0); return; }
+	}
+	if(!save_heap_save(&a, fp) || !saveorc_heap_save(&oa, fp))
+		{ assert(0); return; }
+	rewind(fp);
+	if(!save_heap_load(&b, fp) || !saveorc_heap_load(&ob, fp))
+		{ assert(0); return; }
+	assert(b.a.size == 1000 && !memcmp(a.a.data, b.a.data, sizeof *a.a.data
+		* 1000) && ob.a.size == 100);
+	for(i = 0; i < 100; i++) assert(oa.a.data[i].priority
+		== ob.a.data[i].priority && oa.a.data[i].value == ob.a.data[i].value);
+	/* A corrupt priority fails the checksum and leaves it empty. */
+	fseek(fp, 4 + 5 * (long)sizeof(unsigned long) + 7, SEEK_SET);
+	c = fgetc(fp), fseek(fp, -1, SEEK_CUR), fputc(~c & 0xff, fp);
+	rewind(fp), errno = 0;
+	assert(!save_heap_load(&b, fp) && errno == EDOM && !b.a.size);
+	errno = 0;
+	fclose(fp);
+	save_heap_(&a), save_heap_(&b), saveorc_heap_(&oa), saveorc_heap_(&ob);
+	fprintf(stderr, "Done tests of heap save and load.\n\n");
+}
+
+#ifdef ALLOC_MAP_ANON /* <!-- file */
+#define HEAP_NAME file
+#define HEAP_FILE
+#include "../src/heap.h"
+#define HEAP_NAME filesize
+#define HEAP_TYPE size_t
+#define HEAP_FILE
+#include "../src/heap.h"
+
+/** Closes and opens <tag:file_heap> in a file. */
+static void test_file(void) {
+	const char *const path = "heap-file.tmp";
+	struct file_heap heap = HEAP_IDLE;
+	struct filesize_heap other = HEAP_IDLE;
+	unsigned i, last;
+	remove(path);
+	errno = 0;
+	assert(!file_heap_add(&heap, 1) && errno == EBADF && !heap.a.data);
+	errno = 0;
+	if(!file_heap_open(&heap, path)) { perror(path); assert(0); return; }
+	assert(!heap.a.size);
+	for(i = 0; i < 10000; i++)
+		if(!file_heap_add(&heap, (unsigned)rand())) { assert(0); goto finally; }
+	file_heap_(&heap);
+	if(!file_heap_open(&heap, path)) { assert(0); goto finally; }
+	assert(heap.a.size == 10000 && heap.a.capacity >= 10000);
+	for(last = 0, i = 0; i < 5000; i++) {
+		const unsigned p = *file_heap_peek(&heap);
+		assert(p >= last), last = p;
+		file_heap_pop(&heap);
+	}
+	if(!file_heap_sync(&heap)) { assert(0); goto finally; }
+	file_heap_(&heap);
+	if(!file_heap_open(&heap, path)) { assert(0); goto finally; }
+	assert(heap.a.size == 5000 && *file_heap_peek(&heap) >= last);
+	file_heap_clear(&heap), file_heap_(&heap);
+	if(!file_heap_open(&heap, path)) { assert(0); goto finally; }
+	assert(!heap.a.size);
+	file_heap_(&heap);
+	/* A different type of heap can not open it. */
+	if(sizeof(size_t) != sizeof(unsigned))
+		assert(!filesize_heap_open(&other, path) && errno == EDOM);
+	errno = 0;
+finally:
+	file_heap_(&heap), filesize_heap_(&other);
+	remove(path);
+	fprintf(stderr, "Done tests of heap file.\n\n");
+}
+#endif /* file --> */
+
+#define HEAP_NAME threads
+#define HEAP_THREADS 4
+#include "../src/heap.h"
+
+/** Heapifies <tag:threads_heap> on threads, which gives the same array as
+ <tag:int_heap> on one. */
+static void test_threads(void) {
+	static const size_t sizes[] = { 1, 100, 150000, 262144, 1000000 };
+	struct threads_heap a = HEAP_IDLE;
+	struct int_heap b = HEAP_IDLE;
+	unsigned *x, *y, last = 0;
+	size_t s, i;
+	for(s = 0; s < sizeof sizes / sizeof *sizes; s++) {
+		const size_t n = sizes[s];
+		if(!(x = threads_heap_buffer(&a, n)) || !(y = int_heap_buffer(&b, n)))
+			{ assert(0); goto finally; }
+		for(i = 0; i < n; i++) x[i] = y[i] = (unsigned)rand();
+		if(!threads_heap_append(&a, n) || !int_heap_append(&b, n))
+			{ assert(0); goto finally; }
+		assert(a.a.size == b.a.size
+			&& !memcmp(a.a.data, b.a.data, sizeof *a.a.data * a.a.size));
+	}
+	for(i = 0; a.a.size; i++) {
+		const unsigned p = *threads_heap_peek(&a);
+		assert(last <= p), last = p;
+		threads_heap_pop(&a);
+	}
+	fprintf(stderr, "Done tests of heap threads on %lu nodes.\n\n",
+		(unsigned long)i);
+finally:
+	threads_heap_(&a), int_heap_(&b);
+}
+
+/** Drains <tag:threads_heap> in the order that <tag:int_heap> pops. */
+static void test_drain(void) {
+	static const size_t sizes[] = { 0, 1, 17, 1000, 50000, 100000, 300001 };
+	struct threads_heap a = HEAP_IDLE;
+	struct int_heap b = HEAP_IDLE;
+	unsigned *sorted = 0, *x, *y;
+	size_t s, i;
+	for(s = 0; s < sizeof sizes / sizeof *sizes; s++) {
+		const size_t n = sizes[s];
+		unsigned *const next = realloc(sorted, sizeof *sorted * (n + !n));
+		if(!next) { assert(0); goto finally; }
+		sorted = next;
+		if((!(x = threads_heap_buffer(&a, n)) && n)
+			|| (!(y = int_heap_buffer(&b, n)) && n))
+			{ assert(0); goto finally; }
+		for(i = 0; i < n; i++) x[i] = y[i] = (unsigned)rand() & 0xfff;
+		if(!threads_heap_append(&a, n) || !int_heap_append(&b, n))
+			{ assert(0); goto finally; }
+		assert(threads_heap_drain(&a, sorted) == n && !a.a.size);
+		for(i = 0; i < n; i++)
+			assert(sorted[i] == *int_heap_peek(&b)), int_heap_pop(&b);
+		assert(!b.a.size);
+	}
+	fprintf(stderr, "Done tests of heap drain.\n\n");
+finally:
+	free(sorted), threads_heap_(&a), int_heap_(&b);
+}
+
+#define HEAP_NAME wal
+#define HEAP_SAVE
+#define HEAP_JOURNAL
+#include "../src/heap.h"
+
+/** @return Whether `a` and `b` have the same array. */
+static int wal_equal(const struct wal_heap *const a,
+	const struct wal_heap *const b) {
+	return a->a.size == b->a.size && (!a->a.size
+		|| !memcmp(a->a.data, b->a.data, sizeof *a->a.data * a->a.size));
+}
+
+/** Journals <tag:wal_heap> and recovers it. */
+static void test_journal(void) {
+	const char *const path = "heap-wal.tmp";
+	struct wal_heap a = wal_heap_idle, b = wal_heap_idle, c = wal_heap_idle;
+	FILE *const journal = tmpfile(), *const other = tmpfile(),
+		*const old = tmpfile();
+	FILE *snapshot = 0;
+	unsigned *buffer, i;
+	long length;
+	if(!journal || !other || !old)
+		{ perror("journal"); assert(0); goto finally; }
+	remove(path);
+	/* Every change that is committed comes back. */
+	if(!wal_heap_journal(&a, journal, 16)) { assert(0); goto finally; }
+	for(i = 0; i < 100; i++)
+		if(!wal_heap_add(&a, (unsigned)rand())) { assert(0); goto finally; }
+	for(i = 0; i < 30; i++) wal_heap_pop(&a);
+	if(!(buffer = wal_heap_buffer(&a, 50))) { assert(0); goto finally; }
+	for(i = 0; i < 50; i++) buffer[i] = (unsigned)rand();
+	if(!wal_heap_append(&a, 50)) { assert(0); goto finally; }
+	wal_heap_replace(&a, 7);
+	if(!wal_heap_journal(&a, 0, 0)) { assert(0); goto finally; }
+	rewind(journal);
+	if(!wal_heap_recover(&b, 0, journal, 0)) { assert(0); goto finally; }
+	assert(wal_equal(&a, &b) && a.a.size == 120 && b.journal.fp == journal);
+	/* A batch that is not committed is cut off, as if it had crashed. */
+	for(i = 0; i < 10; i++)
+		if(!wal_heap_add(&b, (unsigned)rand())) { assert(0); goto finally; }
+	assert(b.journal.pending == 10);
+	fflush(journal), b.journal.fp = 0, rewind(journal);
+	if(!wal_heap_recover(&c, 0, journal, 4)) { assert(0); goto finally; }
+	assert(wal_equal(&a, &c));
+	/* A checkpoint starts the journal over from a snapshot. */
+	if(!wal_heap_save(&c, old)) { assert(0); goto finally; }
+	for(i = 0; i < 20; i++) wal_heap_pop(&c);
+	if(!wal_heap_checkpoint(&c, path))
+		{ perror(path); assert(0); goto finally; }
+	assert(ftell(journal) == 4 + 2 * (long)sizeof(unsigned long));
+	for(i = 0; i < 3; i++)
+		if(!wal_heap_add(&c, (unsigned)rand())) { assert(0); goto finally; }
+	wal_heap_clear(&c);
+	if(!wal_heap_add(&c, 42) || !wal_heap_commit(&c))
+		{ assert(0); goto finally; }
+	c.journal.fp = 0, rewind(journal);
+	if(!(snapshot = fopen(path, "rb"))
+		|| !wal_heap_recover(&b, snapshot, journal, 0))
+		{ assert(0); goto finally; }
+	assert(wal_equal(&b, &c) && b.a.size == 1 && *wal_heap_peek(&b) == 42);
+	/* The old snapshot does not match the journal; neither is touched. */
+	b.journal.fp = 0;
+	if(fseek(journal, 0, SEEK_END) || (length = ftell(journal)) < 0)
+		{ assert(0); goto finally; }
+	rewind(old), rewind(journal), errno = 0;
+	assert(!wal_heap_recover(&b, old, journal, 0) && errno == EDOM
+		&& !b.journal.fp && !fseek(journal, 0, SEEK_END)
+		&& ftell(journal) == length);
+	errno = 0;
+	/* Anything else is not a journal. */
+	fputs("XXXX", other), rewind(other), errno = 0;
+	assert(!wal_heap_recover(&c, 0, other, 0) && errno == EDOM);
+	errno = 0;
+finally:
+	wal_heap_(&a), wal_heap_(&b), wal_heap_(&c);
+	if(snapshot) fclose(snapshot);
+	if(journal) fclose(journal);
+	if(other) fclose(other);
+	if(old) fclose(old);
+	remove(path);
+	fprintf(stderr, "Done tests of heap journal.\n\n");
+}
+
 static void index_to_string(const size_t *const i, char (*const a)[12]) {
 	sprintf(*a, "%lu", (unsigned long)*i);
 }
@@ -75,11 +847,191 @@ static int index_compare(const size_t a, const size_t b) { return a < b; }
 #include "../src/heap.h"
 
 
+#define HEAP_NAME aligned
+#define HEAP_TYPE size_t
+#define HEAP_COMPARE &index_compare
+#define HEAP_ALLOC &test_alloc
+#define HEAP_REALLOC &test_realloc
+#define HEAP_FREE &test_free
+#define HEAP_ALLOC_CONTEXT &test_count
+#define HEAP_TEST &test_index
+#define HEAP_EXPECT_TRAIT
+#include "../src/heap.h"
+#define HEAP_TO_STRING &index_to_string
+#include "../src/heap.h"
+
+#define HEAP_NAME tiny
+#define HEAP_TYPE size_t
+#define HEAP_COMPARE &index_compare
+#define HEAP_ALLOC &test_alloc
+#define HEAP_REALLOC &test_realloc
+#define HEAP_FREE &test_free
+#define HEAP_ALLOC_CONTEXT &test_count
+#define HEAP_INLINE_CAPACITY 8
+#define HEAP_TEST &test_index
+#define HEAP_EXPECT_TRAIT
+#include "../src/heap.h"
+#define HEAP_TO_STRING &index_to_string
+#include "../src/heap.h"
+
+/** Inline storage in <tag:tiny_heap> until it spills. */
+static void test_tiny(void) {
+	struct tiny_heap heap = tiny_heap_idle, moved;
+	size_t i;
+	assert(!test_count.live);
+	for(i = 0; i < 8; i++) if(!tiny_heap_add(&heap, i)) { assert(0); return; }
+	assert(!test_count.live && tiny_heap_peek(&heap) == heap.a.u.store
+		&& *tiny_heap_peek(&heap) == 7);
+	/* Moving it moves the nodes with it. */
+	moved = heap, memset(&heap, 0, sizeof heap);
+	assert(tiny_heap_peek(&moved) == moved.a.u.store
+		&& *tiny_heap_peek(&moved) == 7);
+	heap = moved;
+	if(!tiny_heap_add(&heap, 8)) { assert(0); return; }
+	assert(test_count.live == 1 && tiny_heap_peek(&heap) == heap.a.u.data
+		&& *tiny_heap_peek(&heap) == 8);
+	tiny_heap_pop(&heap), tiny_heap_pop(&heap);
+	assert(heap_tiny_node_array_shrink(&heap.a) && !test_count.live
+		&& tiny_heap_peek(&heap) == heap.a.u.store && heap.a.size == 7
+		&& *tiny_heap_peek(&heap) == 6);
+	tiny_heap_(&heap);
+	assert(!test_count.live && !heap_tiny_node_array_data(&heap.a));
+	tiny_heap_test(0);
+	assert(!test_count.live);
+}
+
+#define HEAP_NAME fixed
+#define HEAP_TYPE size_t
+#define HEAP_COMPARE &index_compare
+#define HEAP_ALLOC &test_alloc
+#define HEAP_REALLOC &test_realloc
+#define HEAP_FREE &test_free
+#define HEAP_ALLOC_CONTEXT &test_count
+#define HEAP_STATIC_CAPACITY 64
+#include "../src/heap.h"
+
+/** <tag:fixed_heap> must never call the allocator that it's given. */
+static void test_fixed(void) {
+	struct fixed_heap heap;
+	size_t i, j, evicted, *top, last, kept[64];
+	fixed_heap(&heap);
+	for(i = 0; i < 64; i++)
+		if(!fixed_heap_add(&heap, (size_t)rand())) { assert(0); return; }
+	errno = 0;
+	assert(!fixed_heap_add(&heap, 0) && errno == ERANGE && heap.a.size == 64
+		&& !fixed_heap_buffer(&heap, 1) && !fixed_heap_append(&heap, 1));
+	errno = 0;
+	/* Keep the highest 64, (`index_compare` is a max-heap.) */
+	for(i = 0; i < 64; i++) kept[i] = heap_fixed_node_array_data(&heap.a)[i];
+	for(i = 0; i < 1000; i++) {
+		const size_t add = (size_t)rand();
+		size_t *low = kept;
+		for(j = 1; j < 64; j++) if(kept[j] < *low) low = kept + j;
+		assert(fixed_heap_add_evict(&heap, add, &evicted));
+		if(add > *low) assert(evicted == *low), *low = add;
+		else assert(evicted == add);
+	}
+	for(last = (size_t)-1, i = 0; (top = fixed_heap_peek(&heap)); i++) {
+		for(j = 0; j < 64 && kept[j] != *top; j++);
+		assert(j < 64 && *top <= last), last = *top, kept[j] = (size_t)-1;
+		fixed_heap_pop(&heap);
+	}
+	assert(i == 64 && !fixed_heap_add_evict(&heap, 1, 0) && heap.a.size == 1);
+	fixed_heap_(&heap);
+	assert(!test_count.live && !errno);
+	fprintf(stderr, "Done tests of <fixed>heap.\n\n");
+}
+
+#define HEAP_NAME huge
+#define HEAP_TYPE size_t
+#define HEAP_COMPARE &index_compare
+#define HEAP_ALLOC &alloc_huge
+#define HEAP_REALLOC &alloc_huge_realloc
+#define HEAP_FREE &alloc_huge_free
+#include "../src/heap.h"
+
+/** Grows a heap past `ALLOC_HUGE_MIN` with <fn:alloc_huge> and drains it. */
+static void test_huge(void) {
+	struct huge_heap heap = HEAP_IDLE;
+	const size_t size = ALLOC_HUGE_MIN / sizeof *heap.a.data * 3;
+	size_t i, *top, last = (size_t)-1;
+	for(i = 0; i < size; i++) {
+		if(!huge_heap_add(&heap, (size_t)rand())) { assert(0); return; }
+		assert(heap.a.capacity * sizeof *heap.a.data < ALLOC_HUGE_MIN
+			|| !((unsigned long)heap.a.data & (ALLOC_HUGE_PAGE - 1)));
+	}
+	assert(heap.a.size == size);
+	for(i = 0; (top = huge_heap_peek(&heap)); i++) {
+		assert(*top <= last), last = *top;
+		huge_heap_pop(&heap);
+	}
+	assert(i == size && heap_huge_node_array_shrink(&heap.a)
+		&& heap.a.capacity < size);
+	huge_heap_(&heap);
+	fprintf(stderr, "Done tests of <huge>heap with %lu.\n\n",
+		(unsigned long)size);
+}
+
+
+#define SEQUENCE_NAME int
+#define SEQUENCE_INSERT 8
+#define SEQUENCE_ARITY 3
+#define SEQUENCE_BUFFER 5
+#define SEQUENCE_TEST &test_int
+#include "../src/sequence.h"
+
+#define SEQUENCE_NAME index
+#define SEQUENCE_TYPE size_t
+#define SEQUENCE_COMPARE &index_compare
+#define SEQUENCE_INSERT 32
+#define SEQUENCE_ARITY 2
+#define SEQUENCE_TEST &test_index
+#include "../src/sequence.h"
+
+
+#define EXTERNAL_NAME index
+#define EXTERNAL_TYPE size_t
+#define EXTERNAL_COMPARE &index_compare
+#define EXTERNAL_TEST &test_index
+#include "../src/external.h"
+
+
+#define SELECTION_NAME index
+#define SELECTION_TYPE size_t
+#define SELECTION_COMPARE &index_compare
+#define SELECTION_TEST &test_index
+#include "../src/selection.h"
+
+
 int main(void) {
 	struct orc_pool orcs = POOL_IDLE;
 	rand();
 	int_heap_test(0);
 	orc_heap_test(&orcs), orc_pool_(&orcs);
+	assert(!test_count.live);
+	test_pools();
+	test_compact();
+	test_handle();
+	test_key();
+	test_stats();
+	test_trace();
+	test_save();
+#ifdef ALLOC_MAP_ANON
+	test_file();
+#endif
+	test_journal();
+	test_threads();
+	test_drain();
+	test_magazine();
 	index_heap_test(0);
+	aligned_heap_test(0);
+	assert(!test_count.live);
+	test_tiny();
+	test_fixed();
+	test_huge();
+	int_sequence_test(0);
+	index_sequence_test(0);
+	index_external_test("graph", 0);
+	index_selection_test(0);
 	return EXIT_SUCCESS;
 }
@@ -28,8 +28,8 @@ static void PH_(graph)(const struct H_(heap) *const heap,
 #endif
 		"\\l|size: %lu\\lcapacity: %lu\\l}\"];\n", (unsigned long)heap->a.size,
 		(unsigned long)heap->a.capacity);
-	if(heap->a.data) {
-		PH_(node) *const n0 = heap->a.data;
+	if(PH_(node_array_data)(&heap->a)) {
+		PH_(node) *const n0 = PH_(node_array_data)(&heap->a);
 		size_t i;
 		fprintf(fp, "\tnode [fillcolor=lightsteelblue];\n");
 		if(heap->a.size) fprintf(fp, "\tn0 -> Hash [dir = back];\n");
@@ -55,7 +55,8 @@ static void PH_(valid)(const struct H_(heap) *const heap) {
 	size_t i;
 	PH_(node) *n0;
 	if(!heap) return;
-	if(!(n0 = heap->a.data)) { assert(!heap->a.size); return; }
+	if(!(n0 = PH_(node_array_data)(&heap->a)))
+		{ assert(!heap->a.size); return; }
 	for(i = 1; i < heap->a.size; i++) {
 		size_t iparent = (i - 1) >> 1;
 		if(PH_(compare)(PH_(get_priority)(n0 + iparent),
@@ -68,7 +69,7 @@ static void PH_(valid)(const struct H_(heap) *const heap) {
 
 /** @param[param] The parameter used for `HEAP_TEST`. */
 static void PH_(test_basic)(void *const param) {
-	struct H_(heap) heap = HEAP_IDLE;
+	struct H_(heap) heap = H_(heap_idle);
 	PH_(node) *node, add;
 	PH_(value) v, result;
 	PH_(priority) last_priority = 0;
@@ -146,6 +147,15 @@ static void PH_(test_basic)(void *const param) {
 	}
 	printf("Final heap: %s.\n", PH_(heap_to_string)(&heap));
 	assert(heap.a.size == test_size_1 + test_size_2 + test_size_3);
+	printf("Test replace.\n");
+	for(i = 0; i < test_size_2; i++) {
+		v = H_(heap_peek_value)(&heap);
+		PH_(filler)(&add, param);
+		result = H_(heap_replace)(&heap, add);
+		assert(v == result
+			&& heap.a.size == test_size_1 + test_size_2 + test_size_3);
+		PH_(valid)(&heap);
+	}
 	for(i = test_size_1 + test_size_2 + test_size_3; i > 0; i--) {
 		char a[12];
 		node = H_(heap_peek)(&heap);
@@ -0,0 +1,140 @@
+#if defined(QUOTE) || defined(QUOTE_)
+#error QUOTE_? cannot be defined.
+#endif
+#define QUOTE_(name) #name
+#define QUOTE(name) QUOTE_(name)
+
+/* `SELECTION_TEST` must be a function that implements <typedef:<PA>biaction>. */
+static void (*PR_(filler))(PR_(record) *, void *) = (SELECTION_TEST);
+
+/** Records in memory for testing. */
+struct PR_(memory) { PR_(record) *data; size_t size, i; };
+
+/** @implements <typedef:<PR>read_fn> */
+static int PR_(memory_read)(void *const source, PR_(record) *const record) {
+	struct PR_(memory) *const m = source;
+	if(m->i >= m->size) return 0;
+	*record = m->data[m->i++];
+	return 1;
+}
+
+/** @implements <typedef:<PR>write_fn> */
+static int PR_(memory_write)(void *const sink, const size_t run,
+	const PR_(record) *const record) {
+	struct PR_(memory) *const m = sink;
+	(void)run;
+	assert(m->i < m->size);
+	m->data[m->i++] = *record;
+	return 1;
+}
+
+/** Checks that the runs are sorted and in order. */
+struct PR_(check) { size_t run, records, run_records, longest;
+	PR_(record) last; };
+
+/** @implements <typedef:<PR>write_fn> */
+static int PR_(check_write)(void *const sink, const size_t run,
+	const PR_(record) *const record) {
+	struct PR_(check) *const c = sink;
+	assert(c && record);
+	if(!c->records || run != c->run) {
+		assert(c->records ? run == c->run + 1 : !run);
+		c->run = run, c->run_records = 0;
+	} else {
+		assert(PR_(compare)(c->last, *record) <= 0);
+	}
+	c->last = *record, c->records++;
+	if(++c->run_records > c->longest) c->longest = c->run_records;
+	return 1;
+}
+
+/** Merges the `runs` in `files` into a temporary file and checks that it is
+ `size` in order. */
+static void PR_(check_merge)(const struct selection_files *const files,
+	const size_t runs, const size_t size) {
+	struct PR_(check) c;
+	void *sources[1];
+	FILE *fp = tmpfile();
+	int success;
+	assert(fp);
+	memset(&c, 0, sizeof c);
+	success = R_(selection_merge_files)(files, runs, fp);
+	assert(success);
+	rewind(fp), sources[0] = fp;
+	success = R_(selection_merge)(&R_(selection_file_read), sources, 1,
+		&PR_(check_write), &c);
+	assert(success && c.records == size && !c.run);
+	fclose(fp);
+	selection_files_remove(files, runs);
+}
+
+/** Runs on `size` records from `param`, with `memory`. */
+static void PR_(test_runs)(const size_t size, const size_t memory,
+	void *const param) {
+	struct PR_(memory) m, sorted;
+	struct PR_(check) c;
+	struct selection_files files = { "graph", 0, 0 };
+	size_t i, runs;
+	int success;
+	m.data = malloc(sizeof *m.data * (size ? size : 1)), assert(m.data);
+	sorted.data = malloc(sizeof *m.data * (size ? size : 1));
+	assert(sorted.data);
+	for(i = 0; i < size; i++) PR_(filler)(m.data + i, param);
+	m.size = sorted.size = size;
+
+	/* Random input. */
+	m.i = 0, memset(&c, 0, sizeof c);
+	success = R_(selection_runs)(memory, &PR_(memory_read), &m,
+		&PR_(check_write), &c, &runs);
+	assert(success && c.records == size && (!size || runs == c.run + 1));
+	printf("Random: %lu records, memory %lu, %lu runs, longest %lu.\n",
+		(unsigned long)size, (unsigned long)memory, (unsigned long)runs,
+		(unsigned long)c.longest);
+	/* The expected length is twice memory, (`e - 1` for one.) */
+	assert(size < 8 * memory || 4 * size > 5 * memory * runs);
+
+	/* Random input to files. */
+	m.i = 0;
+	success = R_(selection_runs)(memory, &PR_(memory_read), &m,
+		&R_(selection_file_write), &files, &runs);
+	assert(success && selection_files_close(&files));
+	PR_(check_merge)(&files, runs, size);
+
+	/* Sorting it in memory. */
+	m.i = sorted.i = 0;
+	success = R_(selection_runs)(size ? size : 1, &PR_(memory_read), &m,
+		&PR_(memory_write), &sorted, &runs);
+	assert(success && runs == !!size && sorted.i == size);
+
+	/* Sorted input is one run. */
+	sorted.i = 0;
+	success = R_(selection_runs)(memory, &PR_(memory_read), &sorted,
+		&R_(selection_file_write), &files, &runs);
+	assert(success && selection_files_close(&files) && runs == !!size);
+	PR_(check_merge)(&files, runs, size);
+
+	free(m.data), free(sorted.data);
+}
+
+/** Will be tested on stdout. Requires `SELECTION_TEST` and not `NDEBUG`.
+ Writes temporary files to `graph`.
+ @param[param] The `void *` parameter in `SELECTION_TEST`. Can be null.
+ @allow */
+static void R_(selection_test)(void *const param) {
+	printf("<" QUOTE(SELECTION_NAME) ">selection"
+		" of record type <" QUOTE(SELECTION_TYPE) ">"
+		" was created using:"
+		" SELECTION_COMPARE<" QUOTE(SELECTION_COMPARE) ">;"
+		" SELECTION_TEST <" QUOTE(SELECTION_TEST) ">;"
+		" testing:\n");
+	errno = 0;
+	PR_(test_runs)(0, 1, param);
+	PR_(test_runs)(1, 1, param);
+	PR_(test_runs)(1000, 1, param);
+	PR_(test_runs)(5000, 64, param);
+	assert(!errno);
+	fprintf(stderr, "Done tests of <" QUOTE(SELECTION_NAME) ">selection.\n\n");
+}
+
+#undef QUOTE
+#undef QUOTE_
@@ -0,0 +1,106 @@
+#if defined(QUOTE) || defined(QUOTE_)
+#error QUOTE_? cannot be defined.
+#endif
+#define QUOTE_(name) #name
+#define QUOTE(name) QUOTE_(name)
+
+/* `SEQUENCE_TEST` must be a function that implements <typedef:<PA>biaction>. */
+static void (*PS_(filler))(PS_(node) *, void *) = (SEQUENCE_TEST);
+
+/** @return Whether `a` and `b` are of equal priority. */
+static int PS_(equal)(const PS_(node) *const a, const PS_(node) *const b) {
+	const PS_(priority) pa = PSH_(get_priority)(a), pb = PSH_(get_priority)(b);
+	return PS_(compare)(pa, pb) <= 0 && PS_(compare)(pb, pa) <= 0;
+}
+
+/** Makes sure `run` is in order. @return The size of `run`. */
+static size_t PS_(valid_run)(const struct PS_(run) *const run) {
+	const PS_(node) *n, *n_end;
+	assert(run && run->cursor <= run->a.size);
+	for(n = run->a.data + run->cursor, n_end = run->a.data + run->a.size;
+		n + 1 < n_end; n++) assert(PS_(compare)(PSH_(get_priority)(n),
+		PSH_(get_priority)(n + 1)) <= 0);
+	return PS_(run_size)(run);
+}
+
+/** Makes sure `s` is in a valid state. */
+static void PS_(valid)(const struct S_(sequence) *const s) {
+	const struct PS_(run) *r, *r_end;
+	const PS_(node) *back;
+	size_t size;
+	if(!s) return;
+	assert(s->insert.a.size <= SEQUENCE_INSERT);
+	size = s->insert.a.size + PS_(valid_run)(&s->buffer);
+	assert(PS_(run_size)(&s->buffer) || !s->runs.size);
+	back = s->buffer.a.data + s->buffer.a.size - 1;
+	for(r = s->runs.data, r_end = r + s->runs.size; r < r_end; r++) {
+		size += PS_(valid_run)(r);
+		assert(PS_(run_size)(r) && (r + 1 == r_end || r->level >= r[1].level));
+		/* The deletion buffer has the smallest of all the runs. */
+		assert(PS_(compare)(PSH_(get_priority)(back),
+			PSH_(get_priority)(r->a.data + r->cursor)) <= 0);
+	}
+	assert(size == s->size);
+}
+
+/** Checks `s` against an ordinary heap, adding and popping at random with
+ `param` to the filler. */
+static void PS_(test_reference)(void *const param) {
+	struct S_(sequence) s = SEQUENCE_IDLE;
+	struct S_(sequence_heap) ref = HEAP_IDLE;
+	const size_t test_size = 20000;
+	PS_(node) add, *a, *b;
+	size_t i, groups = 0;
+	for(i = 0; i < test_size; i++) {
+		if(!(i % 97)) PS_(valid)(&s);
+		if(s.runs.size && s.runs.data[0].level > groups)
+			groups = s.runs.data[0].level;
+		if(rand() % 3) {
+			PS_(filler)(&add, param);
+			if(!S_(sequence_add)(&s, add) || !S_(sequence_heap_add)(&ref, add))
+				{ assert(0); break; }
+		} else {
+			a = S_(sequence_peek)(&s), b = S_(sequence_heap_peek)(&ref);
+			assert(!a == !b);
+			if(!a) continue;
+			assert(PS_(equal)(a, b));
+			S_(sequence_pop)(&s), S_(sequence_heap_pop)(&ref);
+		}
+		assert(S_(sequence_size)(&s) == ref.a.size);
+	}
+	printf("Sequence size %lu with %lu runs in %lu groups.\n",
+		(unsigned long)s.size, (unsigned long)s.runs.size,
+		(unsigned long)groups + 1);
+	assert(groups);
+	PS_(valid)(&s);
+	while((a = S_(sequence_peek)(&s))) {
+		b = S_(sequence_heap_peek)(&ref);
+		assert(b && PS_(equal)(a, b));
+		assert(S_(sequence_peek_value)(&s) == PSH_(get_value)(a));
+		S_(sequence_pop)(&s), S_(sequence_heap_pop)(&ref);
+	}
+	assert(!ref.a.size && !S_(sequence_size)(&s) && !S_(sequence_pop)(&s));
+	PS_(valid)(&s);
+	S_(sequence_)(&s);
+	S_(sequence_heap_)(&ref);
+	assert(!S_(sequence_peek)(&s));
+}
+
+/** Will be tested on stdout. Requires `SEQUENCE_TEST` and not `NDEBUG`.
+ @param[param] The `void *` parameter in `SEQUENCE_TEST`. Can be null. @allow */
+static void S_(sequence_test)(void *const param) {
+	printf("<" QUOTE(SEQUENCE_NAME) ">sequence"
+		" of priority type <" QUOTE(SEQUENCE_TYPE) ">"
+		" was created using:"
+		" SEQUENCE_COMPARE<" QUOTE(SEQUENCE_COMPARE) ">;"
+		" SEQUENCE_INSERT<" QUOTE(SEQUENCE_INSERT) ">;"
+		" SEQUENCE_ARITY<" QUOTE(SEQUENCE_ARITY) ">;"
+		" SEQUENCE_BUFFER<" QUOTE(SEQUENCE_BUFFER) ">;"
+		" SEQUENCE_TEST <" QUOTE(SEQUENCE_TEST) ">;"
+		" testing:\n");
+	PS_(test_reference)(param);
+	fprintf(stderr, "Done tests of <" QUOTE(SEQUENCE_NAME) ">sequence.\n\n");
+}
+
+#undef QUOTE
+#undef QUOTE_